@@ -0,0 +1,128 @@
+#include <pebble.h>
+#include <accel_codec.h>
+
+
+static uint16_t fletcher16(const uint8_t *bytes, uint32_t length) {
+  uint32_t sum1 = 0, sum2 = 0;
+  for (uint32_t i = 0; i < length; i++) {
+    sum1 = (sum1 + bytes[i]) % 255;
+    sum2 = (sum2 + sum1) % 255;
+  }
+  return (uint16_t)((sum2 << 8) | sum1);
+}
+
+
+
+static inline uint32_t zigzag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+
+
+static inline int32_t unzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+
+
+static inline uint8_t *put_varint(uint8_t *out, uint32_t value) {
+  while (value >= 0x80) {
+    *out++ = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  *out++ = (uint8_t)value;
+  return out;
+}
+
+
+
+/*
+	Reads one varint of at most 3 bytes (enough for a
+	zig-zagged int16 delta). Returns NULL if it runs
+	past end or is longer.
+*/
+static inline const uint8_t *get_varint(const uint8_t *in, const uint8_t *end, uint32_t *value) {
+  uint32_t result = 0;
+  for (int shift = 0; (shift < 21) && (in < end); shift += 7) {
+    uint8_t byte = *in++;
+    result |= (uint32_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return in;
+    }
+  }
+  return NULL;
+}
+
+
+
+/*
+	Encodes num_samples interleaved x, y, z samples
+	as one block. Returns the number of bytes
+	written, 0 if there is nothing to encode or
+	out_size is under ACCEL_CODEC_MAX_BLOCK_BYTES.
+*/
+uint32_t accel_codec_encode(const int16_t *samples, uint32_t num_samples, uint8_t *out, uint32_t out_size) {
+  if ((num_samples == 0) || (num_samples > ACCEL_CODEC_MAX_SAMPLES) ||
+      (out_size < ACCEL_CODEC_MAX_BLOCK_BYTES(num_samples))) {
+    return 0;
+  }
+
+  uint8_t *pos = out;
+  *pos++ = ACCEL_CODEC_MAGIC;
+  *pos++ = (uint8_t)num_samples;
+  for (int axis = 0; axis < 3; axis++) {
+    uint16_t value = (uint16_t)samples[axis];
+    *pos++ = (uint8_t)value;
+    *pos++ = (uint8_t)(value >> 8);
+  }
+
+  for (uint32_t i = 3; i < num_samples * 3; i++) {
+    pos = put_varint(pos, zigzag((int32_t)samples[i] - samples[i - 3]));
+  }
+
+  uint16_t checksum = fletcher16(out, pos - out);
+  *pos++ = (uint8_t)checksum;
+  *pos++ = (uint8_t)(checksum >> 8);
+  return pos - out;
+}
+
+
+
+/*
+	Decodes the block at the start of in. Returns
+	the number of bytes it took, or 0 if in does
+	not start with a whole, valid block that fits
+	in max_samples and matches its checksum.
+*/
+uint32_t accel_codec_decode(const uint8_t *in, uint32_t in_size, int16_t *samples, uint32_t max_samples,
+                            uint32_t *num_samples) {
+  if ((in_size < ACCEL_CODEC_HEADER_BYTES) || (in[0] != ACCEL_CODEC_MAGIC) ||
+      (in[1] == 0) || (in[1] > max_samples)) {
+    return 0;
+  }
+
+  const uint8_t *end = in + in_size;
+  const uint8_t *pos = in + 2;
+  uint32_t count = in[1];
+  for (int axis = 0; axis < 3; axis++) {
+    samples[axis] = (int16_t)(pos[0] | (pos[1] << 8));
+    pos += 2;
+  }
+
+  for (uint32_t i = 3; i < count * 3; i++) {
+    uint32_t delta;
+    pos = get_varint(pos, end, &delta);
+    if (!pos) {
+      return 0;
+    }
+    samples[i] = (int16_t)(samples[i - 3] + unzigzag(delta));
+  }
+
+  if ((end - pos < ACCEL_CODEC_CHECKSUM_BYTES) ||
+      (fletcher16(in, pos - in) != (uint16_t)(pos[0] | (pos[1] << 8)))) {
+    return 0;
+  }
+  *num_samples = count;
+  return (pos - in) + ACCEL_CODEC_CHECKSUM_BYTES;
+}
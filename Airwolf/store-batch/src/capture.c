@@ -0,0 +1,162 @@
+#include <pebble.h>
+#include <capture.h>
+
+typedef struct {
+  int16_t values[CAPTURE_PAGE_SAMPLES * 3];	// x, y, z per sample
+  uint16_t count;				// Samples in the page
+  bool pending;					// Full, waiting for submit_callback()
+} CapturePage;
+
+static CapturePage s_pages[2];
+static uint8_t s_filling;			// Page samples go to
+static DataLoggingSessionRef s_session;
+static AppTimer *s_submit_timer;
+static CaptureStats s_stats;
+
+#if CAPTURE_CODEC
+static uint8_t s_block[ACCEL_CODEC_MAX_BLOCK_BYTES(CAPTURE_PAGE_SAMPLES)];
+#endif
+
+
+static void submit_callback(void *data);
+
+
+static void schedule_submit(uint32_t delay_ms) {
+  if (!s_submit_timer) {
+    s_submit_timer = app_timer_register(delay_ms, submit_callback, NULL);
+  }
+}
+
+
+
+/*
+	Logs one page in a single call and counts
+	the outcome. Returns false if the page should
+	be retried later (session busy).
+*/
+static bool submit_page(CapturePage *page) {
+  uint32_t raw_bytes = page->count * 3 * sizeof(int16_t);
+#if CAPTURE_CODEC
+  uint32_t bytes = accel_codec_encode(page->values, page->count, s_block, sizeof(s_block));
+  DataLoggingResult result = data_logging_log(s_session, s_block, bytes);
+#else
+  uint32_t bytes = raw_bytes;
+  DataLoggingResult result = data_logging_log(s_session, page->values, page->count * 3);
+#endif
+  if (result < CAPTURE_RESULTS) {
+    s_stats.results[result]++;
+  }
+
+  if (result == DATA_LOGGING_BUSY) {
+    return false;
+  }
+  if (result == DATA_LOGGING_SUCCESS) {
+    s_stats.pages_submitted++;
+    s_stats.bytes_raw += raw_bytes;
+    s_stats.bytes_logged += bytes;
+  } else {
+    s_stats.pages_lost++;
+  }
+  page->count = 0;
+  page->pending = false;
+  return true;
+}
+
+
+
+/*
+	Submits the full page outside of the sensor
+	callback, retrying while the session is busy.
+*/
+static void submit_callback(void *data) {
+  s_submit_timer = NULL;
+  for (int i = 0; i < 2; i++) {
+    CapturePage *page = &s_pages[(s_filling + i) % 2];	// Older page first
+    if (page->pending && !submit_page(page)) {
+      schedule_submit(CAPTURE_RETRY_MS);
+      return;
+    }
+  }
+}
+
+
+
+void capture_start(void) {
+  memset(s_pages, 0, sizeof(s_pages));
+  memset(&s_stats, 0, sizeof(s_stats));
+  s_filling = 0;
+#if CAPTURE_CODEC
+  s_session = data_logging_create(CAPTURE_CODEC_TAG, DATA_LOGGING_BYTE_ARRAY, 1, false);
+#else
+  s_session = data_logging_create(CAPTURE_TAG, DATA_LOGGING_BYTE_ARRAY, sizeof(int16_t), false);
+#endif
+}
+
+
+
+/*
+	Last try at a page before the session closes:
+	if it is still busy, the page is lost.
+*/
+static void submit_last(CapturePage *page) {
+  if (!submit_page(page)) {
+    s_stats.pages_lost++;
+    page->count = 0;
+    page->pending = false;
+  }
+}
+
+
+
+/*
+	Submits whatever is left, full or partial
+	pages, and finishes the session.
+*/
+void capture_stop(void) {
+  if (s_submit_timer) {
+    app_timer_cancel(s_submit_timer);
+    s_submit_timer = NULL;
+  }
+  for (int i = 0; i < 2; i++) {
+    CapturePage *page = &s_pages[(s_filling + i) % 2];	// Older page first
+    if (page->pending) {
+      submit_last(page);
+    }
+  }
+  if (!s_pages[s_filling].pending && (s_pages[s_filling].count > 0)) {
+    submit_last(&s_pages[s_filling]);
+  }
+  data_logging_finish(s_session);
+  s_session = NULL;
+}
+
+
+
+void capture_add(const AccelData *data, uint32_t num_samples) {
+  for (uint32_t i = 0; i < num_samples; i++) {
+    CapturePage *page = &s_pages[s_filling];
+    if (page->pending) {
+      s_stats.samples_dropped += num_samples - i;	// Both pages wait for the phone
+      return;
+    }
+
+    int16_t *values = &page->values[page->count * 3];
+    values[0] = data[i].x;
+    values[1] = data[i].y;
+    values[2] = data[i].z;
+    page->count++;
+    s_stats.samples_captured++;
+
+    if (page->count == CAPTURE_PAGE_SAMPLES) {
+      page->pending = true;
+      s_filling ^= 1;
+      schedule_submit(0);
+    }
+  }
+}
+
+
+
+const CaptureStats *capture_stats(void) {
+  return &s_stats;
+}
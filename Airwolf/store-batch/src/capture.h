@@ -0,0 +1,51 @@
+#pragma once
+
+/*
+	Continuous raw accelerometer capture over data logging.
+
+	Samples from every accel_data_handler() batch are packed as
+	interleaved int16 x, y, z into one of two pages. When a page
+	fills, the other page takes over and the full one is handed to
+	an app_timer callback that submits it to the capture session,
+	so data_logging_log() never runs inside the sensor callback.
+	A single session stays open from capture_start() to
+	capture_stop().
+
+	With CAPTURE_CODEC set (the default) pages are compressed
+	with accel_codec, one block per page, and logged as bytes
+	under CAPTURE_CODEC_TAG; otherwise raw int16 values go out
+	under CAPTURE_TAG.
+
+	If a page is still waiting for the phone when the other one
+	fills (the session stayed busy), new samples are dropped and
+	counted instead of blocking. Every data_logging_log() outcome
+	is counted in CaptureStats.
+*/
+
+#include <pebble.h>
+#include <accel_codec.h>
+
+#ifndef CAPTURE_CODEC
+#define CAPTURE_CODEC 1
+#endif
+
+#define CAPTURE_TAG 0xbeef		// Raw int16 x, y, z items
+#define CAPTURE_CODEC_TAG 0xbeec	// accel_codec blocks, byte items
+#define CAPTURE_PAGE_SAMPLES 100	// 4 s at 25 Hz, 600 bytes raw; at most ACCEL_CODEC_MAX_SAMPLES
+#define CAPTURE_RETRY_MS 500		// Resubmit delay after DATA_LOGGING_BUSY
+#define CAPTURE_RESULTS (DATA_LOGGING_INVALID_PARAMS + 1)
+
+typedef struct {
+  uint32_t samples_captured;	// Samples accepted into a page
+  uint32_t samples_dropped;	// Samples lost while both pages were full
+  uint32_t pages_submitted;	// Pages the session took
+  uint32_t pages_lost;		// Pages given up on (session full or closed, busy at capture_stop())
+  uint32_t bytes_raw;		// Size of the submitted pages as int16 samples
+  uint32_t bytes_logged;	// What the session actually took
+  uint32_t results[CAPTURE_RESULTS];	// data_logging_log() outcomes, by DataLoggingResult
+} CaptureStats;
+
+void capture_start(void);
+void capture_stop(void);
+void capture_add(const AccelData *data, uint32_t num_samples);
+const CaptureStats *capture_stats(void);
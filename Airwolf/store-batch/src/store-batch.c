@@ -1,106 +1,30 @@
 #include <pebble.h>
+#include <capture.h>
 
 static Window *window;
 static TextLayer *text_layer;
 
-/* 
-   added this because turns out they're not defined.
-   maybe you can just copy and paste the enum
-   or maybe declare or include the enum
-*/ 
-#define DATA_LOG_SUCCESS 0
-#define DATA_LOG_BUSY    1
-#define DATA_LOG_FULL    2
-#define DATA_LOG_NOT_FOUND 3
-#define DATA_LOG_CLOSED    4
-#define DATA_LOG_INVALID_PARAMS 5 
+static char s_status[40];
 
 /*
-typedef enum {
-  DATA_LOG_SUCCESS = 0,
-  DATA_LOG_BUSY, //! Someone else is writing to this log
-  DATA_LOG_FULL, //! No more space to save data
-  DATA_LOG_NOT_FOUND, //! The log does not exist
-  DATA_LOG_CLOSED, //! The log was made inactive
-  DATA_LOG_INVALID_PARAMS
-} DataLoggingResult;
+  Shows the capture counters: pages the phone took
+  and samples lost to a busy or full session.
 */
-
-void checkDataLoggingResult(DataLoggingResult r) {
-
-  /*
-  change the text_layers to something more useful
-  than printing whatever out
-  */
-
-  if ( r == DATA_LOG_SUCCESS ) {
-    text_layer_set_text(text_layer, "DATA_LOG_SUCCESS");
-  } else if ( r == DATA_LOG_BUSY) {
-    text_layer_set_text(text_layer, "DATA_LOG_BUSY");
-  } else if ( r == DATA_LOG_FULL) {
-    text_layer_set_text(text_layer, "DATA_LOG_FULL");
-  } else if ( r == DATA_LOG_NOT_FOUND) {
-    text_layer_set_text(text_layer, "DATA_LOG_NOT_FOUND");
-  } else if ( r ==  DATA_LOG_CLOSED) {
-    text_layer_set_text(text_layer, "DATA_LOG_CLOSED");
-  } else if ( r == DATA_LOG_INVALID_PARAMS ) {
-    text_layer_set_text(text_layer, "DATA_LOG_CLOSED");
-  } else {
-    text_layer_set_text(text_layer, "WTF");
-  }
-}
-
-int flag = 0;
-
-void log_data(uint16_t *sample) {
-    
-  /*
-    data is flushed at end of each session
-    try to data_loggin_create in init, do multiple 
-    data_logging_finish, and see what happens
-  */ 
-
-  if (flag) {
-    return;
-  }
-  flag = 1;
-  DataLoggingSessionRef logging_session = data_logging_create(0xbeef, DATA_LOGGING_BYTE_ARRAY, sizeof(int16_t), false);
-  DataLoggingResult r = data_logging_log(logging_session, sample, 30);
-  checkDataLoggingResult(r);
-  data_logging_finish(logging_session);
-  
+static void show_capture_status(void) {
+  const CaptureStats *stats = capture_stats();
+  uint32_t lost = stats->samples_dropped + stats->pages_lost * CAPTURE_PAGE_SAMPLES;
+  snprintf(s_status, sizeof(s_status), "%lu pages, %lu lost",
+           (unsigned long)stats->pages_submitted, (unsigned long)lost);
+  text_layer_set_text(text_layer, s_status);
 }
 
 void accel_data_handler(AccelData *data, uint32_t num_samples) {
-
-  if ( data[0].z == 0) {
-    text_layer_set_text(text_layer, "Zero :|");
-  } else if (  data[0].z > 0 ) {
-    text_layer_set_text(text_layer, "Positive");
-  } else if ( data[0].z < 0 ) {
-    text_layer_set_text(text_layer, "Negative br");
-  }
-
-  uint16_t sample[30];
-
-  uint16_t i = 0;
-  uint16_t j = 0;
-  for( ; i < num_samples; i += 1) {
-    sample[j] = data[i].x;
-    sample[j+1] = data[i].y;
-    sample[j+2] = data[i].z;
-    j += 3;
-  }
-  
-  // **** lol, make sure to delete this line
-  sample[0] += sample[3];
-
-  // log dat brah
-  log_data((uint16_t*)sample);
+  // Only copies into the current page; full pages are logged from a timer
+  capture_add(data, num_samples);
 }
 
 static void select_click_handler(ClickRecognizerRef recognizer, void *context) {
-  text_layer_set_text(text_layer, "Select");
+  show_capture_status();
 }
 
 static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
@@ -122,7 +46,7 @@ static void window_load(Window *window) {
   GRect bounds = layer_get_bounds(window_layer);
 
   text_layer = text_layer_create((GRect) { .origin = { 0, 72 }, .size = { bounds.size.w, 20 } });
-  text_layer_set_text(text_layer, "Press a button");
+  text_layer_set_text(text_layer, "Capturing");
   text_layer_set_text_alignment(text_layer, GTextAlignmentCenter);
   layer_add_child(window_layer, text_layer_get_layer(text_layer));
 }
@@ -141,15 +65,16 @@ static void init(void) {
   const bool animated = true;
   window_stack_push(window, animated);
 
-  // init accel batches service
-  accel_data_service_subscribe(10, &accel_data_handler);
-  accel_service_set_sampling_rate(ACCEL_SAMPLING_10HZ);
-  //datalogging service stuff
+  // continuous capture at the rate the detectors run at
+  capture_start();
+  accel_data_service_subscribe(25, &accel_data_handler);
+  accel_service_set_sampling_rate(ACCEL_SAMPLING_25HZ);
 }
 
 static void deinit(void) {
   // deinit accel batches service
   accel_data_service_unsubscribe();
+  capture_stop();
 
   window_destroy(window);
 }
@@ -27,8 +27,16 @@
 
 #include <pebble.h>
 #include <GestureRecording.h>
+#include <gesture_buffer.h>
+#include <gesture_export.h>
+#include <gesture_recognizer.h>
+#include <gesture_store.h>
 
-#define HISTORY_MAX 250
+#define RECORD_RATE_HZ 25
+#define RECORD_SECONDS 10		// At most GESTURE_BUFFER_SAMPLES / RECORD_RATE_HZ; SELECT again ends it sooner
+#define RECORD_SAMPLES (RECORD_SECONDS * RECORD_RATE_HZ)
+#define RECOGNIZE_BATCH_SAMPLES 5	// 5 accel callbacks a second while recognizing
+#define RECOGNIZE_DELAY_MS 500		// Saved templates load after the window is up
 
 /////////////////////  Globals  //////////////////////////
 static Window *window;
@@ -37,11 +45,13 @@ static TextLayer *text_layer;
 char text_buffer[250];
 int timer_frequency = 40;		// Time setup for timer function in milliseconds
 static AppTimer *timer;
-static int last_x = 0;
 
 bool record_gesture = false;		// State of false positive
 
-static AccelData history[HISTORY_MAX];	// Array of accelerometer data
+static GestureBuffer history;		// Recorded x, y, z, one array per axis
+static GestureRecognizer s_recognizer;	// The first templates of the store, in its order
+static GestureStore s_store;		// Saved templates, only the index is read at startup
+bool recognizing = false;		// Subscribed to accel data, not peeking
 
 //////////////////////////////////////////////////////////
 
@@ -58,6 +68,118 @@ static void set_timer() {
 
 
 
+/*
+	Matches the live stream against the recorded
+	templates while not recording.
+*/
+static void accel_data_handler(AccelData *data, uint32_t num_samples) {
+  GestureMatch match;
+  for (uint32_t i = 0; i < num_samples; i++) {
+    if (gesture_recognizer_push(&s_recognizer, &data[i], &match)) {
+      vibes_short_pulse();
+      snprintf(text_buffer, 124, "%s\nrecognized", gesture_store_name(&s_store, match.template));
+      text_layer_set_text(text_layer, text_buffer);
+    }
+  }
+}
+
+
+
+/*
+	Loads the saved templates the recognizer
+	does not have yet.
+*/
+static void load_templates() {
+  static int16_t axes[GESTURE_AXES][GESTURE_TEMPLATE_SAMPLES];
+
+  while (s_recognizer.num_templates < gesture_store_count(&s_store)){
+    if (!gesture_store_load(&s_store, s_recognizer.num_templates, axes)){
+      APP_LOG(APP_LOG_LEVEL_WARNING, "Template %d is damaged, deleting it", s_recognizer.num_templates);
+      if (!gesture_store_delete(&s_store, s_recognizer.num_templates)){
+        APP_LOG(APP_LOG_LEVEL_ERROR, "Could not delete template %d", s_recognizer.num_templates);
+        break;		// The store is as it was, so trying again would loop
+      }
+      continue;
+    }
+    gesture_recognizer_add_samples(&s_recognizer, axes);
+  }
+}
+
+
+
+static void start_recognizing() {
+  load_templates();
+  if (recognizing == false && record_gesture == false && s_recognizer.num_templates > 0){
+    gesture_recognizer_reset(&s_recognizer);
+    accel_data_service_subscribe(RECOGNIZE_BATCH_SAMPLES, accel_data_handler);
+    accel_service_set_sampling_rate(ACCEL_SAMPLING_25HZ);
+    recognizing = true;
+  }
+}
+
+
+
+static void recognize_timer_callback(void *data) {
+  start_recognizing();
+}
+
+
+
+static void stop_recognizing() {
+  if (recognizing == true){
+    accel_data_service_unsubscribe();	// Recording peeks, which needs the stream off
+    recognizing = false;
+  }
+}
+
+
+
+/*
+	Adds the new recording to the recognizer and
+	the store, replacing the oldest template when
+	the store is full.
+*/
+static void save_template() {
+  load_templates();
+  if (gesture_store_count(&s_store) == GESTURE_STORE_MAX_TEMPLATES){
+    if (!gesture_store_delete(&s_store, 0)){
+      text_layer_set_text(text_layer, "Could not save\ngesture");
+      return;
+    }
+    gesture_recognizer_remove(&s_recognizer, 0);
+  }
+
+  int template = gesture_recognizer_add(&s_recognizer, &history);
+  if (template < 0){
+    text_layer_set_text(text_layer, "Gesture too\nshort");
+  } else if (gesture_store_save(&s_store, s_recognizer.templates[template].axes, NULL) < 0){
+    gesture_recognizer_remove(&s_recognizer, template);
+    text_layer_set_text(text_layer, "Could not save\ngesture");
+  } else {
+    snprintf(text_buffer, 124, "%s\nrecorded", gesture_store_name(&s_store, template));
+    text_layer_set_text(text_layer, text_buffer);
+  }
+}
+
+
+
+/*
+	Stops recording, when RECORD_SECONDS are up
+	or on a second SELECT, and keeps what was
+	recorded as a template.
+*/
+static void end_recording() {
+  if (timer){
+    app_timer_cancel(timer);
+    timer = NULL;
+  }
+  record_gesture = false;
+  save_template();
+  start_recognizing();
+}
+
+
+
 /*
 	This function peeks the accelerometer,
 	and check if the "select" button has been
@@ -67,7 +189,8 @@ static void set_timer() {
 */
 
 static void timer_callback() {
-  int secs = (10 - (last_x/25));
+  timer = NULL;
+  int secs = RECORD_SECONDS - (gesture_buffer_count(&history) / RECORD_RATE_HZ);
 
   // Get last value from accelerometer
   AccelData accel;
@@ -77,21 +200,15 @@ static void timer_callback() {
   accel_service_peek(&accel);
 
   // Save to history
-  history[last_x].x = accel.x;
-  history[last_x].y = accel.y;
-  history[last_x].z = accel.z;
-  last_x++;
+  gesture_buffer_push(&history, &accel);
 
   // Check if last record
-  if (last_x < HISTORY_MAX){
+  if (gesture_buffer_count(&history) < RECORD_SAMPLES){
     set_timer();			// Reset timer function
     snprintf(text_buffer, 124, "Reconding for\n%d seconds...", secs);
     text_layer_set_text(text_layer, text_buffer);
-  } 
-  if (last_x >= HISTORY_MAX){
-    record_gesture = false;		// End recording
-    last_x = 0;
-    text_layer_set_text(text_layer, "Gesture Recorded\nsuccesfully");
+  } else {
+    end_recording();
   }
 }
 
@@ -109,27 +226,54 @@ void accel_tap_handler(AccelAxisType axis, int32_t direction) {
 static void select_click_handler(ClickRecognizerRef recognizer, void *context) {
   if (record_gesture == false){
     //vibes_short_pulse();
-    text_layer_set_text(text_layer, "Reconding for\n10 seconds...");
+    snprintf(text_buffer, 124, "Reconding for\n%d seconds...", RECORD_SECONDS);
+    text_layer_set_text(text_layer, text_buffer);
+    stop_recognizing();
+    gesture_buffer_init(&history);
     record_gesture = true;
     set_timer();
+  } else {
+    end_recording();
   }
 }
 
 
 
+/*
+	Dumps the recording to the console, one
+	APP_LOG line per sample. Slow; DOWN exports
+	the same data in binary.
+*/
 static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
+  if (record_gesture == false){
+    text_layer_set_text(text_layer, "Logging data\nto console...");
+
+    for (int i=0 ; i < gesture_buffer_count(&history) ; i++){
+      APP_LOG(APP_LOG_LEVEL_DEBUG, "Value: %d, X=%d, Y=%d, Z=%d", i,
+              gesture_buffer_get(&history, GESTURE_AXIS_X, i),
+              gesture_buffer_get(&history, GESTURE_AXIS_Y, i),
+              gesture_buffer_get(&history, GESTURE_AXIS_Z, i));
+    }
+    text_layer_set_text(text_layer, "Data logging\nsuccessful");
+  }
 }
 
 
 
+/*
+	Exports the recording to the phone as
+	binary chunks (see gesture_export.h).
+*/
 static void down_click_handler(ClickRecognizerRef recognizer, void *context) {
   if (record_gesture == false){
-    text_layer_set_text(text_layer, "Logging data\nto console...");
+    GestureExportResult result = gesture_export(&history, RECORD_RATE_HZ);
 
-    for (int i=0 ; i < HISTORY_MAX ; i++){
-      APP_LOG(APP_LOG_LEVEL_DEBUG, "Value: %d, X=%d, Y=%d, Z=%d", i, history[i].x, history[i].y, history[i].z);      
+    if (result.failed == 0) {
+      snprintf(text_buffer, 124, "Exported %d\nchunks", result.chunks);
+    } else {
+      snprintf(text_buffer, 124, "Export failed\n%d of %d chunks", result.failed, result.chunks + result.failed);
     }
-    text_layer_set_text(text_layer, "Data logging\nsuccessful");
+    text_layer_set_text(text_layer, text_buffer);
   }
 }
 
@@ -153,7 +297,8 @@ static void window_load(Window *window) {
   GRect bounds = layer_get_bounds(window_layer);
 
   text_layer = text_layer_create((GRect) { .origin = { 0, 50 }, .size = { bounds.size.w, 100 } });
-  text_layer_set_text(text_layer, "Press Select\nto record a\ngesture. Press\ndown to log data.");
+  snprintf(text_buffer, 124, "Press Select\nto record a\ngesture. Press\ndown to export.\n%d saved.", gesture_store_count(&s_store));
+  text_layer_set_text(text_layer, text_buffer);
   
   text_layer_set_overflow_mode(text_layer, GTextOverflowModeWordWrap);
 
@@ -170,6 +315,9 @@ static void window_unload(Window *window) {
 
 
 static void init(void) {
+  gesture_recognizer_init(&s_recognizer);
+  gesture_store_open(&s_store);
+  app_timer_register(RECOGNIZE_DELAY_MS, recognize_timer_callback, NULL);
   window = window_create();
   window_set_click_config_provider(window, click_config_provider);
   window_set_window_handlers(window, (WindowHandlers) {
@@ -184,6 +332,7 @@ static void init(void) {
 
 static void deinit(void) {
   // deinit accel tap
+  stop_recognizing();
   accel_tap_service_unsubscribe();  
   window_destroy(window);
 }
@@ -0,0 +1,84 @@
+#include <pebble.h>
+#include <gesture_buffer.h>
+
+
+void gesture_buffer_init(GestureBuffer *buf) {
+  buf->next = 0;
+  buf->count = 0;
+}
+
+
+
+void gesture_buffer_push(GestureBuffer *buf, const AccelData *sample) {
+  buf->axes[GESTURE_AXIS_X][buf->next] = sample->x;
+  buf->axes[GESTURE_AXIS_Y][buf->next] = sample->y;
+  buf->axes[GESTURE_AXIS_Z][buf->next] = sample->z;
+
+  buf->next = (buf->next + 1 == GESTURE_BUFFER_SAMPLES) ? 0 : buf->next + 1;
+  if (buf->count < GESTURE_BUFFER_SAMPLES) {
+    buf->count++;
+  }
+}
+
+
+
+uint16_t gesture_buffer_count(const GestureBuffer *buf) {
+  return buf->count;
+}
+
+
+
+static inline uint16_t oldest_index(const GestureBuffer *buf) {
+  return (buf->count < GESTURE_BUFFER_SAMPLES) ? 0 : buf->next;
+}
+
+
+
+/*
+	Sample i of an axis, 0 being the oldest.
+*/
+int16_t gesture_buffer_get(const GestureBuffer *buf, GestureAxis axis, uint16_t i) {
+  uint32_t index = oldest_index(buf) + i;
+  if (index >= GESTURE_BUFFER_SAMPLES) {
+    index -= GESTURE_BUFFER_SAMPLES;
+  }
+  return buf->axes[axis][index];
+}
+
+
+
+GestureSpan gesture_buffer_span(const GestureBuffer *buf, GestureAxis axis) {
+  const int16_t *values = buf->axes[axis];
+  uint16_t oldest = oldest_index(buf);
+  uint16_t first_count = (oldest + buf->count <= GESTURE_BUFFER_SAMPLES) ?
+                         buf->count : (GESTURE_BUFFER_SAMPLES - oldest);
+
+  return (GestureSpan) {
+    .first = &values[oldest],
+    .first_count = first_count,
+    .second = values,
+    .second_count = buf->count - first_count,
+  };
+}
+
+
+
+/*
+	Copies samples first .. first + count - 1 of an
+	axis (0 being the oldest) with at most two memcpys.
+*/
+void gesture_buffer_copy(const GestureBuffer *buf, GestureAxis axis, uint16_t first, uint16_t count, int16_t *out) {
+  GestureSpan span = gesture_buffer_span(buf, axis);
+  if (first < span.first_count) {
+    uint16_t n = (count < span.first_count - first) ? count : (span.first_count - first);
+    memcpy(out, &span.first[first], n * sizeof(int16_t));
+    out += n;
+    count -= n;
+    first = 0;
+  } else {
+    first -= span.first_count;
+  }
+  if (count > 0) {
+    memcpy(out, &span.second[first], count * sizeof(int16_t));
+  }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+/*
+	Structure-of-arrays ring buffer of accelerometer samples.
+
+	Only x, y and z are kept, as three int16 arrays: 6 bytes a
+	sample instead of the 16 of an AccelData (did_vibrate and the
+	64-bit timestamp are never used). GESTURE_BUFFER_SAMPLES is
+	625, 25 s at 25 Hz in 3750 bytes, where the old AccelData
+	history took 4000 bytes for 250 samples. Once full, the
+	oldest samples are overwritten.
+
+	Each axis is contiguous, so scans (the console dump, template
+	matching) read it as at most two runs, see gesture_buffer_span().
+*/
+
+#include <pebble.h>
+
+#define GESTURE_BUFFER_SAMPLES 625	// 25 s at 25 Hz, 3750 bytes
+
+typedef enum {
+  GESTURE_AXIS_X = 0,
+  GESTURE_AXIS_Y,
+  GESTURE_AXIS_Z,
+  GESTURE_AXES,
+} GestureAxis;
+
+typedef struct {
+  int16_t axes[GESTURE_AXES][GESTURE_BUFFER_SAMPLES];
+  uint16_t next;		// Index the next sample goes to
+  uint16_t count;
+} GestureBuffer;
+
+// An axis, oldest sample first, as two contiguous runs (the second may be empty)
+typedef struct {
+  const int16_t *first;
+  uint16_t first_count;
+  const int16_t *second;
+  uint16_t second_count;
+} GestureSpan;
+
+void gesture_buffer_init(GestureBuffer *buf);
+void gesture_buffer_push(GestureBuffer *buf, const AccelData *sample);
+uint16_t gesture_buffer_count(const GestureBuffer *buf);
+int16_t gesture_buffer_get(const GestureBuffer *buf, GestureAxis axis, uint16_t i);
+GestureSpan gesture_buffer_span(const GestureBuffer *buf, GestureAxis axis);
+void gesture_buffer_copy(const GestureBuffer *buf, GestureAxis axis, uint16_t first, uint16_t count, int16_t *out);
@@ -0,0 +1,58 @@
+#include <pebble.h>
+#include <gesture_export.h>
+
+static uint16_t s_recording;
+
+
+static void fill_chunk(GestureChunk *chunk, const GestureBuffer *buf, uint16_t first, uint8_t count) {
+  for (int axis = 0; axis < GESTURE_AXES; axis++) {
+    gesture_buffer_copy(buf, axis, first, count, chunk->axes[axis]);
+    memset(&chunk->axes[axis][count], 0, (GESTURE_CHUNK_SAMPLES - count) * sizeof(int16_t));
+  }
+}
+
+
+
+/*
+	Logs the whole recording as GestureChunks in a
+	session of its own and finishes it.
+*/
+GestureExportResult gesture_export(const GestureBuffer *buf, uint8_t rate_hz) {
+  GestureExportResult result = { 0, 0 };
+  uint16_t total = gesture_buffer_count(buf);
+  uint16_t num_chunks = (total + GESTURE_CHUNK_SAMPLES - 1) / GESTURE_CHUNK_SAMPLES;
+
+  if (s_recording == 0) {
+    s_recording = (uint16_t)time(NULL);		// Distinct across app runs
+  }
+  s_recording++;
+
+  DataLoggingSessionRef session = data_logging_create(GESTURE_EXPORT_TAG, DATA_LOGGING_BYTE_ARRAY,
+                                                      sizeof(GestureChunk), false);
+  static GestureChunk chunk;
+
+  for (uint16_t seq = 0; seq < num_chunks; seq++) {
+    uint16_t first = seq * GESTURE_CHUNK_SAMPLES;
+    uint8_t count = (total - first < GESTURE_CHUNK_SAMPLES) ? (total - first) : GESTURE_CHUNK_SAMPLES;
+
+    chunk.magic = GESTURE_CHUNK_MAGIC;
+    chunk.version = GESTURE_CHUNK_VERSION;
+    chunk.recording = s_recording;
+    chunk.seq = seq;
+    chunk.num_chunks = num_chunks;
+    chunk.total_samples = total;
+    chunk.count = count;
+    chunk.rate_hz = rate_hz;
+    fill_chunk(&chunk, buf, first, count);
+    chunk.checksum = gesture_chunk_checksum(&chunk);
+
+    if (data_logging_log(session, &chunk, 1) == DATA_LOGGING_SUCCESS) {
+      result.chunks++;
+    } else {
+      result.failed++;
+    }
+  }
+
+  data_logging_finish(session);
+  return result;
+}
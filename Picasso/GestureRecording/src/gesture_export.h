@@ -0,0 +1,55 @@
+#pragma once
+
+/*
+	Binary export of a recorded gesture over data logging.
+
+	The recording is cut into fixed-size GestureChunks, one
+	DATA_LOGGING_BYTE_ARRAY item each, logged to a session that is
+	finished when the last chunk is in. A chunk carries its
+	sequence number and the chunk count, so the receiver can put
+	the recording back together and tell what is missing, and
+	ends with a Fletcher-16 checksum of everything before it.
+	Samples are packed per axis, like the GestureBuffer.
+
+	A 25 s recording is 20 chunks, about 4 KB, in 20 calls;
+	the console dump it replaces was 625 formatted APP_LOG lines.
+*/
+
+#include <pebble.h>
+#include <gesture_buffer.h>
+
+#define GESTURE_EXPORT_TAG 0x9e57
+#define GESTURE_CHUNK_MAGIC 0x47	// 'G'
+#define GESTURE_CHUNK_VERSION 1
+#define GESTURE_CHUNK_SAMPLES 32
+
+// 206 bytes; every field is naturally aligned, so there is no padding
+typedef struct {
+  uint8_t magic;
+  uint8_t version;
+  uint16_t recording;		// Changes with every export
+  uint16_t seq;			// 0 .. num_chunks - 1
+  uint16_t num_chunks;
+  uint16_t total_samples;
+  uint8_t count;		// Samples used in this chunk
+  uint8_t rate_hz;
+  int16_t axes[GESTURE_AXES][GESTURE_CHUNK_SAMPLES];
+  uint16_t checksum;		// Fletcher-16 of all the bytes above, little endian
+} GestureChunk;
+
+typedef struct {
+  uint16_t chunks;		// Chunks logged
+  uint16_t failed;		// Chunks data logging refused
+} GestureExportResult;
+
+GestureExportResult gesture_export(const GestureBuffer *buf, uint8_t rate_hz);
+
+static inline uint16_t gesture_chunk_checksum(const GestureChunk *chunk) {
+  const uint8_t *bytes = (const uint8_t *)chunk;
+  uint32_t sum1 = 0, sum2 = 0;
+  for (uint32_t i = 0; i < offsetof(GestureChunk, checksum); i++) {
+    sum1 = (sum1 + bytes[i]) % 255;
+    sum2 = (sum2 + sum1) % 255;
+  }
+  return (uint16_t)((sum2 << 8) | sum1);
+}
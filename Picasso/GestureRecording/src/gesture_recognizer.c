@@ -0,0 +1,343 @@
+#include <pebble.h>
+#include <gesture_recognizer.h>
+
+#define N GESTURE_TEMPLATE_SAMPLES
+#define R GESTURE_BAND
+#define INFINITE_DISTANCE (INT32_MAX / 2)	// Still safe to add a step cost to
+
+
+void gesture_recognizer_init(GestureRecognizer *rec) {
+  memset(rec, 0, sizeof(*rec));
+}
+
+
+
+/*
+	Forgets the live window, keeps the templates.
+*/
+void gesture_recognizer_reset(GestureRecognizer *rec) {
+  rec->next = 0;
+  rec->count = 0;
+  rec->holdoff = 0;
+}
+
+
+
+static inline int32_t abs32(int32_t value) {
+  return (value < 0) ? -value : value;
+}
+
+
+
+/*
+	Start of the most active N samples of a recording: the
+	stretch with the largest sum of sample to sample changes.
+*/
+static uint16_t most_active_start(const GestureBuffer *recording) {
+  uint16_t count = gesture_buffer_count(recording);
+  int32_t activity = 0;
+  int32_t best_activity = -1;
+  uint16_t best_start = 0;
+
+  for (uint16_t i = 1; i < count; i++) {
+    for (int axis = 0; axis < GESTURE_AXES; axis++) {
+      activity += abs32(gesture_buffer_get(recording, axis, i) - gesture_buffer_get(recording, axis, i - 1));
+      if (i >= N) {
+        activity -= abs32(gesture_buffer_get(recording, axis, i - N + 1) -
+                          gesture_buffer_get(recording, axis, i - N));
+      }
+    }
+    if ((i >= N - 1) && (activity > best_activity)) {
+      best_activity = activity;
+      best_start = i - (N - 1);
+    }
+  }
+  return best_start;
+}
+
+
+
+static void build_envelope(GestureTemplate *template) {
+  for (int axis = 0; axis < GESTURE_AXES; axis++) {
+    const int16_t *values = template->axes[axis];
+    for (int i = 0; i < N; i++) {
+      int first = (i > R) ? (i - R) : 0;
+      int last = (i + R < N) ? (i + R) : (N - 1);
+      int16_t upper = values[first];
+      int16_t lower = values[first];
+      for (int j = first + 1; j <= last; j++) {
+        upper = (values[j] > upper) ? values[j] : upper;
+        lower = (values[j] < lower) ? values[j] : lower;
+      }
+      template->upper[axis][i] = upper;
+      template->lower[axis][i] = lower;
+    }
+  }
+}
+
+
+
+/*
+	A window matches when it is GESTURE_MATCH_PERCENT closer
+	to the template than holding still at the template's mean
+	is, so big gestures tolerate bigger differences.
+*/
+static int32_t match_threshold(const GestureTemplate *template) {
+  int32_t still = 0;
+  for (int axis = 0; axis < GESTURE_AXES; axis++) {
+    int32_t sum = 0;
+    for (int i = 0; i < N; i++) {
+      sum += template->axes[axis][i];
+    }
+    int32_t mean = sum / N;
+    for (int i = 0; i < N; i++) {
+      still += abs32(template->axes[axis][i] - mean);
+    }
+  }
+  int32_t threshold = (still * GESTURE_MATCH_PERCENT) / 100;
+  int32_t floor = N * GESTURE_AXES * GESTURE_MIN_MATCH_MG;
+  return (threshold > floor) ? threshold : floor;
+}
+
+
+
+static int add_template(GestureRecognizer *rec, GestureTemplate *template) {
+  build_envelope(template);
+  template->threshold = match_threshold(template);
+  return rec->num_templates++;
+}
+
+
+
+/*
+	Adds the most active N samples of a recording as a
+	template. Returns its index, or -1 when the recognizer
+	is full or the recording is too short.
+*/
+int gesture_recognizer_add(GestureRecognizer *rec, const GestureBuffer *recording) {
+  if ((rec->num_templates == GESTURE_MAX_TEMPLATES) || (gesture_buffer_count(recording) < N)) {
+    return -1;
+  }
+
+  GestureTemplate *template = &rec->templates[rec->num_templates];
+  uint16_t start = most_active_start(recording);
+  for (int axis = 0; axis < GESTURE_AXES; axis++) {
+    gesture_buffer_copy(recording, axis, start, N, template->axes[axis]);
+  }
+  return add_template(rec, template);
+}
+
+
+
+/*
+	Adds a template saved earlier, see gesture_store.h.
+*/
+int gesture_recognizer_add_samples(GestureRecognizer *rec, const int16_t axes[GESTURE_AXES][N]) {
+  if (rec->num_templates == GESTURE_MAX_TEMPLATES) {
+    return -1;
+  }
+
+  GestureTemplate *template = &rec->templates[rec->num_templates];
+  memcpy(template->axes, axes, sizeof(template->axes));
+  return add_template(rec, template);
+}
+
+
+
+/*
+	Removes a template; the ones after it move down.
+*/
+void gesture_recognizer_remove(GestureRecognizer *rec, uint8_t template) {
+  if (template >= rec->num_templates) {
+    return;
+  }
+  memmove(&rec->templates[template], &rec->templates[template + 1],
+          (rec->num_templates - template - 1) * sizeof(GestureTemplate));
+  rec->num_templates--;
+}
+
+
+
+static inline int32_t sample_distance(const int16_t *window[GESTURE_AXES], int i,
+                                      const GestureTemplate *template, int j) {
+  return abs32(window[GESTURE_AXIS_X][i] - template->axes[GESTURE_AXIS_X][j]) +
+         abs32(window[GESTURE_AXIS_Y][i] - template->axes[GESTURE_AXIS_Y][j]) +
+         abs32(window[GESTURE_AXIS_Z][i] - template->axes[GESTURE_AXIS_Z][j]);
+}
+
+
+
+static inline int32_t envelope_distance(int16_t value, int16_t upper, int16_t lower) {
+  if (value > upper) {
+    return value - upper;
+  }
+  if (value < lower) {
+    return lower - value;
+  }
+  return 0;
+}
+
+
+
+/*
+	LB_Keogh, abandoned once it exceeds bound. Leaves
+	in remaining[i] the bound's share of samples i..N-1,
+	which the DTW uses to abandon early.
+*/
+static int32_t lb_keogh(const int16_t *window[GESTURE_AXES], const GestureTemplate *template,
+                        int32_t bound, int32_t remaining[N + 1]) {
+  int32_t share[N];
+  int32_t sum = 0;
+
+  for (int i = 0; i < N; i++) {
+    share[i] = envelope_distance(window[GESTURE_AXIS_X][i], template->upper[GESTURE_AXIS_X][i],
+                                 template->lower[GESTURE_AXIS_X][i]) +
+               envelope_distance(window[GESTURE_AXIS_Y][i], template->upper[GESTURE_AXIS_Y][i],
+                                 template->lower[GESTURE_AXIS_Y][i]) +
+               envelope_distance(window[GESTURE_AXIS_Z][i], template->upper[GESTURE_AXIS_Z][i],
+                                 template->lower[GESTURE_AXIS_Z][i]);
+    sum += share[i];
+    if (sum > bound) {
+      return sum;
+    }
+  }
+
+  remaining[N] = 0;
+  for (int i = N - 1; i >= 0; i--) {
+    remaining[i] = remaining[i + 1] + share[i];
+  }
+  return sum;
+}
+
+
+
+/*
+	DTW distance within the band, two rows at a time.
+	Returns INFINITE_DISTANCE once the distance is sure
+	to exceed bound.
+*/
+static int32_t dtw(GestureRecognizer *rec, const int16_t *window[GESTURE_AXES], const GestureTemplate *template,
+                   int32_t bound, const int32_t remaining[N + 1]) {
+  int32_t rows[2][N];
+  int32_t *prev = rows[0];
+  int32_t *cur = rows[1];
+
+  for (int i = 0; i < N; i++) {
+    int first = (i > R) ? (i - R) : 0;
+    int last = (i + R < N) ? (i + R) : (N - 1);
+    int32_t row_min = INFINITE_DISTANCE;
+    rec->stats.dtw_cells += last - first + 1;
+
+    for (int j = first; j <= last; j++) {
+      int32_t best;
+      if ((i == 0) && (j == 0)) {
+        best = 0;
+      } else {
+        best = INFINITE_DISTANCE;
+        if ((i > 0) && (j > 0) && (prev[j - 1] < best)) {
+          best = prev[j - 1];
+        }
+        if ((i > 0) && (j <= i - 1 + R) && (prev[j] < best)) {	// prev[j] is in the previous row's band
+          best = prev[j];
+        }
+        if ((j > first) && (cur[j - 1] < best)) {
+          best = cur[j - 1];
+        }
+      }
+      cur[j] = (best < INFINITE_DISTANCE) ? (best + sample_distance(window, i, template, j)) : INFINITE_DISTANCE;
+      if (cur[j] < row_min) {
+        row_min = cur[j];
+      }
+    }
+
+    if (row_min + remaining[i + 1] > bound) {
+      return INFINITE_DISTANCE;
+    }
+    int32_t *swap = prev;
+    prev = cur;
+    cur = swap;
+  }
+  return prev[N - 1];
+}
+
+
+
+/*
+	Compares the live window with every template.
+	Returns the index of the closest template within
+	its threshold, or -1.
+*/
+static int match_window(GestureRecognizer *rec, int32_t *distance) {
+  const int16_t *window[GESTURE_AXES];
+  for (int axis = 0; axis < GESTURE_AXES; axis++) {
+    window[axis] = &rec->live[axis][rec->next];
+  }
+
+  int best = -1;
+  int32_t best_distance = INFINITE_DISTANCE;
+  int32_t remaining[N + 1];
+  rec->stats.windows++;
+
+  for (int t = 0; t < rec->num_templates; t++) {
+    const GestureTemplate *template = &rec->templates[t];
+    int32_t bound = (best_distance < template->threshold) ? best_distance : template->threshold;
+    rec->stats.comparisons++;
+
+    if (sample_distance(window, 0, template, 0) + sample_distance(window, N - 1, template, N - 1) > bound) {
+      rec->stats.kim_pruned++;
+      continue;
+    }
+    if (lb_keogh(window, template, bound, remaining) > bound) {
+      rec->stats.keogh_pruned++;
+      continue;
+    }
+    int32_t d = dtw(rec, window, template, bound, remaining);
+    if (d > bound) {
+      rec->stats.dtw_rejected++;
+      continue;
+    }
+    rec->stats.dtw_accepted++;
+    best = t;
+    best_distance = d;
+  }
+
+  *distance = best_distance;
+  return best;
+}
+
+
+
+/*
+	Adds a sample to the live window and compares the
+	window with the templates. Returns true, and fills
+	match, when it matches one. A matched window has to
+	slide out completely before the next match.
+*/
+bool gesture_recognizer_push(GestureRecognizer *rec, const AccelData *sample, GestureMatch *match) {
+  rec->live[GESTURE_AXIS_X][rec->next] = rec->live[GESTURE_AXIS_X][rec->next + N] = sample->x;
+  rec->live[GESTURE_AXIS_Y][rec->next] = rec->live[GESTURE_AXIS_Y][rec->next + N] = sample->y;
+  rec->live[GESTURE_AXIS_Z][rec->next] = rec->live[GESTURE_AXIS_Z][rec->next + N] = sample->z;
+  rec->next = (rec->next + 1 == N) ? 0 : rec->next + 1;
+  if (rec->count < N) {
+    rec->count++;
+  }
+
+  if (rec->holdoff > 0) {
+    rec->holdoff--;
+    return false;
+  }
+  if ((rec->count < N) || (rec->num_templates == 0)) {
+    return false;
+  }
+
+  int32_t distance;
+  int t = match_window(rec, &distance);
+  if (t < 0) {
+    return false;
+  }
+  rec->stats.matches++;
+  rec->holdoff = N - 1;
+  match->template = t;
+  match->distance = distance;
+  return true;
+}
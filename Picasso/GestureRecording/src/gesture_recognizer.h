@@ -0,0 +1,79 @@
+#pragma once
+
+/*
+	Continuous gesture recognizer.
+
+	Every new sample completes a window of the last
+	GESTURE_TEMPLATE_SAMPLES samples, which is compared with each
+	stored template by dynamic time warping. The warping path is
+	kept within GESTURE_BAND samples of the diagonal (Sakoe-Chiba
+	band) and the cost of a step is the L1 distance between two
+	samples, in milli-g, so the whole distance is integer math.
+
+	Most windows look nothing like any template, so they are
+	rejected before the full DTW is run, cheapest test first:
+	  1. LB_Kim: every warping path pairs the first samples and the
+	     last samples, so their two distances are a lower bound;
+	  2. LB_Keogh: the distance of the window to the template's
+	     band envelope, abandoned as soon as it exceeds the bound;
+	  3. DTW itself, abandoned once the cheapest cell of a row plus
+	     the LB_Keogh share of the rows left exceeds the bound.
+	The bound is the template's threshold, or the best distance
+	found so far for the window when that is lower.
+
+	A window costs about 3 * N adds when LB_Keogh rejects it and
+	3 * N * (2 * GESTURE_BAND + 1) when the DTW runs to the end.
+*/
+
+#include <pebble.h>
+#include <gesture_buffer.h>
+
+#define GESTURE_TEMPLATE_SAMPLES 50	// 2 s at 25 Hz
+#define GESTURE_MAX_TEMPLATES 4
+#define GESTURE_BAND 5			// Sakoe-Chiba radius, samples
+#define GESTURE_MATCH_PERCENT 40		// Of the template's distance to holding still
+#define GESTURE_MIN_MATCH_MG 30		// Threshold floor per axis and sample, sensor noise
+
+typedef struct {
+  int16_t axes[GESTURE_AXES][GESTURE_TEMPLATE_SAMPLES];
+  int16_t upper[GESTURE_AXES][GESTURE_TEMPLATE_SAMPLES];	// Max of axes[] over the band
+  int16_t lower[GESTURE_AXES][GESTURE_TEMPLATE_SAMPLES];	// Min of axes[] over the band
+  int32_t threshold;		// Largest DTW distance that is a match, see gesture_recognizer_add()
+} GestureTemplate;
+
+typedef struct {
+  uint32_t windows;		// Windows compared, all templates
+  uint32_t comparisons;		// Window / template pairs
+  uint32_t kim_pruned;
+  uint32_t keogh_pruned;
+  uint32_t dtw_rejected;	// Above the bound, most of them abandoned early
+  uint32_t dtw_accepted;
+  uint32_t dtw_cells;		// Cells computed, all DTW runs
+  uint32_t matches;
+} GestureRecognizerStats;
+
+typedef struct {
+  GestureTemplate templates[GESTURE_MAX_TEMPLATES];
+  uint8_t num_templates;
+
+  // Each sample is stored at i and i + N, so the window always is
+  // live[axis][next .. next + N - 1], oldest first
+  int16_t live[GESTURE_AXES][2 * GESTURE_TEMPLATE_SAMPLES];
+  uint8_t next;
+  uint8_t count;
+  uint8_t holdoff;		// Samples left before a matched window can match again
+
+  GestureRecognizerStats stats;
+} GestureRecognizer;
+
+typedef struct {
+  uint8_t template;
+  int32_t distance;
+} GestureMatch;
+
+void gesture_recognizer_init(GestureRecognizer *rec);
+void gesture_recognizer_reset(GestureRecognizer *rec);
+int gesture_recognizer_add(GestureRecognizer *rec, const GestureBuffer *recording);
+int gesture_recognizer_add_samples(GestureRecognizer *rec, const int16_t axes[GESTURE_AXES][GESTURE_TEMPLATE_SAMPLES]);
+void gesture_recognizer_remove(GestureRecognizer *rec, uint8_t template);
+bool gesture_recognizer_push(GestureRecognizer *rec, const AccelData *sample, GestureMatch *match);
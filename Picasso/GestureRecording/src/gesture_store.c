@@ -0,0 +1,220 @@
+#include <pebble.h>
+#include <gesture_store.h>
+
+#define N GESTURE_TEMPLATE_SAMPLES
+
+static uint8_t s_encoded[GESTURE_STORE_MAX_BYTES];
+
+
+static uint16_t fletcher16(const uint8_t *bytes, uint32_t length) {
+  uint32_t sum1 = 0, sum2 = 0;
+  for (uint32_t i = 0; i < length; i++) {
+    sum1 = (sum1 + bytes[i]) % 255;
+    sum2 = (sum2 + sum1) % 255;
+  }
+  return (uint16_t)((sum2 << 8) | sum1);
+}
+
+
+
+static bool write_index(const GestureStore *store) {
+  return persist_write_data(GESTURE_STORE_INDEX_KEY, store, sizeof(*store)) == (int)sizeof(*store);
+}
+
+
+
+/*
+	Reads the index only. A missing or unknown index
+	is an empty library.
+*/
+void gesture_store_open(GestureStore *store) {
+  int read = persist_read_data(GESTURE_STORE_INDEX_KEY, store, sizeof(*store));
+  if ((read != (int)sizeof(*store)) || (store->magic != GESTURE_STORE_MAGIC) ||
+      (store->version != GESTURE_STORE_VERSION) || (store->count > GESTURE_STORE_MAX_TEMPLATES)) {
+    memset(store, 0, sizeof(*store));
+    store->magic = GESTURE_STORE_MAGIC;
+    store->version = GESTURE_STORE_VERSION;
+  }
+}
+
+
+
+uint8_t gesture_store_count(const GestureStore *store) {
+  return store->count;
+}
+
+
+
+const char *gesture_store_name(const GestureStore *store, uint8_t i) {
+  return (i < store->count) ? store->entries[i].name : NULL;
+}
+
+
+
+static inline int16_t quantize(int16_t value) {
+  int32_t half = (value < 0) ? -(GESTURE_STORE_QUANT_MG / 2) : (GESTURE_STORE_QUANT_MG / 2);
+  return (value + half) / GESTURE_STORE_QUANT_MG;
+}
+
+
+
+static uint32_t encode(const int16_t axes[GESTURE_AXES][N], uint8_t *out) {
+  uint32_t used = 0;
+  for (int axis = 0; axis < GESTURE_AXES; axis++) {
+    int32_t previous = 0;
+    for (int i = 0; i < N; i++) {
+      int32_t value = quantize(axes[axis][i]);
+      int32_t delta = value - previous;
+      uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+      previous = value;
+      while (zigzag >= 0x80) {
+        out[used++] = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+      }
+      out[used++] = (uint8_t)zigzag;
+    }
+  }
+  return used;
+}
+
+
+
+static bool decode(const uint8_t *in, uint32_t length, int16_t axes[GESTURE_AXES][N]) {
+  uint32_t pos = 0;
+  for (int axis = 0; axis < GESTURE_AXES; axis++) {
+    int32_t value = 0;
+    for (int i = 0; i < N; i++) {
+      uint32_t zigzag = 0;
+      int shift = 0;
+      do {
+        if ((pos == length) || (shift > 14)) {
+          return false;
+        }
+        zigzag |= (uint32_t)(in[pos] & 0x7f) << shift;
+        shift += 7;
+      } while (in[pos++] & 0x80);
+      value += (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+      axes[axis][i] = value * GESTURE_STORE_QUANT_MG;
+    }
+  }
+  return pos == length;
+}
+
+
+
+/*
+	Reads, checks and decodes template i.
+*/
+bool gesture_store_load(const GestureStore *store, uint8_t i, int16_t axes[GESTURE_AXES][N]) {
+  if (i >= store->count) {
+    return false;
+  }
+  const GestureStoreEntry *entry = &store->entries[i];
+  if (entry->bytes > sizeof(s_encoded)) {
+    return false;
+  }
+
+  uint32_t pos = 0;
+  for (uint8_t chunk = 0; chunk < entry->num_chunks; chunk++) {
+    uint32_t length = entry->bytes - pos;
+    if (length > PERSIST_DATA_MAX_LENGTH) {
+      length = PERSIST_DATA_MAX_LENGTH;
+    }
+    if (persist_read_data(GESTURE_STORE_CHUNK_KEY(entry->id, chunk), &s_encoded[pos], length) != (int)length) {
+      return false;
+    }
+    pos += length;
+  }
+  return (pos == entry->bytes) && (fletcher16(s_encoded, pos) == entry->checksum) &&
+         decode(s_encoded, pos, axes);
+}
+
+
+
+static uint8_t next_id(const GestureStore *store) {
+  uint8_t id = store->last_id;
+  for (;;) {
+    id = (id == UINT8_MAX) ? 1 : (id + 1);
+    bool used = false;
+    for (uint8_t i = 0; i < store->count; i++) {
+      used |= (store->entries[i].id == id);
+    }
+    if (!used) {
+      return id;
+    }
+  }
+}
+
+
+
+static void delete_chunks(uint8_t id, uint8_t num_chunks) {
+  for (uint8_t chunk = 0; chunk < num_chunks; chunk++) {
+    persist_delete(GESTURE_STORE_CHUNK_KEY(id, chunk));
+  }
+}
+
+
+
+/*
+	Saves a template as the newest entry, named "Gesture
+	<id>" when name is NULL. Returns its index, or -1 when
+	the library is full or storage refused the write.
+*/
+int gesture_store_save(GestureStore *store, const int16_t axes[GESTURE_AXES][N], const char *name) {
+  if (store->count == GESTURE_STORE_MAX_TEMPLATES) {
+    return -1;
+  }
+
+  uint32_t bytes = encode(axes, s_encoded);
+  GestureStoreEntry entry = {
+    .id = next_id(store),
+    .num_chunks = (bytes + PERSIST_DATA_MAX_LENGTH - 1) / PERSIST_DATA_MAX_LENGTH,
+    .bytes = bytes,
+    .checksum = fletcher16(s_encoded, bytes),
+  };
+  if (name) {
+    strncpy(entry.name, name, GESTURE_STORE_NAME_LENGTH - 1);
+  } else {
+    snprintf(entry.name, GESTURE_STORE_NAME_LENGTH, "Gesture %d", entry.id);
+  }
+
+  for (uint8_t chunk = 0; chunk < entry.num_chunks; chunk++) {
+    uint32_t first = chunk * PERSIST_DATA_MAX_LENGTH;
+    uint32_t length = (bytes - first < PERSIST_DATA_MAX_LENGTH) ? (bytes - first) : PERSIST_DATA_MAX_LENGTH;
+    if (persist_write_data(GESTURE_STORE_CHUNK_KEY(entry.id, chunk), &s_encoded[first], length) != (int)length) {
+      delete_chunks(entry.id, chunk + 1);
+      return -1;
+    }
+  }
+
+  store->entries[store->count++] = entry;
+  store->last_id = entry.id;
+  if (!write_index(store)) {
+    store->count--;
+    delete_chunks(entry.id, entry.num_chunks);
+    return -1;
+  }
+  return store->count - 1;
+}
+
+
+
+/*
+	Deletes template i; the ones after it move down.
+*/
+bool gesture_store_delete(GestureStore *store, uint8_t i) {
+  if (i >= store->count) {
+    return false;
+  }
+  GestureStoreEntry entry = store->entries[i];
+  memmove(&store->entries[i], &store->entries[i + 1], (store->count - i - 1) * sizeof(GestureStoreEntry));
+  store->count--;
+  memset(&store->entries[store->count], 0, sizeof(GestureStoreEntry));
+
+  if (!write_index(store)) {
+    gesture_store_open(store);		// Back to what is saved
+    return false;
+  }
+  delete_chunks(entry.id, entry.num_chunks);
+  return true;
+}
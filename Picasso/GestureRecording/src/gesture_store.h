@@ -0,0 +1,68 @@
+#pragma once
+
+/*
+	Gesture template library in persistent storage.
+
+	An index, one persist value read at startup, names the
+	saved templates; a template's samples are only read when
+	gesture_store_load() asks for them.
+
+	A template is stored quantized to GESTURE_STORE_QUANT_MG and
+	delta coded, axis after axis: the zig-zag varint of each
+	sample's difference from the previous one (the first from 0).
+	Consecutive samples of a gesture are close, so most deltas
+	take one byte and a 300 byte template takes about half that.
+	The encoding is cut into values of PERSIST_DATA_MAX_LENGTH
+	bytes at most; the index keeps their number, the length and
+	a Fletcher-16 checksum of the whole encoding.
+
+	Keys: GESTURE_STORE_INDEX_KEY for the index, and
+	GESTURE_STORE_CHUNK_KEY(id, chunk) for a template's values.
+	Chunks are written before the index that refers to them and
+	deleted after, so an interrupted save or delete leaves the
+	previous library intact. An index of another version is
+	ignored: the library starts empty.
+*/
+
+#include <pebble.h>
+#include <gesture_recognizer.h>
+
+#define GESTURE_STORE_VERSION 1
+#define GESTURE_STORE_MAGIC 0x67	// 'g'
+#define GESTURE_STORE_MAX_TEMPLATES GESTURE_MAX_TEMPLATES
+#define GESTURE_STORE_NAME_LENGTH 12	// With the terminating 0
+#define GESTURE_STORE_QUANT_MG 8
+
+#define GESTURE_STORE_INDEX_KEY 0x67000000
+#define GESTURE_STORE_CHUNK_KEY(id, chunk) (GESTURE_STORE_INDEX_KEY + ((uint32_t)(id) << 8) + (chunk))
+
+// Varints of 16-bit zig-zag deltas are at most 3 bytes
+#define GESTURE_STORE_MAX_BYTES (GESTURE_AXES * GESTURE_TEMPLATE_SAMPLES * 3)
+#define GESTURE_STORE_MAX_CHUNKS ((GESTURE_STORE_MAX_BYTES + PERSIST_DATA_MAX_LENGTH - 1) / PERSIST_DATA_MAX_LENGTH)
+
+// 18 bytes, no padding
+typedef struct {
+  uint8_t id;			// 1-255, never reused while saved
+  uint8_t num_chunks;
+  uint16_t bytes;		// Length of the encoding
+  uint16_t checksum;		// Fletcher-16 of the encoding
+  char name[GESTURE_STORE_NAME_LENGTH];
+} GestureStoreEntry;
+
+// The index as persisted, 76 bytes
+typedef struct {
+  uint8_t magic;
+  uint8_t version;
+  uint8_t count;
+  uint8_t last_id;
+  GestureStoreEntry entries[GESTURE_STORE_MAX_TEMPLATES];	// Oldest first
+} GestureStore;
+
+void gesture_store_open(GestureStore *store);
+uint8_t gesture_store_count(const GestureStore *store);
+const char *gesture_store_name(const GestureStore *store, uint8_t i);
+bool gesture_store_load(const GestureStore *store, uint8_t i,
+                        int16_t axes[GESTURE_AXES][GESTURE_TEMPLATE_SAMPLES]);
+int gesture_store_save(GestureStore *store, const int16_t axes[GESTURE_AXES][GESTURE_TEMPLATE_SAMPLES],
+                       const char *name);
+bool gesture_store_delete(GestureStore *store, uint8_t i);
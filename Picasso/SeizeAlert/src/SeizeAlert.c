@@ -15,18 +15,52 @@
 #include <pebble.h>
 #include <pebble_fonts.h>
 #include <SeizeAlert.h>
-
-#define ALERT_WINDOW 10
-
-#define STEP_ONE_LOWER_BOUND 800
-#define STEP_ONE_HIGHER_BOUND 1000
-#define STEP_ONE_SAMPLES 4
-
-#define STEP_TWO_LOWER_BOUND 500
-#define STEP_TWO_SAMPLES 25
-
-#define STEP_THREE_HIGHER_BOUND 100
-#define STEP_THREE_SAMPLES 50
+#include <detector.h>
+#include <seizure_detector.h>
+#include <event_log.h>
+#include <resource_cache.h>
+#include <profile.h>
+#include <rate_controller.h>
+#include <pretrigger.h>
+#include <blackbox.h>
+#include <detector_profile.h>
+#include <jitter.h>
+#include <scheduler.h>
+#define BATTERY_BAR_WIDTH 11		// Pixels of a full battery
+
+// Samples per accel_data_handler() batch at 25 Hz (25 Hz / 10 = 2.5 wakeups a
+// second); other rates get as many wakeups a second, see batch_samples().
+// Set to 0 to fall back to peeking the accelerometer every timer_frequency ms.
+#ifndef ACCEL_BATCH_SAMPLES
+#define ACCEL_BATCH_SAMPLES 10
+#endif
+
+// Set to 0 to sample at 25 Hz all the time instead of following rate_controller.h,
+// unless the active profile fixes another rate
+#ifndef ACCEL_ADAPTIVE_RATE
+#define ACCEL_ADAPTIVE_RATE 1
+#endif
+
+// At the rest rate, only fill a pre-trigger ring from long batches and start
+// analysing on a tap or an impact. Needs batching and the rate controller.
+#ifndef ACCEL_TAP_WAKE
+#define ACCEL_TAP_WAKE (ACCEL_ADAPTIVE_RATE && (ACCEL_BATCH_SAMPLES > 0))
+#endif
+
+#define MESSAGE_INBOX_SIZE 256		// A whole profile with 32 bit integers is 145 bytes
+#define MESSAGE_OUTBOX_SIZE 32		// The reply: result and active slot
+
+// Tasks on the app's one app_timer (scheduler.h)
+enum {
+  TASK_SAMPLE = 0,			// Peeks, without batching
+  TASK_COUNTDOWN,			// The false alarm countdown and its display
+  TASK_LOG_FLUSH,			// Batched events left waiting too long
+};
+#define COUNTDOWN_SLACK_MS 100		// Unseen on the display, and a batch often comes by then
+#define LOG_FLUSH_PERIOD_MS (60 * 1000)
+
+#define ACCEL_MAX_BATCH 25		// Largest batch run through the detector at once
+#define WAKE_BATCH_SAMPLES ACCEL_MAX_BATCH	// 2.5 s at RATE_REST_HZ while waiting for a tap
 
 //////////////////////////////////////////  Globals  ///////////////////////////////////////////////
 
@@ -55,35 +89,57 @@ static BitmapLayer *logo_layer;
 
 // SeizeAlert logic globals
 static int cntdown_ctr = 0;
+static bool seizealert_screen = false;	// Alert backgrounds are set
 
-static uint8_t battery_level;
+// What the watchface shows, so only changes mark layers dirty
+static uint8_t battery_bar;		// Fill of the battery icon, 0 .. BATTERY_BAR_WIDTH
 static bool battery_plugged;
+static bool bluetooth_connected;
+static int shown_year = -1;		// Date in text_date_layer
+static int shown_yday = -1;
 
 char text_buffer[250];
 int timer_frequency = 40;		// Time setup for timer function in milliseconds
 int countdown_frequency = 1000;		// Time setup for countdown function in milliseconds
-static AppTimer *timer;
+static Scheduler s_scheduler;
 
 bool false_positive = true;		// State of false positive
 bool event_fall = false;
 
 
-// SeizeAlert's FSM variables
-int current_state = 0;
-int step_1_counter = 0;
-int step_2_counter = 0;
-bool step_2_flag = false;
-int step_3_counter = 0;
-bool step_3_flag = false;
-int step_4_counter = 0;
-bool step_4_flag = false;
+// SeizeAlert's fall detector (FSM state and thresholds)
+static Detector s_detector;
+
+// Rhythmic shaking (seizure) detector, runs next to the fall detector
+static SeizureDetector s_seizure_detector;
+static uint8_t s_seizure_phase;		// Decimation of faster rates down to SEIZURE_RATE_HZ
+
+// Accelerometer rate, follows the fall detector
+static RateController s_rate;
+
+// Tap wake: at the rest rate, batches only go to the pre-trigger ring
+#if ACCEL_TAP_WAKE
+static Pretrigger s_pretrigger;
+#endif
+static bool s_watching;
+
+// Motion around the last step one candidate, logged with the fall it led to
+static BlackBox s_blackbox;
+
+// Time between the samples the accelerometer delivers, dumped with UP
+static JitterHistogram s_jitter;
+
+// Detection profiles from the phone, and what the active one sets
+static DetectorProfiles s_profiles;
+static int s_alert_window = ALERT_WINDOW;	// Countdown seconds
+static bool s_adaptive = ACCEL_ADAPTIVE_RATE;	// Rate from the rate controller, else fixed
 
 // Data logging struct
 typedef struct {
   uint32_t tag;
   TextLayer *text_layer;
   char text[20];
-  DataLoggingSessionRef logging_session;
+  EventLog event_log;		// One long-lived session per tag
   int count;
   GBitmap *bitmap;
 } SeizureData;
@@ -99,45 +155,34 @@ static SeizureData s_seizure_datas[3]; // 0 = fall, 1 = seizure, 2 = start of co
 
 /////////////////////////////////////////// SeizeAlert Logic /////////////////////////////////////////////
 
-/*
-	Custom square root function. Math library
-	is not completely included with Pebble SDK. 
-*/
-  float my_sqrt(const float num) {
-  const uint MAX_STEPS = 40;
-  const float MAX_ERROR = 0.001;
-  
-  float answer = num;
-  float ans_sqr = answer * answer;
-  uint step = 0;
-  while((ans_sqr - num > MAX_ERROR) && (step++ < MAX_STEPS)) {
-    answer = (answer + (num / answer)) / 2;
-    ans_sqr = answer * answer;
-  }
-  return answer;
-}
-
-
-
 /*
 	This functions sets the time to next call at 
-	timer_frequency in milliseconds.
+	timer_frequency in milliseconds, and every
+	timer_frequency after that.
 */
 static void set_timer() {
-  timer = app_timer_register(timer_frequency, timer_callback, NULL);
+  scheduler_set(&s_scheduler, TASK_SAMPLE, timer_frequency, timer_frequency, 0, timer_callback, NULL);
+  PROFILE_EXPECT(PROFILE_TIMER, timer_frequency);
 }
 
 
 
+/*
+	Counts down every second from now on; a
+	countdown in progress starts over.
+*/
 static void set_countdown() {
-  timer = app_timer_register(countdown_frequency, countdown_callback, NULL);
+  scheduler_set(&s_scheduler, TASK_COUNTDOWN, countdown_frequency, countdown_frequency, COUNTDOWN_SLACK_MS,
+                countdown_callback, NULL);
+  PROFILE_EXPECT(PROFILE_COUNTDOWN, countdown_frequency);
 }
 
 
 
-static void countdown_callback() {
+static void countdown_callback(void *data) {
+  PROFILE_BEGIN(PROFILE_COUNTDOWN);
   if (!false_positive){
-    if (cntdown_ctr == 10) {
+    if (cntdown_ctr >= s_alert_window) {		// A new profile may have shortened it
       cntdown_ctr = 0;
       text_layer_set_font(text_layer, fonts_get_system_font(FONT_KEY_ROBOTO_CONDENSED_21));
       if (event_fall) {
@@ -147,178 +192,343 @@ static void countdown_callback() {
       } 
       false_positive = true;
       event_fall = false;
+      detector_set_armed(&s_detector, true);
+      scheduler_cancel(&s_scheduler, TASK_COUNTDOWN);
     } else {
-      display_countdown(ALERT_WINDOW - cntdown_ctr);
+      display_countdown(s_alert_window - cntdown_ctr);
       cntdown_ctr++;
-      set_countdown();
+      PROFILE_EXPECT(PROFILE_COUNTDOWN, countdown_frequency);
     }
   }
+  PROFILE_END(PROFILE_COUNTDOWN);
 }
 
 
 
 /*
-	This function peeks the accelerometer,
-	and check if the "select" button has been
-	pressed (false positive). If not, prints
-	values to screen and sets timer to come
-	back here again, using set_timer().
+	Switches to the alert screen and starts
+	the false alarm countdown.
 */
-static void timer_callback() {
-  int test, x, y, z;
-  AccelData accel;
+static void start_countdown(void) {
+  //APP_LOG(APP_LOG_LEVEL_DEBUG, "Step 5 has passed: Countdown has started\n");
+  false_positive = false;
+  event_fall = true;
+  detector_set_armed(&s_detector, false);
+  text_layer_set_font(text_layer, resource_cache_font(RESOURCE_ID_FONT_ROBOTO_BOLD_SUBSET_49));
+  display_countdown(s_alert_window);
+  report_countdown();
+  cntdown_ctr++;
+  text_layer_set_text(text_layer_up, "Fall?");
+  set_countdown();
+}
 
-  // Get last value from accelerometer
-  accel_service_peek(&accel);
 
-  // Calculate accelerometer values
-  x = accel.x;
-  y = accel.y;
-  z = accel.z;
-  x = x * x;
-  y = y * y;
-  z = z * z;
-  
-  test = (int)(abs(my_sqrt(x + y + z)-1000));		// int(abs(sqrt(x^2 + y^2 + z^2)-1000))
 
-  switch( current_state ){
+/*
+	Samples per batch at a rate: as many wakeups a
+	second as ACCEL_BATCH_SAMPLES gives at 25 Hz.
+*/
+static uint32_t batch_samples(AccelSamplingRate rate) {
+  uint32_t samples = (ACCEL_BATCH_SAMPLES * rate) / ACCEL_SAMPLING_25HZ;
+  return (samples < 1) ? 1 : ((samples > ACCEL_MAX_BATCH) ? ACCEL_MAX_BATCH : samples);
+}
+
 
-    case 0:	// Step 0: Normal mode
-      if ((test >= STEP_ONE_LOWER_BOUND) && (test <= STEP_ONE_HIGHER_BOUND) && (false_positive)){
-        current_state++;
-      } else {
-        current_state = 0;
-        break;
-      }
 
-    case 1:	// Step 1: Consecutive values between 800 and 1000 (4 or more)
-      if ((test >= STEP_ONE_LOWER_BOUND) && (test <= STEP_ONE_HIGHER_BOUND)){
-        step_1_counter++;
-        break;
-      } else if (step_1_counter >= STEP_ONE_SAMPLES){
-        //APP_LOG(APP_LOG_LEVEL_DEBUG, "Step 1 has passed: last value is = %d...counter = %d\n", test, step_1_counter);
-        step_1_counter = 0;
-        current_state++;
-      } else {
-        step_1_counter = 0;
-        current_state = 0;
-        break;
-      }
+static uint32_t samples_per_update(void) {
+  return s_watching ? WAKE_BATCH_SAMPLES : batch_samples(s_rate.rate);
+}
 
-    case 2:	// Step 2: Is there any value greater than 500 in the next second?
-      if (test >= STEP_TWO_LOWER_BOUND){
-        step_2_flag = true;
-      }
-      step_2_counter++;
-      if (step_2_counter >= STEP_TWO_SAMPLES){
-        //APP_LOG(APP_LOG_LEVEL_DEBUG, "Step 2 has passed: Checked 1 second (x>500): last value is = %d...counter = %d\n", test, step_2_counter);
-        step_2_counter = 0;
-        if (step_2_flag){
-          step_2_flag = false;
-          current_state++;
-          break;
-        } else {
-          current_state = 0;
-          break;
-        }
-      } else {
-        break;
-      }
 
-    case 3:	// Step 3: Check inactivity 2 seconds (all 50 values less than 100?)
-      if (test >= STEP_THREE_HIGHER_BOUND){
-        step_3_flag = true;
-      }
-      step_3_counter++;
-      if (step_3_counter >= STEP_THREE_SAMPLES){
-        //APP_LOG(APP_LOG_LEVEL_DEBUG, "Step 3 has passed: Checked 2 seconds (x<100?): last value is = %d...counter = %d\n", test, step_3_counter);
-        step_3_counter = 0;
-        if (step_3_flag){
-          step_3_flag = false;
-          current_state++;
-          break;
-        } else {
-          current_state += 2;
-        }
-      } else {
-        break;
-      }
 
-    case 4:	// Step 4: Recheck inactivity 2 seconds (all 50 values less than 100?)
-      if (test >= STEP_THREE_HIGHER_BOUND){
-        step_4_flag = true;
-      }
-      step_4_counter++;
-      if (step_4_counter >= STEP_THREE_SAMPLES){
-        //APP_LOG(APP_LOG_LEVEL_DEBUG, "Step 4 has passed: Re-checked 2 seconds (x<100?): last value is = %d...counter = %d\n", test, step_4_counter);
-        step_4_counter = 0;
-        if (step_4_flag){
-          step_4_flag = false;
-          current_state = 0;
-          break;
-        } else {
-          current_state++;
-        }
-      } else {
-        break;
+/*
+	Samples come at rate from the next batch (or
+	peek) on; the fall detector rescales its steps.
+	The seizure detector is not fed below 25 Hz and
+	starts over when 25 Hz comes back. With tap wake
+	the adaptive rest rate waits for a tap or an
+	impact.
+*/
+static void set_sampling_rate(AccelSamplingRate rate) {
+  jitter_restart(&s_jitter);		// No interval across two rates
+#if ACCEL_TAP_WAKE
+  s_watching = s_adaptive && (rate == RATE_REST_HZ);
+  if (s_watching) {
+    pretrigger_init(&s_pretrigger, RATE_ACTIVE_MG, rate);
+    blackbox_reset(&s_blackbox);	// Only what the pre-trigger ring keeps is contiguous
+  }
+#endif
+  accel_service_set_sampling_rate(rate);
+#if ACCEL_BATCH_SAMPLES > 0
+  accel_service_set_samples_per_update(samples_per_update());
+#else
+  timer_frequency = 1000 / rate;
+  set_timer();
+#endif
+  detector_set_rate(&s_detector, rate);
+  if (rate < SEIZURE_RATE_HZ) {
+    seizure_detector_reset(&s_seizure_detector);
+  }
+}
+
+
+
+static void update_sampling_rate(uint32_t num_samples, bool candidate) {
+#if ACCEL_ADAPTIVE_RATE
+  if (s_adaptive && rate_controller_update(&s_rate, &s_detector, num_samples, candidate)) {
+    set_sampling_rate(s_rate.rate);
+  }
+#endif
+}
+
+
+
+#if ACCEL_TAP_WAKE
+/*
+	A tap or an impact ends the wait: the fall
+	detector catches up on the pre-trigger ring,
+	then analyses live at the rate the controller
+	picks.
+*/
+static void wake_analysis(void) {
+  AccelData samples[ACCEL_MAX_BATCH];
+  uint32_t count;
+  bool candidate = false;
+  while ((count = pretrigger_drain(&s_pretrigger, samples, ARRAY_LENGTH(samples))) > 0) {
+    candidate |= process_samples(samples, count);
+  }
+  rate_controller_wake(&s_rate, &s_detector, candidate);
+  set_sampling_rate(s_rate.rate);
+}
+#endif
+
+
+
+/*
+	Swaps the active profile into the running app,
+	between two batches: the fall detector keeps its
+	window and step, a countdown in progress keeps
+	counting. Samples waiting for a tap are analysed
+	with the old profile first, so none is dropped.
+*/
+static void apply_profile(void) {
+  const DetectorProfile *profile = detector_profiles_active(&s_profiles);
+#if ACCEL_TAP_WAKE
+  if (s_watching) {
+    wake_analysis();
+  }
+#endif
+  detector_set_config(&s_detector, &profile->detector);
+  s_alert_window = profile->alert_window;
+  s_adaptive = ACCEL_ADAPTIVE_RATE && (profile->rate_hz == 0);
+
+  if (profile->rate_hz) {
+    s_rate.rate = profile->rate_hz;
+  } else if (!s_adaptive) {
+    s_rate.rate = RATE_ACTIVE_HZ;
+  }
+  set_sampling_rate(s_rate.rate);
+}
+
+
+
+/*
+	A profile from the phone: stored and, if it is
+	or becomes the active one, applied right away.
+	The phone gets the result and the active slot.
+*/
+static void inbox_received_handler(DictionaryIterator *iterator, void *context) {
+  PROFILE_BEGIN(PROFILE_MESSAGE);
+  bool active_changed;
+  DetectorProfileResult result = detector_profiles_receive(&s_profiles, iterator, &active_changed);
+  if (active_changed) {
+    apply_profile();
+  }
+
+  DictionaryIterator *reply;
+  if (app_message_outbox_begin(&reply) == APP_MSG_OK) {
+    dict_write_uint8(reply, PROFILE_MSG_RESULT, result);
+    dict_write_uint8(reply, PROFILE_MSG_ACTIVATE, s_profiles.active);
+    app_message_outbox_send();
+  }
+  PROFILE_END(PROFILE_MESSAGE);
+}
+
+
+
+/*
+	Runs samples through the fall and seizure
+	detectors and the black box. Starts the
+	countdown if a fall is reported and logs
+	seizure onsets. Returns true if a step one
+	candidate showed up.
+*/
+static bool process_samples(AccelData *data, uint32_t num_samples) {
+  bool candidate = false;
+  DetectorEvent events[DETECTOR_MAX_EVENTS(ACCEL_MAX_BATCH)];
+  uint32_t num_events = detector_feed(&s_detector, data, num_samples, events, ARRAY_LENGTH(events));
+  blackbox_add(&s_blackbox, data, num_samples, s_rate.rate);
+
+  for (uint32_t i = 0; i < num_events; i++) {
+    if (events[i].type == DETECTOR_EVENT_CANDIDATE) {
+      candidate = true;
+      blackbox_trigger(&s_blackbox, num_samples - 1 - events[i].sample);
+    } else if (events[i].type == DETECTOR_EVENT_FALL) {
+      start_countdown();
+    }
+  }
+
+  // The candidate went back to idle without a fall
+  if (false_positive && (s_detector.state == DETECTOR_IDLE)) {
+    blackbox_release(&s_blackbox);
+  }
+
+  // The seizure detector's filters are for SEIZURE_RATE_HZ
+  if (s_rate.rate < SEIZURE_RATE_HZ) {
+    return candidate;
+  }
+  uint32_t step = s_rate.rate / SEIZURE_RATE_HZ;
+  AccelData decimated[ACCEL_MAX_BATCH];
+  if (step > 1) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < num_samples; i++) {
+      if (s_seizure_phase == 0) {
+        decimated[count++] = data[i];
       }
+      s_seizure_phase = (s_seizure_phase + 1) % step;
+    }
+    data = decimated;
+    num_samples = count;
+  }
 
-    case 5:	// Step 5: Start Countdown
-      //APP_LOG(APP_LOG_LEVEL_DEBUG, "Step 5 has passed: Countdown has started\n");
-      false_positive = false;
-      event_fall = true;
-      text_layer_set_font(text_layer, fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_ROBOTO_BOLD_SUBSET_49)));
-      display_countdown(10);
-      report_countdown();
-      cntdown_ctr++;
-      text_layer_set_text(text_layer_up, "Fall?");
-      set_countdown();
-      current_state = 0;	// Reset current_state to zero
+  SeizureEvent seizure_events[SEIZURE_MAX_EVENTS(ACCEL_MAX_BATCH)];
+  num_events = seizure_detector_feed(&s_seizure_detector, data, num_samples,
+                                     seizure_events, ARRAY_LENGTH(seizure_events));
+
+  for (uint32_t i = 0; i < num_events; i++) {
+    if (seizure_events[i].type == SEIZURE_EVENT_ONSET) {
+      report_seizure();
+    }
   }
+  return candidate;
+}
+
 
-  set_timer();			// Reset timer function
+
+/*
+	This function peeks the accelerometer and
+	runs the sample through the FSM, every
+	timer_frequency ms from set_timer(). Only
+	used when batching is disabled
+	(ACCEL_BATCH_SAMPLES = 0).
+*/
+static void timer_callback(void *data) {
+  PROFILE_BEGIN(PROFILE_TIMER);
+  AccelData accel;
+
+  // Get last value from accelerometer
+  accel_service_peek(&accel);
+  jitter_add(&s_jitter, &accel, 1, s_rate.rate);
+  update_sampling_rate(1, process_samples(&accel, 1));
+
+  PROFILE_EXPECT(PROFILE_TIMER, timer_frequency);
+  PROFILE_END(PROFILE_TIMER);
 }
 
 
 
+/*
+	Runs the FSM over a whole batch of
+	samples in one wakeup. While waiting for
+	a tap, only keeps them, unless they moved.
+*/
 void accel_data_handler(AccelData *data, uint32_t num_samples) {
-  // Do nothing!
+  PROFILE_BEGIN(PROFILE_ACCEL);
+  jitter_add(&s_jitter, data, num_samples, s_rate.rate);
+  if (s_watching) {
+#if ACCEL_TAP_WAKE
+    if (pretrigger_push(&s_pretrigger, data, num_samples)) {
+      wake_analysis();
+    }
+#endif
+  } else {
+    uint32_t batch = num_samples;
+    bool candidate = false;
+    while (num_samples > 0) {
+      uint32_t count = (num_samples < ACCEL_MAX_BATCH) ? num_samples : ACCEL_MAX_BATCH;
+      candidate |= process_samples(data, count);
+      data += count;
+      num_samples -= count;
+    }
+    update_sampling_rate(batch, candidate);
+  }
+  scheduler_poll(&s_scheduler);		// What can run now needs no wakeup of its own
+  PROFILE_EXPECT(PROFILE_ACCEL, samples_per_update() * 1000 / s_rate.rate);
+  PROFILE_END(PROFILE_ACCEL);
 }
 
 
 
 /*
 	Report that a fall has happened!!!
+	Falls are flushed to the phone right away,
+	then the black box window that led to it.
 */
 static void report_fall(void) {
   //APP_LOG(APP_LOG_LEVEL_DEBUG, "SeizeAlert is datalogging a fall\n");
   event_fall = false;
-  SeizureData *seizure_data = &s_seizure_datas[0];
-  time_t now = time(NULL);
-  data_logging_log(seizure_data->logging_session, (uint8_t *)&now, 1);
-  data_logging_finish(seizure_data->logging_session);
+  event_log_append(&s_seizure_datas[0].event_log, EVENT_FALL, 0, true);
+  blackbox_commit(&s_blackbox);
+}
 
-  seizure_data->logging_session = data_logging_create(SEIZURE_LOG_TAGS[0], DATA_LOGGING_UINT, 4, false);
+
+/*
+	Report that a seizure has started!!!
+	Also flushed right away, with the band share
+	of the window that confirmed it.
+*/
+static void report_seizure(void) {
+  //APP_LOG(APP_LOG_LEVEL_DEBUG, "SeizeAlert is datalogging a seizure\n");
+  event_log_append(&s_seizure_datas[1].event_log, EVENT_SEIZURE, s_seizure_detector.last_percent, true);
 }
 
 
 /*
 	Report that countdown has started!!!
+	Countdowns are batched.
 */
 static void report_countdown(void) {
   //APP_LOG(APP_LOG_LEVEL_DEBUG, "SeizeAlert is datalogging a countdown\n");
-  SeizureData *seizure_data = &s_seizure_datas[2];
-  time_t now = time(NULL);
-  data_logging_log(seizure_data->logging_session, (uint8_t *)&now, 1);
-  data_logging_finish(seizure_data->logging_session);
+  event_log_append(&s_seizure_datas[2].event_log, EVENT_COUNTDOWN, 0, false);
+}
+
+
 
-  seizure_data->logging_session = data_logging_create(SEIZURE_LOG_TAGS[2], DATA_LOGGING_UINT, 4, false);
+/*
+	Batched events should not wait on the phone
+	for long.
+*/
+static void log_flush_callback(void *data) {
+  time_t now = time(NULL);
+  for (unsigned int i = 0; i < ARRAY_LENGTH(s_seizure_datas); i++) {
+    event_log_flush_stale(&s_seizure_datas[i].event_log, now);
+  }
 }
 
 
 
+/*
+	A tap (detected by the accelerometer, it costs
+	no wakeup until then) wakes analysis up.
+*/
 void accel_tap_handler(AccelAxisType axis, int32_t direction) {
-  // Do nothing
+  PROFILE_BEGIN(PROFILE_TAP);
+#if ACCEL_TAP_WAKE
+  if (s_watching) {
+    wake_analysis();
+  }
+#endif
+  PROFILE_END(PROFILE_TAP);
 }
 
 
@@ -331,16 +541,26 @@ void display_countdown(int count){
 
 
 
+/*
+	Only switches the backgrounds when the screen
+	changes; every setter marks the layer dirty.
+*/
 void set_seizealert_screen(void){
-  text_layer_set_background_color(text_layer, GColorBlack);
-  text_layer_set_background_color(text_layer_up, GColorBlack);
+  if (!seizealert_screen) {
+    text_layer_set_background_color(text_layer, GColorBlack);
+    text_layer_set_background_color(text_layer_up, GColorBlack);
+    seizealert_screen = true;
+  }
 }
 
 
 
 void set_watchface_screen(void){
-  text_layer_set_background_color(text_layer, GColorClear);
-  text_layer_set_background_color(text_layer_up, GColorClear);
+  if (seizealert_screen) {
+    text_layer_set_background_color(text_layer, GColorClear);
+    text_layer_set_background_color(text_layer_up, GColorClear);
+    seizealert_screen = false;
+  }
 }
 
 
@@ -362,15 +582,11 @@ void set_false_alarm_event(void){
   false_positive = true;
   event_fall = false;
   cntdown_ctr = 0;
+  scheduler_cancel(&s_scheduler, TASK_COUNTDOWN);
 
-  current_state = 0;
-  step_1_counter = 0;
-  step_2_counter = 0;
-  step_2_flag = false;
-  step_3_counter = 0;
-  step_3_flag = false;
-  step_4_counter = 0;
-  step_4_flag = false;
+  blackbox_release(&s_blackbox);
+  detector_reset(&s_detector);
+  detector_set_armed(&s_detector, true);
 
   text_layer_set_font(text_layer, fonts_get_system_font(FONT_KEY_ROBOTO_CONDENSED_21));
   set_watchface_screen();
@@ -380,7 +596,13 @@ void set_false_alarm_event(void){
 
 
 
+/*
+	Dumps the sample jitter histogram, and the
+	callback profile in PROFILE builds.
+*/
 static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
+  jitter_dump(&s_jitter);
+  PROFILE_DUMP();
 }
 
 
@@ -402,16 +624,19 @@ void line_layer_update_callback(Layer *layer, GContext* ctx) {
 }
 
 void handle_minute_tick(struct tm *tick_time, TimeUnits units_changed) {
+  PROFILE_BEGIN(PROFILE_MINUTE_TICK);
   // Need to be static because they're used by the system later.
   static char time_text[] = "00:00";
   static char date_text[] = "Xxxxxxxxx 00";
 
   char *time_format;
 
-
-  // TODO: Only update the date when it's changed.
-  strftime(date_text, sizeof(date_text), "%B %e", tick_time);
-  text_layer_set_text(text_date_layer, date_text);
+  if ((tick_time->tm_yday != shown_yday) || (tick_time->tm_year != shown_year)) {
+    strftime(date_text, sizeof(date_text), "%B %e", tick_time);
+    text_layer_set_text(text_date_layer, date_text);
+    shown_year = tick_time->tm_year;
+    shown_yday = tick_time->tm_yday;
+  }
 
 
   if (clock_is_24h_style()) {
@@ -429,6 +654,10 @@ void handle_minute_tick(struct tm *tick_time, TimeUnits units_changed) {
   }
 
   text_layer_set_text(text_time_layer, time_text);
+
+  scheduler_poll(&s_scheduler);		// The log flush, if it is due by now
+  PROFILE_EXPECT_ALIGNED(PROFILE_MINUTE_TICK, 60 * 1000);
+  PROFILE_END(PROFILE_MINUTE_TICK);
 }
 
 
@@ -443,20 +672,31 @@ static void battery_layer_update_callback(Layer *layer, GContext *ctx) {
 		graphics_draw_bitmap_in_rect(ctx, icon_battery, GRect(0, 0, 24, 12));
 		graphics_context_set_stroke_color(ctx, GColorBlack);
 		graphics_context_set_fill_color(ctx, GColorWhite);
-		graphics_fill_rect(ctx, GRect(7, 4, (uint8_t)((battery_level / 100.0) * 11.0), 4), 0, GCornerNone);
+		graphics_fill_rect(ctx, GRect(7, 4, battery_bar, 4), 0, GCornerNone);
 	} else {
 		graphics_draw_bitmap_in_rect(ctx, icon_battery_charge, GRect(0, 0, 24, 12));
 	}
 }
 
 
+static uint8_t battery_bar_width(uint8_t charge_percent) {
+	return (charge_percent * BATTERY_BAR_WIDTH) / 100;
+}
+
+
 /*
-* Battery state change
+* Battery state change. Most percent changes
+* leave the bar as it is: nothing to redraw.
 */
 static void battery_state_handler(BatteryChargeState charge) {
-	battery_level = charge.charge_percent;
-	battery_plugged = charge.is_plugged;
-	layer_mark_dirty(battery_layer);
+	PROFILE_BEGIN(PROFILE_BATTERY);
+	uint8_t bar = battery_bar_width(charge.charge_percent);
+	if ((bar != battery_bar) || (charge.is_plugged != battery_plugged)) {
+		battery_bar = bar;
+		battery_plugged = charge.is_plugged;
+		layer_mark_dirty(battery_layer);
+	}
+	PROFILE_END(PROFILE_BATTERY);
 }
 
 
@@ -464,7 +704,12 @@ static void battery_state_handler(BatteryChargeState charge) {
 * Bluetooth connection status
 */
 static void bluetooth_state_handler(bool connected) {
-	layer_set_hidden(bitmap_layer_get_layer(bluetooth_layer), !connected);
+	PROFILE_BEGIN(PROFILE_BLUETOOTH);
+	if (connected != bluetooth_connected) {
+		bluetooth_connected = connected;
+		layer_set_hidden(bitmap_layer_get_layer(bluetooth_layer), !connected);
+	}
+	PROFILE_END(PROFILE_BLUETOOTH);
 }
 
 
@@ -481,18 +726,18 @@ static void click_config_provider(void *context) {
 static void window_load(Window *window) {
 
   // init tap service
-  accel_service_set_sampling_rate(ACCEL_SAMPLING_25HZ);
+  accel_service_set_sampling_rate(s_rate.rate);
   accel_tap_service_subscribe(&accel_tap_handler);
   window_set_background_color(window, GColorBlack);
   Layer *window_layer = window_get_root_layer(window);
 
   
   // Battery Layer
-  icon_battery = gbitmap_create_with_resource(RESOURCE_ID_BATTERY_ICON);
-  icon_battery_charge = gbitmap_create_with_resource(RESOURCE_ID_BATTERY_CHARGE);
+  icon_battery = resource_cache_bitmap(RESOURCE_ID_BATTERY_ICON);
+  icon_battery_charge = resource_cache_bitmap(RESOURCE_ID_BATTERY_CHARGE);
 
   BatteryChargeState initial = battery_state_service_peek();
-  battery_level = initial.charge_percent;
+  battery_bar = battery_bar_width(initial.charge_percent);
   battery_plugged = initial.is_plugged;
   battery_layer = layer_create(GRect(0,3,24,12)); //24*12
   layer_set_update_proc(battery_layer, &battery_layer_update_callback);
@@ -501,9 +746,10 @@ static void window_load(Window *window) {
   // Bluetooth Layer
   bluetooth_layer = bitmap_layer_create(GRect(25, 3, 9, 12));
   layer_add_child(window_layer, bitmap_layer_get_layer(bluetooth_layer));
-  bluetooth_bitmap = gbitmap_create_with_resource(RESOURCE_ID_BLUETOOTH_ICON);
+  bluetooth_bitmap = resource_cache_bitmap(RESOURCE_ID_BLUETOOTH_ICON);
   bitmap_layer_set_bitmap(bluetooth_layer, bluetooth_bitmap);
-  layer_set_hidden(bitmap_layer_get_layer(bluetooth_layer), !bluetooth_connection_service_peek());
+  bluetooth_connected = bluetooth_connection_service_peek();
+  layer_set_hidden(bitmap_layer_get_layer(bluetooth_layer), !bluetooth_connected);
 
   // Welcome User
   GRect bounds = layer_get_bounds(window_layer);
@@ -518,7 +764,7 @@ static void window_load(Window *window) {
   layer_add_child(window_layer, text_layer_get_layer(seizealert_layer));
   //text_layer_set_text(seizealert_layer, "SeizeAlert v2.0\nSeizeAlert Status:\n-Running");
   
-  seizealert_logo = gbitmap_create_with_resource(RESOURCE_ID_PEBBLE_LOGO);		// SeizeAlert logo
+  seizealert_logo = resource_cache_bitmap(RESOURCE_ID_PEBBLE_LOGO);		// SeizeAlert logo
   logo_layer = bitmap_layer_create(GRect(7,13,(130),(60))); 	// Layer size (width, height)
   layer_add_child(window_layer, bitmap_layer_get_layer(logo_layer));
   bitmap_layer_set_bitmap(logo_layer, seizealert_logo);
@@ -527,13 +773,13 @@ static void window_load(Window *window) {
   text_date_layer = text_layer_create(GRect(8, 68, 144-8, 168-68));
   text_layer_set_text_color(text_date_layer, GColorWhite);
   text_layer_set_background_color(text_date_layer, GColorClear);
-  text_layer_set_font(text_date_layer, fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_ROBOTO_CONDENSED_21)));
+  text_layer_set_font(text_date_layer, resource_cache_font(RESOURCE_ID_FONT_ROBOTO_CONDENSED_21));
   layer_add_child(window_layer, text_layer_get_layer(text_date_layer));
 
   text_time_layer = text_layer_create(GRect(7, 92, 144-7, 168-92));
   text_layer_set_text_color(text_time_layer, GColorWhite);
   text_layer_set_background_color(text_time_layer, GColorClear);
-  text_layer_set_font(text_time_layer, fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_ROBOTO_BOLD_SUBSET_49)));
+  text_layer_set_font(text_time_layer, resource_cache_font(RESOURCE_ID_FONT_ROBOTO_BOLD_SUBSET_49));
   layer_add_child(window_layer, text_layer_get_layer(text_time_layer));
 
   GRect line_frame = GRect(8, 97, 139, 2);
@@ -578,12 +824,13 @@ static void window_unload(Window *window) {
   text_layer_destroy(text_layer_up);
   text_layer_destroy(text_date_layer);
   text_layer_destroy(text_time_layer);
+  text_layer_destroy(seizealert_layer);
+  layer_destroy(line_layer);
 
+  bitmap_layer_destroy(logo_layer);
   bitmap_layer_destroy(bluetooth_layer);
   layer_destroy(battery_layer);
-  gbitmap_destroy(icon_battery);
-  gbitmap_destroy(icon_battery_charge);
-  gbitmap_destroy(bluetooth_bitmap);
+  resource_cache_release_all();		// Fonts and bitmaps, after the layers using them
 
   deinit_seizure_datas();
 }
@@ -591,24 +838,50 @@ static void window_unload(Window *window) {
 
 
 static void init_seizure_datas(void) {
-  for (int i = 0; i < 3; i++) {
+  for (unsigned int i = 0; i < ARRAY_LENGTH(s_seizure_datas); i++) {
     SeizureData *seizure_data = &s_seizure_datas[i];
-    seizure_data->logging_session = data_logging_create(SEIZURE_LOG_TAGS[i], DATA_LOGGING_UINT, 4, false);
+    seizure_data->tag = SEIZURE_LOG_TAGS[i];
+    event_log_init(&seizure_data->event_log, SEIZURE_LOG_TAGS[i]);
   }
 }
 
 
 
+/*
+	Flushes and finishes every session, so nothing
+	buffered is lost on unload.
+*/
 static void deinit_seizure_datas(void) {
-  for (int i = 0; i < 2; i++) {
+  for (unsigned int i = 0; i < ARRAY_LENGTH(s_seizure_datas); i++) {
     SeizureData *seizure_data = &s_seizure_datas[i];
-    data_logging_finish(seizure_data->logging_session);
+    event_log_deinit(&seizure_data->event_log);
   }
 }
 
 
 
 static void init(void) {
+  scheduler_init(&s_scheduler);
+
+  // The profile that was active when the app last ran
+  detector_profiles_load(&s_profiles);
+  const DetectorProfile *profile = detector_profiles_active(&s_profiles);
+  s_alert_window = profile->alert_window;
+  s_adaptive = ACCEL_ADAPTIVE_RATE && (profile->rate_hz == 0);
+
+  detector_init(&s_detector, &profile->detector);
+
+  SeizureConfig seizure_config = SEIZURE_DEFAULT_CONFIG;
+  seizure_detector_init(&s_seizure_detector, &seizure_config);
+
+  rate_controller_init(&s_rate, profile->rate_hz ? profile->rate_hz : RATE_ACTIVE_HZ);
+  detector_set_rate(&s_detector, s_rate.rate);
+  blackbox_init(&s_blackbox);
+  jitter_init(&s_jitter);
+
+  app_message_register_inbox_received(inbox_received_handler);
+  app_message_open(MESSAGE_INBOX_SIZE, MESSAGE_OUTBOX_SIZE);
+
   window = window_create();
   window_set_click_config_provider(window, click_config_provider);
   window_set_window_handlers(window, (WindowHandlers) {
@@ -619,17 +892,32 @@ static void init(void) {
   window_stack_push(window, animated);
 
   tick_timer_service_subscribe(MINUTE_UNIT, handle_minute_tick);
-  
-  // Initialize Buffer at 20Hz
+  PROFILE_EXPECT_ALIGNED(PROFILE_MINUTE_TICK, 60 * 1000);
+  scheduler_set(&s_scheduler, TASK_LOG_FLUSH, LOG_FLUSH_PERIOD_MS, LOG_FLUSH_PERIOD_MS, SCHEDULER_MAX_SLACK_MS,
+                log_flush_callback, NULL);
+
+#if ACCEL_BATCH_SAMPLES > 0
+  // Deliver ACCEL_BATCH_SAMPLES samples per wakeup at 25 Hz
+  accel_data_service_subscribe(samples_per_update(), &accel_data_handler);
+  PROFILE_EXPECT(PROFILE_ACCEL, samples_per_update() * 1000 / s_rate.rate);
+#else
+  // Initialize Buffer at 25Hz
   set_timer();
+#endif
 }
 
 
 
 static void deinit(void) {
+#if ACCEL_BATCH_SAMPLES > 0
+  // deinit accel batches
+  accel_data_service_unsubscribe();
+#endif
+
   // deinit accel tap
   accel_tap_service_unsubscribe();
   tick_timer_service_unsubscribe();
+  scheduler_deinit(&s_scheduler);
   window_destroy(window);
 }
 
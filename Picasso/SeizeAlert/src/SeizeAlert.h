@@ -2,15 +2,18 @@
 
 void set_false_alarm_event(void);
 static void report_fall(void);
+static void report_seizure(void);
 static void report_countdown(void);
+static void log_flush_callback(void *data);
 static void init_seizure_datas(void);
 static void deinit_seizure_datas(void);
-static void timer_callback();
+static bool process_samples(AccelData *data, uint32_t num_samples);
+static void start_countdown(void);
+static void timer_callback(void *data);
 static void set_countdown();
-static void countdown_callback();
+static void countdown_callback(void *data);
 void test_buffer_vals(void);
 void display_countdown(int count);
-float my_sqrt(const float num);
 void set_seizealert_screen(void);
 void set_watchface_screen(void);
 
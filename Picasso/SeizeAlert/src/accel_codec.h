@@ -0,0 +1,44 @@
+#pragma once
+
+/*
+	Lossless compression of accelerometer samples, shared by the
+	watch (encoder) and host tools (decoder). Airwolf/store-batch
+	and Picasso/SeizeAlert (for its black box) each carry a copy
+	of accel_codec.h and .c: keep them byte-identical, which the
+	host build checks (make check-codec).
+
+	Samples are coded in independent blocks so a reader can start
+	at any block and lost bytes only cost the block they are in:
+
+	  byte 0       ACCEL_CODEC_MAGIC
+	  byte 1       number of samples n (1..ACCEL_CODEC_MAX_SAMPLES)
+	  bytes 2-7    keyframe: first sample, x y z as little endian int16
+	  then         for each of the n - 1 other samples, the delta of
+	               x, y and z from the previous sample, zig-zag mapped
+	               (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...) and written as
+	               a little endian base-128 varint (7 bits per byte,
+	               high bit set on all but the last byte)
+	  last 2 bytes Fletcher-16 of all the bytes before, little endian
+
+	The checksum is what lets a reader that lost its place trust
+	the next magic byte it finds: 0xa5 also turns up inside
+	varints, and a false start fails the check.
+
+	At 25 Hz most deltas fit in one byte, so a block is close to
+	half the size of the raw int16 samples. A delta takes at most
+	three bytes (ACCEL_CODEC_MAX_BLOCK_BYTES).
+*/
+
+#include <pebble.h>
+
+#define ACCEL_CODEC_MAGIC 0xa5
+#define ACCEL_CODEC_MAX_SAMPLES 255
+#define ACCEL_CODEC_HEADER_BYTES 8
+#define ACCEL_CODEC_CHECKSUM_BYTES 2
+
+// Worst case encoded size of a block of n samples
+#define ACCEL_CODEC_MAX_BLOCK_BYTES(n) (ACCEL_CODEC_HEADER_BYTES + ((n) - 1) * 3 * 3 + ACCEL_CODEC_CHECKSUM_BYTES)
+
+uint32_t accel_codec_encode(const int16_t *samples, uint32_t num_samples, uint8_t *out, uint32_t out_size);
+uint32_t accel_codec_decode(const uint8_t *in, uint32_t in_size, int16_t *samples, uint32_t max_samples,
+                            uint32_t *num_samples);
@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+	Square-root-free magnitude tests for SeizeAlert's FSM.
+
+	The FSM thresholds are on the deviation from 1 g:
+
+		test = int(abs(sqrt(x^2 + y^2 + z^2) - 1000))
+
+	With s = sqrt(m2), test is floor(s) - 1000 above 1 g and
+	1000 - ceil(s) below it, so every "test >= bound" or
+	"test <= bound" is an interval on s with integer edges.
+	Squaring those edges lets the FSM compare m2 directly,
+	with no sqrt, float or division on the per-sample path.
+	For constant bounds the edges fold at compile time.
+*/
+
+#define ACCEL_ONE_G 1000
+
+#define ACCEL_SQUARE(v) ((uint32_t)((v) * (v)))
+
+// x^2 + y^2 + z^2 of one sample; fits in 32 bits for any int16 input
+#define ACCEL_MAGNITUDE_SQUARED(x, y, z) \
+  (ACCEL_SQUARE((int32_t)(x)) + ACCEL_SQUARE((int32_t)(y)) + ACCEL_SQUARE((int32_t)(z)))
+
+// test >= bound  <=>  s >= 1000 + bound  or  s <= 1000 - bound
+#define ACCEL_DEVIATION_AT_LEAST(m2, bound) \
+  (((m2) >= ACCEL_SQUARE(ACCEL_ONE_G + (bound))) || \
+   ((ACCEL_ONE_G - (bound) >= 0) && ((m2) <= ACCEL_SQUARE(ACCEL_ONE_G - (bound)))))
+
+// test <= bound  <=>  999 - bound < s < 1001 + bound
+#define ACCEL_DEVIATION_AT_MOST(m2, bound) \
+  (((m2) < ACCEL_SQUARE(ACCEL_ONE_G + 1 + (bound))) && \
+   ((ACCEL_ONE_G - 1 - (bound) < 0) || ((m2) > ACCEL_SQUARE(ACCEL_ONE_G - 1 - (bound)))))
+
+/*
+	Runtime form of the same edges, for bounds that are
+	only known at run time (see DetectorConfig):
+
+		test >= bound  <=>  m2 < below || m2 >= above
+
+	and test <= bound is !(test >= bound + 1).
+*/
+typedef struct {
+  uint32_t below;
+  uint32_t above;
+} AccelDeviationEdges;
+
+static inline AccelDeviationEdges accel_deviation_edges(int bound) {
+  AccelDeviationEdges edges;
+  edges.above = ACCEL_SQUARE(ACCEL_ONE_G + bound);
+  edges.below = (bound <= ACCEL_ONE_G) ? (ACCEL_SQUARE(ACCEL_ONE_G - bound) + 1) : 0;
+  return edges;
+}
+
+static inline bool accel_deviation_at_least(uint32_t m2, AccelDeviationEdges edges) {
+  return (m2 < edges.below) || (m2 >= edges.above);
+}
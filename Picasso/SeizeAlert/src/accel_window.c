@@ -0,0 +1,172 @@
+#include <pebble.h>
+#include <accel_window.h>
+#include <accel_magnitude.h>
+
+
+static inline int32_t channel_value(const AccelWindow *win, int channel, uint8_t pos) {
+  return (channel < ACCEL_WINDOW_M2) ? win->axes[channel][pos] : win->m2[pos];
+}
+
+
+
+static void evict_oldest(AccelWindow *win) {
+  uint8_t oldest = win->next - win->count;
+  uint8_t following = oldest + 1;
+
+  for (int axis = 0; axis < 3; axis++) {
+    int32_t value = win->axes[axis][oldest];
+    win->sum[axis] -= value;
+    win->sum_squares[axis] -= value * value;
+    win->sum_sma -= abs(value);
+    if (win->count > 1) {
+      win->sum_jerk -= abs(win->axes[axis][following] - value);
+    }
+  }
+  for (int channel = 0; channel < ACCEL_WINDOW_CHANNELS; channel++) {
+    window_deque_expire(&win->min[channel], oldest);
+    window_deque_expire(&win->max[channel], oldest);
+  }
+  win->count--;
+}
+
+
+
+void accel_window_init(AccelWindow *win, uint16_t length) {
+  memset(win, 0, sizeof(*win));
+  if (length == 0) {
+    length = 1;
+  }
+  win->length = (length < ACCEL_WINDOW_SIZE) ? length : ACCEL_WINDOW_SIZE;
+}
+
+
+
+/*
+	Changes the window length, keeping the samples:
+	a shorter window drops its oldest ones, a longer
+	one fills up as samples come.
+*/
+void accel_window_set_length(AccelWindow *win, uint16_t length) {
+  if (length == 0) {
+    length = 1;
+  }
+  win->length = (length < ACCEL_WINDOW_SIZE) ? length : ACCEL_WINDOW_SIZE;
+  while (win->count > win->length) {
+    evict_oldest(win);
+  }
+}
+
+
+
+void accel_window_push(AccelWindow *win, const AccelData *sample) {
+  if (win->count == win->length) {
+    evict_oldest(win);
+  }
+
+  uint8_t pos = win->next;
+  uint8_t prev = pos - 1;
+  int32_t values[3] = { sample->x, sample->y, sample->z };
+  uint32_t m2 = ACCEL_MAGNITUDE_SQUARED(sample->x, sample->y, sample->z);
+
+  for (int axis = 0; axis < 3; axis++) {
+    int32_t value = values[axis];
+    if (win->count > 0) {
+      win->sum_jerk += abs(value - win->axes[axis][prev]);
+    }
+    win->axes[axis][pos] = value;
+    win->sum[axis] += value;
+    win->sum_squares[axis] += value * value;
+    win->sum_sma += abs(value);
+  }
+  win->m2[pos] = (m2 > INT32_MAX) ? INT32_MAX : (int32_t)m2;	// Only clips past ~46 g
+
+  for (int axis = 0; axis < 3; axis++) {
+    WINDOW_DEQUE_PUSH(&win->min[axis], win->axes[axis], pos, <);
+    WINDOW_DEQUE_PUSH(&win->max[axis], win->axes[axis], pos, >);
+  }
+  WINDOW_DEQUE_PUSH(&win->min[ACCEL_WINDOW_M2], win->m2, pos, <);
+  WINDOW_DEQUE_PUSH(&win->max[ACCEL_WINDOW_M2], win->m2, pos, >);
+
+  win->next++;
+  win->count++;
+  win->pushed++;
+}
+
+
+
+uint16_t accel_window_count(const AccelWindow *win) {
+  return win->count;
+}
+
+
+
+int32_t accel_window_newest(const AccelWindow *win, AccelWindowChannel channel) {
+  return win->count ? channel_value(win, channel, (uint8_t)(win->next - 1)) : 0;
+}
+
+
+
+int32_t accel_window_mean(const AccelWindow *win, AccelWindowChannel axis) {
+  if ((win->count == 0) || (axis >= ACCEL_WINDOW_M2)) {
+    return 0;
+  }
+  return win->sum[axis] / win->count;
+}
+
+
+
+int32_t accel_window_variance(const AccelWindow *win, AccelWindowChannel axis) {
+  if ((win->count == 0) || (axis >= ACCEL_WINDOW_M2)) {
+    return 0;
+  }
+  int64_t n = win->count;
+  int64_t sum = win->sum[axis];
+  return (int32_t)(((n * win->sum_squares[axis]) - (sum * sum)) / (n * n));
+}
+
+
+
+int32_t accel_window_sma(const AccelWindow *win) {
+  return win->count ? (win->sum_sma / win->count) : 0;
+}
+
+
+
+int32_t accel_window_jerk(const AccelWindow *win) {
+  return (win->count > 1) ? (win->sum_jerk / (win->count - 1)) : 0;
+}
+
+
+
+int32_t accel_window_min(const AccelWindow *win, AccelWindowChannel channel) {
+  const WindowDeque *deque = &win->min[channel];
+  return deque->count ? channel_value(win, channel, window_deque_at(deque, 0)) : 0;
+}
+
+
+
+int32_t accel_window_max(const AccelWindow *win, AccelWindowChannel channel) {
+  const WindowDeque *deque = &win->max[channel];
+  return deque->count ? channel_value(win, channel, window_deque_at(deque, 0)) : 0;
+}
+
+
+
+/*
+	Min and max of a channel over the newest `last`
+	samples (clamped to the window). Returns false
+	if the window is empty.
+*/
+bool accel_window_range(const AccelWindow *win, AccelWindowChannel channel, uint16_t last,
+                        int32_t *min, int32_t *max) {
+  if (win->count == 0) {
+    return false;
+  }
+  if ((last == 0) || (last > win->count)) {
+    last = win->count;
+  }
+  uint8_t newest = win->next - 1;
+  *min = channel_value(win, channel, window_deque_suffix_front(&win->min[channel], newest, last));
+  *max = channel_value(win, channel, window_deque_suffix_front(&win->max[channel], newest, last));
+  return true;
+}
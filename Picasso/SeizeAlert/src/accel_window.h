@@ -0,0 +1,68 @@
+#pragma once
+
+/*
+	Sliding-window features over an accelerometer stream.
+
+	Keeps the last `length` samples (up to ACCEL_WINDOW_SIZE) in
+	ring buffers and updates, per pushed sample and in constant
+	(amortized) time with integer math only:
+
+	  - mean and variance per axis (running sum / sum of squares)
+	  - signal magnitude area, mean of |x| + |y| + |z|
+	  - jerk, mean of |dx| + |dy| + |dz| between consecutive samples
+	  - min / max per axis and of the squared magnitude, via
+	    monotonic deques, also for any suffix of the window
+	    (accel_window_range)
+
+	Units are those of AccelData (milli-g).
+
+	About 4.7 KB: the fall detector does not use it, only the
+	squared magnitude min / max, from the smaller
+	magnitude_window.h.
+*/
+
+#include <pebble.h>
+#include <window_deque.h>
+
+#define ACCEL_WINDOW_SIZE WINDOW_DEQUE_SIZE
+
+typedef enum {
+  ACCEL_WINDOW_X = 0,
+  ACCEL_WINDOW_Y,
+  ACCEL_WINDOW_Z,
+  ACCEL_WINDOW_M2,		// x^2 + y^2 + z^2, for min / max only
+  ACCEL_WINDOW_CHANNELS,
+} AccelWindowChannel;
+
+typedef struct {
+  int16_t axes[3][ACCEL_WINDOW_SIZE];
+  int32_t m2[ACCEL_WINDOW_SIZE];
+
+  uint16_t length;		// Window length in samples
+  uint16_t count;		// Samples currently in the window
+  uint8_t next;			// Ring position of the next sample
+  uint32_t pushed;		// Samples pushed since init
+
+  int32_t sum[3];
+  int64_t sum_squares[3];
+  int32_t sum_sma;
+  int32_t sum_jerk;
+
+  WindowDeque min[ACCEL_WINDOW_CHANNELS];
+  WindowDeque max[ACCEL_WINDOW_CHANNELS];
+} AccelWindow;
+
+void accel_window_init(AccelWindow *win, uint16_t length);
+void accel_window_set_length(AccelWindow *win, uint16_t length);
+void accel_window_push(AccelWindow *win, const AccelData *sample);
+
+uint16_t accel_window_count(const AccelWindow *win);
+int32_t accel_window_newest(const AccelWindow *win, AccelWindowChannel channel);
+int32_t accel_window_mean(const AccelWindow *win, AccelWindowChannel axis);
+int32_t accel_window_variance(const AccelWindow *win, AccelWindowChannel axis);
+int32_t accel_window_sma(const AccelWindow *win);
+int32_t accel_window_jerk(const AccelWindow *win);
+int32_t accel_window_min(const AccelWindow *win, AccelWindowChannel channel);
+int32_t accel_window_max(const AccelWindow *win, AccelWindowChannel channel);
+bool accel_window_range(const AccelWindow *win, AccelWindowChannel channel, uint16_t last,
+                        int32_t *min, int32_t *max);
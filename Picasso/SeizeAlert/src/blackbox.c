@@ -0,0 +1,248 @@
+#include <pebble.h>
+#include <blackbox.h>
+
+#define BLOCK_BYTES ACCEL_CODEC_MAX_BLOCK_BYTES(BLACKBOX_BLOCK_SAMPLES)
+
+
+void blackbox_init(BlackBox *bb) {
+  memset(bb, 0, sizeof(*bb));
+}
+
+
+
+// Empties the ring, keeping the counters
+static void clear(BlackBox *bb) {
+  bb->oldest = 0;
+  bb->num_blocks = 0;
+  bb->head = 0;
+  bb->used = 0;
+  bb->num_pending = 0;
+  bb->num_samples = 0;
+  bb->state = BLACKBOX_ROLLING;
+}
+
+
+
+// The i-th oldest block
+static BlackBoxBlock *block_at(BlackBox *bb, uint32_t i) {
+  return &bb->blocks[(bb->oldest + i) % BLACKBOX_MAX_BLOCKS];
+}
+
+
+
+static uint32_t block_ms(const BlackBoxBlock *block) {
+  return (block->num_samples * 1000) / block->rate_hz;
+}
+
+
+
+/*
+	Compresses the pending samples into the ring,
+	dropping the oldest blocks until they fit.
+*/
+static void flush(BlackBox *bb) {
+  if (bb->num_pending == 0) {
+    return;
+  }
+  uint8_t encoded[BLOCK_BYTES];
+  uint32_t length = accel_codec_encode(bb->pending, bb->num_pending, encoded, sizeof(encoded));
+
+  while ((bb->num_blocks == BLACKBOX_MAX_BLOCKS) || (length > BLACKBOX_BYTES - (uint32_t)bb->used)) {
+    bb->used -= bb->blocks[bb->oldest].length;
+    bb->oldest = (bb->oldest + 1) % BLACKBOX_MAX_BLOCKS;
+    bb->num_blocks--;
+  }
+
+  BlackBoxBlock *block = block_at(bb, bb->num_blocks);
+  block->offset = bb->head;
+  block->length = length;
+  block->rate_hz = bb->pending_rate_hz;
+  block->num_samples = bb->num_pending;
+  block->first_sample = bb->num_samples - bb->num_pending;
+
+  uint32_t to_end = BLACKBOX_BYTES - bb->head;
+  uint32_t first_part = (length < to_end) ? length : to_end;
+  memcpy(&bb->bytes[bb->head], encoded, first_part);
+  memcpy(bb->bytes, &encoded[first_part], length - first_part);
+  bb->head = (bb->head + length) % BLACKBOX_BYTES;
+  bb->used += length;
+  bb->num_blocks++;
+  bb->num_pending = 0;
+}
+
+
+
+static void hold(BlackBox *bb) {
+  flush(bb);
+  bb->state = BLACKBOX_HELD;
+  time_ms(&bb->end_time, &bb->end_time_ms);
+}
+
+
+
+/*
+	The samples before this are not followed by
+	the next ones: start over, unless a window is
+	being recorded, which is held as it is.
+*/
+void blackbox_reset(BlackBox *bb) {
+  if (bb->state == BLACKBOX_ROLLING) {
+    clear(bb);
+  } else if (bb->state == BLACKBOX_TRIGGERED) {
+    hold(bb);
+  }
+}
+
+
+
+/*
+	Records samples that came at rate_hz. Ignored
+	while a window is held.
+*/
+void blackbox_add(BlackBox *bb, const AccelData *data, uint32_t num_samples, uint8_t rate_hz) {
+  if ((bb->state == BLACKBOX_HELD) || (num_samples == 0)) {
+    return;
+  }
+  if ((bb->num_pending > 0) && (rate_hz != bb->pending_rate_hz)) {
+    flush(bb);
+  }
+  bb->pending_rate_hz = rate_hz;
+
+  for (uint32_t i = 0; i < num_samples; i++) {
+    int16_t *sample = &bb->pending[bb->num_pending * 3];
+    sample[0] = data[i].x;
+    sample[1] = data[i].y;
+    sample[2] = data[i].z;
+    bb->num_samples++;
+    if (++bb->num_pending == BLACKBOX_BLOCK_SAMPLES) {
+      flush(bb);
+    }
+  }
+
+  if (bb->state == BLACKBOX_TRIGGERED) {
+    bb->post_ms -= (num_samples * 1000) / rate_hz;
+    if (bb->post_ms <= 0) {
+      hold(bb);
+    }
+  }
+}
+
+
+
+/*
+	The step one sample is samples_ago samples
+	before the last one added. Only the first
+	trigger of a window counts.
+*/
+void blackbox_trigger(BlackBox *bb, uint32_t samples_ago) {
+  if ((bb->state != BLACKBOX_ROLLING) || (samples_ago >= bb->num_samples)) {
+    return;
+  }
+  bb->state = BLACKBOX_TRIGGERED;
+  bb->trigger_sample = bb->num_samples - 1 - samples_ago;
+  bb->post_ms = BLACKBOX_POST_MS - (int32_t)((samples_ago * 1000) / bb->pending_rate_hz);
+  if (bb->post_ms <= 0) {
+    hold(bb);
+  }
+}
+
+
+
+/*
+	Logs the held window, from the block that
+	reaches BLACKBOX_PRE_MS before the trigger,
+	in a session of its own. Returns false if
+	data logging refused any of it.
+*/
+static bool log_window(BlackBox *bb) {
+  if (bb->num_blocks == 0) {
+    return false;
+  }
+
+  // The block holding the trigger, or the oldest if it is gone
+  uint32_t first = bb->num_blocks - 1;
+  while ((first > 0) && (block_at(bb, first)->first_sample > bb->trigger_sample)) {
+    first--;
+  }
+  const BlackBoxBlock *trigger_block = block_at(bb, first);
+  uint32_t pre_ms = 0;
+  if (bb->trigger_sample >= trigger_block->first_sample) {
+    pre_ms = ((bb->trigger_sample - trigger_block->first_sample) * 1000) / trigger_block->rate_hz;
+  }
+  while ((first > 0) && (pre_ms < BLACKBOX_PRE_MS)) {
+    first--;
+    pre_ms += block_ms(block_at(bb, first));
+  }
+
+  uint32_t first_sample = block_at(bb, first)->first_sample;
+  BlackBoxHeader header = {
+    .magic = BLACKBOX_MAGIC,
+    .num_blocks = bb->num_blocks - first,
+    .num_samples = bb->num_samples - first_sample,
+    .trigger_sample = (bb->trigger_sample > first_sample) ? (bb->trigger_sample - first_sample) : 0,
+    .end_time = bb->end_time,
+    .end_time_ms = bb->end_time_ms,
+  };
+
+  DataLoggingSessionRef session = data_logging_create(BLACKBOX_TAG, DATA_LOGGING_BYTE_ARRAY, 1, false);
+  if (!session) {
+    return false;
+  }
+  bool logged = (data_logging_log(session, &header, sizeof(header)) == DATA_LOGGING_SUCCESS);
+
+  // One log call per block: its rate, then the block out of the ring
+  uint8_t chunk[1 + BLOCK_BYTES];
+  for (uint32_t i = first; logged && (i < bb->num_blocks); i++) {
+    const BlackBoxBlock *block = block_at(bb, i);
+    uint32_t to_end = BLACKBOX_BYTES - block->offset;
+    uint32_t first_part = (block->length < to_end) ? block->length : to_end;
+    chunk[0] = block->rate_hz;
+    memcpy(&chunk[1], &bb->bytes[block->offset], first_part);
+    memcpy(&chunk[1 + first_part], bb->bytes, block->length - first_part);
+    logged = (data_logging_log(session, chunk, 1 + block->length) == DATA_LOGGING_SUCCESS);
+  }
+  data_logging_finish(session);
+  return logged;
+}
+
+
+
+/*
+	The fall was reported: logs the window, then
+	the ring starts over. Returns true if it was
+	all logged.
+*/
+bool blackbox_commit(BlackBox *bb) {
+  if (bb->state == BLACKBOX_ROLLING) {
+    return false;
+  }
+  if (bb->state == BLACKBOX_TRIGGERED) {
+    hold(bb);
+  }
+  bool logged = log_window(bb);
+  if (logged) {
+    bb->commits++;
+  } else {
+    bb->lost++;
+  }
+  clear(bb);
+  return logged;
+}
+
+
+
+/*
+	No fall to report: drops the window. The ring
+	only starts over if it stopped for the window.
+*/
+void blackbox_release(BlackBox *bb) {
+  if (bb->state == BLACKBOX_ROLLING) {
+    return;
+  }
+  bb->releases++;
+  if (bb->state == BLACKBOX_HELD) {
+    clear(bb);
+  } else {
+    bb->state = BLACKBOX_ROLLING;
+  }
+}
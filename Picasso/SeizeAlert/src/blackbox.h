@@ -0,0 +1,90 @@
+#pragma once
+
+/*
+	Black box: the motion around a fall, for whoever reviews it.
+
+	Every analysed sample goes through blackbox_add(), which copies
+	it into the pending block. Every BLACKBOX_BLOCK_SAMPLES samples,
+	or when the rate changes, the block is compressed (accel_codec.h)
+	into a ring of BLACKBOX_BYTES, dropping the oldest blocks. Each
+	sample is copied once and encoded once, and the memory is fixed.
+
+	blackbox_trigger() marks the step one sample. The recorder goes
+	on for BLACKBOX_POST_MS, then holds the window until the app
+	decides: blackbox_commit() logs it when the fall is reported,
+	blackbox_release() drops it on a false alarm or when no fall
+	followed. After a held window the ring starts over, as it does
+	on blackbox_reset() when the samples stop being contiguous.
+
+	A committed window goes to BLACKBOX_TAG as bytes: a
+	BlackBoxHeader, then for each block its rate in Hz (one byte)
+	and the accel_codec block. The first block is the one that
+	takes the window BLACKBOX_PRE_MS before the trigger, or the
+	oldest one left if the ring holds less.
+*/
+
+#include <pebble.h>
+#include <accel_codec.h>
+
+#define BLACKBOX_TAG 0xb
+#define BLACKBOX_MAGIC 0xbb
+#define BLACKBOX_PRE_MS 5000
+#define BLACKBOX_POST_MS 5000
+#define BLACKBOX_BLOCK_SAMPLES 25		// 1 s at 25 Hz
+#define BLACKBOX_BYTES 3072		// 10 s at 50 Hz takes about 2 KB
+#define BLACKBOX_MAX_BLOCKS 48
+
+typedef enum {
+  BLACKBOX_ROLLING = 0,
+  BLACKBOX_TRIGGERED,		// Recording the BLACKBOX_POST_MS after the trigger
+  BLACKBOX_HELD,		// Window complete, waiting for commit or release
+} BlackBoxState;
+
+// Start of a committed window
+typedef struct __attribute__((__packed__)) {
+  uint8_t magic;			// BLACKBOX_MAGIC
+  uint8_t num_blocks;
+  uint16_t num_samples;
+  uint16_t trigger_sample;		// Index of the step one sample in the window
+  uint32_t end_time;			// Watch time the window was complete
+  uint16_t end_time_ms;
+} BlackBoxHeader;
+
+typedef struct {
+  uint16_t offset;			// In bytes
+  uint8_t length;
+  uint8_t rate_hz;
+  uint8_t num_samples;
+  uint32_t first_sample;		// Number of the first sample since the ring started
+} BlackBoxBlock;
+
+typedef struct {
+  uint8_t bytes[BLACKBOX_BYTES];
+  BlackBoxBlock blocks[BLACKBOX_MAX_BLOCKS];
+  uint8_t oldest;			// Index of the oldest block
+  uint8_t num_blocks;
+  uint16_t head;			// Byte the next block goes to
+  uint16_t used;			// Bytes taken by the blocks
+
+  int16_t pending[BLACKBOX_BLOCK_SAMPLES * 3];	// Interleaved x, y, z
+  uint8_t num_pending;
+  uint8_t pending_rate_hz;
+  uint32_t num_samples;			// Samples added since the ring started
+
+  BlackBoxState state;
+  uint32_t trigger_sample;		// Number of the step one sample
+  int32_t post_ms;			// Still to record after it
+  time_t end_time;
+  uint16_t end_time_ms;
+
+  uint32_t commits;			// Windows logged since init
+  uint32_t releases;
+  uint32_t lost;			// Commits data logging refused
+} BlackBox;
+
+void blackbox_init(BlackBox *bb);
+void blackbox_reset(BlackBox *bb);
+void blackbox_add(BlackBox *bb, const AccelData *data, uint32_t num_samples, uint8_t rate_hz);
+void blackbox_trigger(BlackBox *bb, uint32_t samples_ago);
+bool blackbox_commit(BlackBox *bb);
+void blackbox_release(BlackBox *bb);
@@ -0,0 +1,284 @@
+#include <pebble.h>
+#include <detector.h>
+
+// Indices into Detector.edges
+#define EDGES_STEP_ONE_LOWER 0		// test >= STEP_ONE_LOWER_BOUND
+#define EDGES_STEP_ONE_HIGHER 1		// test >= STEP_ONE_HIGHER_BOUND + 1
+#define EDGES_STEP_TWO 2		// test >= STEP_TWO_LOWER_BOUND
+#define EDGES_STEP_THREE 3		// test >= STEP_THREE_HIGHER_BOUND
+
+typedef enum {
+  MATCH_ENTER,		// Leave on the first step one sample (while armed)
+  MATCH_RUN,		// Count consecutive step one samples, decide on the first miss
+  MATCH_ANY,		// After the step's samples, ask the window: any sample past the edges?
+} DetectorMatch;
+
+typedef struct {
+  uint8_t match;
+  uint8_t edges;		// MATCH_ANY only
+  uint8_t on_hit;
+  uint8_t on_miss;
+} DetectorTransition;
+
+//////////////////////////////////////////  Tables  ///////////////////////////////////////////////
+
+static const DetectorTransition s_transitions[DETECTOR_ALERT] = {
+  [DETECTOR_IDLE] =       { MATCH_ENTER, 0,                DETECTOR_STEP_ONE,   DETECTOR_IDLE },
+  [DETECTOR_STEP_ONE] =   { MATCH_RUN,   0,                DETECTOR_STEP_TWO,   DETECTOR_IDLE },
+  [DETECTOR_STEP_TWO] =   { MATCH_ANY,   EDGES_STEP_TWO,   DETECTOR_STEP_THREE, DETECTOR_IDLE },
+  [DETECTOR_STEP_THREE] = { MATCH_ANY,   EDGES_STEP_THREE, DETECTOR_STEP_FOUR,  DETECTOR_ALERT },
+  [DETECTOR_STEP_FOUR] =  { MATCH_ANY,   EDGES_STEP_THREE, DETECTOR_IDLE,       DETECTOR_ALERT },
+};
+
+// Event reported when a state is entered, -1 for none
+static const int8_t s_enter_events[DETECTOR_STATE_COUNT] = {
+  [DETECTOR_IDLE] = -1,
+  [DETECTOR_STEP_ONE] = DETECTOR_EVENT_CANDIDATE,
+  [DETECTOR_STEP_TWO] = DETECTOR_EVENT_IMPACT,
+  [DETECTOR_STEP_THREE] = -1,
+  [DETECTOR_STEP_FOUR] = -1,
+  [DETECTOR_ALERT] = DETECTOR_EVENT_FALL,
+};
+
+
+
+/*
+	Sample count of a step of `samples` at
+	DETECTOR_RATE_HZ, at rate_hz. Never 0.
+*/
+static uint16_t scale_samples(uint32_t samples, uint16_t rate_hz) {
+  uint32_t scaled = (samples * rate_hz + DETECTOR_RATE_HZ - 1) / DETECTOR_RATE_HZ;
+  return scaled ? scaled : 1;
+}
+
+
+
+static void set_step_ms(Detector *det) {
+  det->step_ms[DETECTOR_IDLE] = 0;
+  det->step_ms[DETECTOR_STEP_ONE] = DETECTOR_STEP_MS(det->config.step_one_samples);
+  det->step_ms[DETECTOR_STEP_TWO] = DETECTOR_STEP_MS(det->config.step_two_samples);
+  det->step_ms[DETECTOR_STEP_THREE] = DETECTOR_STEP_MS(det->config.step_three_samples);
+  det->step_ms[DETECTOR_STEP_FOUR] = det->step_ms[DETECTOR_STEP_THREE];
+  det->step_ms[DETECTOR_ALERT] = 0;
+}
+
+
+
+static void set_edges(Detector *det) {
+  det->edges[EDGES_STEP_ONE_LOWER] = accel_deviation_edges(det->config.step_one_lower_bound);
+  det->edges[EDGES_STEP_ONE_HIGHER] = accel_deviation_edges(det->config.step_one_higher_bound + 1);
+  det->edges[EDGES_STEP_TWO] = accel_deviation_edges(det->config.step_two_lower_bound);
+  det->edges[EDGES_STEP_THREE] = accel_deviation_edges(det->config.step_three_higher_bound);
+}
+
+
+
+// Long enough for the longest step at the highest rate
+static uint16_t window_length(const DetectorConfig *config) {
+  uint32_t window = (config->step_two_samples > config->step_three_samples) ?
+                    config->step_two_samples : config->step_three_samples;
+  window = scale_samples(window, DETECTOR_MAX_RATE_HZ);
+  return (window < MAGNITUDE_WINDOW_SIZE) ? window : MAGNITUDE_WINDOW_SIZE;
+}
+
+
+
+void detector_init(Detector *det, const DetectorConfig *config) {
+  det->config = *config;
+  set_edges(det);
+
+  det->rate_hz = DETECTOR_RATE_HZ;
+  det->stamped = false;
+  det->now_ms = 0;
+  set_step_ms(det);
+  magnitude_window_init(&det->window, window_length(config));
+  posture_init(&det->posture, det->rate_hz);
+  det->tilt = 0;
+
+  det->armed = true;
+  detector_reset(det);
+}
+
+
+
+/*
+	Switches to config between two samples, keeping
+	the window and the FSM state: the next sample is
+	tested against the new bounds, and a step in
+	progress keeps the time it has run but now takes
+	the new step's duration. No sample is dropped and
+	nothing is allocated.
+*/
+void detector_set_config(Detector *det, const DetectorConfig *config) {
+  det->config = *config;
+  set_edges(det);
+  set_step_ms(det);
+  magnitude_window_set_length(&det->window, window_length(config));
+}
+
+
+
+void detector_reset(Detector *det) {
+  det->state = DETECTOR_IDLE;
+  det->counter = 0;
+  det->start_ms = det->now_ms;
+  det->run_ms = det->now_ms;
+}
+
+
+
+void detector_set_armed(Detector *det, bool armed) {
+  det->armed = armed;
+}
+
+
+
+/*
+	Samples come at rate_hz from now on. Steps are
+	timed by the samples' timestamps, so this only
+	sets how far the clock moves for a sample that
+	has none.
+*/
+void detector_set_rate(Detector *det, uint16_t rate_hz) {
+  if (rate_hz != 0) {
+    det->rate_hz = rate_hz;
+    posture_set_rate(&det->posture, rate_hz);
+  }
+}
+
+
+
+/*
+	Moves the clock to a sample: by the time since
+	the last timestamped sample if it is one to a
+	few periods, else by one period of the nominal
+	rate (unstamped samples, such as traces replayed
+	without times, and steps of the watch clock).
+*/
+static inline void clock_sample(Detector *det, const AccelData *sample) {
+  uint32_t period_ms = 1000 / det->rate_hz;
+  uint32_t step_ms = period_ms;
+  if (sample->timestamp != 0) {
+    uint32_t ms = (uint32_t)sample->timestamp;
+    int32_t delta_ms = (int32_t)(ms - det->stamp_ms);
+    if (det->stamped && (delta_ms > 0) && ((uint32_t)delta_ms <= DETECTOR_MAX_GAP_PERIODS * period_ms)) {
+      step_ms = delta_ms;
+    }
+    det->stamp_ms = ms;
+    det->stamped = true;
+  }
+  det->prev_ms = det->now_ms;
+  det->now_ms += step_ms;
+}
+
+
+
+static inline bool in_step_one_band(const Detector *det, uint32_t m2) {
+  return accel_deviation_at_least(m2, det->edges[EDGES_STEP_ONE_LOWER]) &&
+         !accel_deviation_at_least(m2, det->edges[EDGES_STEP_ONE_HIGHER]);
+}
+
+
+
+/*
+	True if any of the newest `last` samples is past
+	the edges, from the window's squared magnitude
+	min / max instead of a per-sample flag.
+*/
+static bool window_any_past(const Detector *det, uint8_t edges, uint16_t last) {
+  int32_t min, max;
+  if (!magnitude_window_range(&det->window, last, &min, &max)) {
+    return false;
+  }
+  return accel_deviation_at_least((uint32_t)min, det->edges[edges]) ||
+         accel_deviation_at_least((uint32_t)max, det->edges[edges]);
+}
+
+
+
+/*
+	Runs a batch of samples through the FSM and
+	writes the events it produced (at most
+	DETECTOR_MAX_EVENTS(num_samples)) to events.
+	Returns the number of events, which may exceed
+	max_events; extra events are not stored.
+*/
+uint32_t detector_feed(Detector *det, const AccelData *data, uint32_t num_samples,
+                       DetectorEvent *events, uint32_t max_events) {
+  uint32_t num_events = 0;
+
+  for (uint32_t i = 0; i < num_samples; i++) {
+    magnitude_window_push(&det->window, &data[i]);
+    clock_sample(det, &data[i]);
+    posture_add(&det->posture, &data[i]);
+    bool step_one = in_step_one_band(det, (uint32_t)magnitude_window_newest(&det->window));
+    bool again;
+
+    do {
+      const DetectorTransition *transition = &s_transitions[det->state];
+      uint8_t next = det->state;
+      again = false;
+
+      switch (transition->match) {
+        case MATCH_ENTER:
+          if (step_one && det->armed) {
+            next = transition->on_hit;
+            again = true;		// The entering sample counts towards the next step
+          }
+          break;
+
+        case MATCH_RUN:
+          if (step_one) {
+            det->counter++;
+            det->run_ms = det->now_ms;
+          } else if (det->run_ms - det->start_ms >= det->step_ms[det->state]) {
+            next = transition->on_hit;
+            again = true;		// The first sample out of the run starts the next step
+          } else {
+            next = transition->on_miss;
+          }
+          break;
+
+        case MATCH_ANY:
+          det->counter++;
+          if (det->now_ms - det->start_ms >= det->step_ms[det->state]) {
+            bool hit = window_any_past(det, transition->edges, det->counter);
+            next = hit ? transition->on_hit : transition->on_miss;
+          }
+          break;
+      }
+
+      if (next != det->state) {
+        int8_t event = s_enter_events[next];
+        if (next == DETECTOR_STEP_ONE) {
+          posture_mark(&det->posture);	// Gravity still has the posture before the free fall
+        } else if (next == DETECTOR_ALERT) {
+          det->tilt = posture_tilt(&det->posture);
+          if (det->tilt < DETECTOR_MIN_TILT) {
+            next = DETECTOR_IDLE;
+            event = DETECTOR_EVENT_UPRIGHT;
+          }
+        }
+
+        // A step starts after the sample before its first one
+        det->counter = 0;
+        det->start_ms = again ? det->prev_ms : det->now_ms;
+        det->run_ms = det->start_ms;
+        det->state = next;
+
+        if (event >= 0) {
+          if (num_events < max_events) {
+            events[num_events] = (DetectorEvent) { .type = event, .sample = i };
+          }
+          num_events++;
+        }
+        if (next == DETECTOR_ALERT) {
+          det->state = DETECTOR_IDLE;
+          again = false;
+        }
+      }
+    } while (again);
+  }
+
+  return num_events;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+/*
+	SeizeAlert's fall detector.
+
+	A self-contained, table-driven version of the FSM that used
+	to live in SeizeAlert.c. All state is in the Detector struct,
+	so any number of detectors (sensitivity profiles, replayed
+	patients) can run side by side. detector_feed() never
+	allocates and never touches the UI: it returns events and
+	the app decides what to show.
+
+	Steps:
+	  1. Free fall: STEP_ONE_SAMPLES or more consecutive samples
+	     with a deviation from 1 g in [STEP_ONE_LOWER_BOUND, STEP_ONE_HIGHER_BOUND]
+	  2. Impact: any deviation >= STEP_TWO_LOWER_BOUND in the next STEP_TWO_SAMPLES
+	  3. Inactivity: all deviations < STEP_THREE_HIGHER_BOUND for STEP_THREE_SAMPLES
+	  4. If step 3 saw movement, recheck inactivity once more
+	  5. Posture: the wrist tilted at least DETECTOR_MIN_TILT_DEG
+	     from where it was before the free fall (posture.h)
+	  Passing step 3 or 4 reports a fall, unless step 5 fails:
+	  then it is reported as DETECTOR_EVENT_UPRIGHT (set down,
+	  not fallen), and no countdown starts.
+
+	Steps 2 to 4 are answered from the detector's MagnitudeWindow
+	(min / max of the squared magnitude over the step), so step
+	sample counts are limited to MAGNITUDE_WINDOW_SIZE.
+
+	The hand-picked defaults below give way to detector_tuned.h
+	when host/tools/seizealert_tune has written one.
+
+	detector_set_config() swaps the configuration of a running
+	detector between two batches (detector_profile.h), without
+	losing the window or the step in progress.
+
+	Steps are timed, not counted: the step sample counts are
+	given at DETECTOR_RATE_HZ, the way they were tuned, and
+	stand for durations (STEP_TWO_SAMPLES is 1000 ms). The
+	detector's clock moves by the time between the timestamps
+	(AccelData.timestamp) of consecutive samples, so a step
+	lasts as long whatever the rate (up to DETECTOR_MAX_RATE_HZ)
+	and however irregular the samples come. Where that time
+	cannot be trusted (a sample without a timestamp, the first
+	one, the watch clock set back, or a gap of more than
+	DETECTOR_MAX_GAP_PERIODS periods) the clock moves one
+	period of the rate given to detector_set_rate(), so a step
+	of the wall clock neither freezes nor ends a step.
+*/
+
+#include <pebble.h>
+#include <accel_magnitude.h>
+#include <magnitude_window.h>
+#include <posture.h>
+#include <detector_tuned.h>		// seizealert_tune's constants, if any
+
+#ifndef STEP_ONE_LOWER_BOUND
+#define STEP_ONE_LOWER_BOUND 800
+#define STEP_ONE_HIGHER_BOUND 1000
+#define STEP_ONE_SAMPLES 4
+
+#define STEP_TWO_LOWER_BOUND 500
+#define STEP_TWO_SAMPLES 25
+
+#define STEP_THREE_HIGHER_BOUND 100
+#define STEP_THREE_SAMPLES 50
+#endif
+
+// Tilt from the posture before the free fall that confirms a fall, 0 = no check
+#ifndef DETECTOR_MIN_TILT_DEG
+#define DETECTOR_MIN_TILT_DEG 30
+#endif
+#define DETECTOR_MIN_TILT ((TRIG_MAX_ANGLE * DETECTOR_MIN_TILT_DEG) / 360)
+
+#define DETECTOR_RATE_HZ 25		// Rate the step sample counts are for
+#define DETECTOR_MAX_RATE_HZ 100
+#define DETECTOR_MAX_GAP_PERIODS 4	// Longer between two timestamps is a clock step
+#define DETECTOR_STEP_MS(samples) (((uint32_t)(samples) * 1000) / DETECTOR_RATE_HZ)
+
+// Longest step two or three the window holds at DETECTOR_MAX_RATE_HZ
+#define DETECTOR_MAX_STEP_SAMPLES ((MAGNITUDE_WINDOW_SIZE * DETECTOR_RATE_HZ) / DETECTOR_MAX_RATE_HZ)
+
+// detector_feed() reports at most one event per sample
+#define DETECTOR_MAX_EVENTS(num_samples) (num_samples)
+
+typedef struct {
+  uint16_t step_one_lower_bound;
+  uint16_t step_one_higher_bound;
+  uint16_t step_one_samples;
+  uint16_t step_two_lower_bound;
+  uint16_t step_two_samples;
+  uint16_t step_three_higher_bound;
+  uint16_t step_three_samples;
+} DetectorConfig;
+
+#define DETECTOR_DEFAULT_CONFIG ((DetectorConfig) {	\
+    .step_one_lower_bound = STEP_ONE_LOWER_BOUND,	\
+    .step_one_higher_bound = STEP_ONE_HIGHER_BOUND,	\
+    .step_one_samples = STEP_ONE_SAMPLES,		\
+    .step_two_lower_bound = STEP_TWO_LOWER_BOUND,	\
+    .step_two_samples = STEP_TWO_SAMPLES,		\
+    .step_three_higher_bound = STEP_THREE_HIGHER_BOUND,	\
+    .step_three_samples = STEP_THREE_SAMPLES,		\
+  })
+
+typedef enum {
+  DETECTOR_IDLE = 0,
+  DETECTOR_STEP_ONE,
+  DETECTOR_STEP_TWO,
+  DETECTOR_STEP_THREE,
+  DETECTOR_STEP_FOUR,
+  DETECTOR_ALERT,		// Transient: reported as DETECTOR_EVENT_FALL, then back to idle
+  DETECTOR_STATE_COUNT,
+} DetectorState;
+
+typedef enum {
+  DETECTOR_EVENT_CANDIDATE = 0,	// A sample entered the step one band
+  DETECTOR_EVENT_IMPACT,		// Step one passed (free fall seen)
+  DETECTOR_EVENT_FALL,		// All steps passed: start the countdown
+  DETECTOR_EVENT_UPRIGHT,	// Steps 1 to 4 passed, but the posture did not change
+} DetectorEventType;
+
+typedef struct {
+  DetectorEventType type;
+  uint32_t sample;		// Index in the batch given to detector_feed()
+} DetectorEvent;
+
+typedef struct {
+  DetectorConfig config;
+  AccelDeviationEdges edges[4];	// Squared band edges, derived from config
+  uint16_t rate_hz;		// Nominal rate, for samples without a timestamp
+  uint32_t step_ms[DETECTOR_STATE_COUNT];	// Step durations
+
+  uint8_t state;
+  bool armed;			// Idle only leaves on step one while armed
+  uint16_t counter;		// Samples since the step started
+
+  // Clock, in ms from detector_init()
+  bool stamped;			// stamp_ms holds a timestamp
+  uint32_t stamp_ms;		// Of the last sample that had one, low 32 bits
+  uint32_t now_ms;		// Time of the newest sample
+  uint32_t prev_ms;		// Time of the sample before it
+  uint32_t start_ms;		// The step started after this time
+  uint32_t run_ms;		// Time of the last step one sample of the run
+
+  MagnitudeWindow window;	// Recent samples, shared with the rate controller
+  Posture posture;		// Marked on each step one candidate
+  int32_t tilt;			// Of the last steps 1 to 4 passed, TRIG_MAX_ANGLE units
+} Detector;
+
+void detector_init(Detector *det, const DetectorConfig *config);
+void detector_set_config(Detector *det, const DetectorConfig *config);
+void detector_reset(Detector *det);
+void detector_set_armed(Detector *det, bool armed);
+void detector_set_rate(Detector *det, uint16_t rate_hz);
+
+uint32_t detector_feed(Detector *det, const AccelData *data, uint32_t num_samples,
+                       DetectorEvent *events, uint32_t max_events);
@@ -0,0 +1,239 @@
+#include <pebble.h>
+#include <detector_profile.h>
+
+
+static void set_standard(DetectorProfile *profile) {
+  memset(profile, 0, sizeof(*profile));
+  profile->detector = DETECTOR_DEFAULT_CONFIG;
+  strncpy(profile->name, "standard", sizeof(profile->name) - 1);
+  profile->version = DETECTOR_PROFILE_VERSION;
+  profile->alert_window = ALERT_WINDOW;
+  profile->rate_hz = 0;
+}
+
+
+
+/*
+	The built-in profile, then whatever valid profiles
+	and active slot persist holds. Anything stored in
+	another layout, or no longer valid, is left out.
+*/
+void detector_profiles_load(DetectorProfiles *profiles) {
+  memset(profiles, 0, sizeof(*profiles));
+  set_standard(&profiles->profiles[DETECTOR_PROFILE_STANDARD]);
+
+  for (uint8_t slot = DETECTOR_PROFILE_STANDARD + 1; slot < DETECTOR_PROFILES; slot++) {
+    DetectorProfile profile;
+    int size = persist_read_data(DETECTOR_PROFILE_PERSIST_KEY + slot, &profile, sizeof(profile));
+    if ((size == (int)sizeof(profile)) && (profile.version == DETECTOR_PROFILE_VERSION) &&
+        (detector_profile_validate(&profile) == DETECTOR_PROFILE_OK)) {
+      profile.name[DETECTOR_PROFILE_NAME_LENGTH - 1] = '\0';
+      profiles->profiles[slot] = profile;
+    }
+  }
+
+  if (persist_exists(DETECTOR_PROFILE_ACTIVE_PERSIST_KEY)) {
+    int32_t active = persist_read_int(DETECTOR_PROFILE_ACTIVE_PERSIST_KEY);
+    if ((active >= 0) && (active < DETECTOR_PROFILES) && profiles->profiles[active].version) {
+      profiles->active = active;
+    }
+  }
+}
+
+
+
+const DetectorProfile *detector_profiles_active(const DetectorProfiles *profiles) {
+  return &profiles->profiles[profiles->active];
+}
+
+
+
+static bool is_sampling_rate(uint8_t rate_hz) {
+  return (rate_hz == ACCEL_SAMPLING_10HZ) || (rate_hz == ACCEL_SAMPLING_25HZ) ||
+         (rate_hz == ACCEL_SAMPLING_50HZ) || (rate_hz == ACCEL_SAMPLING_100HZ);
+}
+
+
+
+static bool in_range(uint32_t value, uint32_t min, uint32_t max) {
+  return (value >= min) && (value <= max);
+}
+
+
+
+/*
+	A profile the detector can run: bands in order
+	and within DETECTOR_PROFILE_MAX_BOUND, steps the
+	window can hold, a countdown long enough to
+	cancel, and a rate the accelerometer has.
+*/
+DetectorProfileResult detector_profile_validate(const DetectorProfile *profile) {
+  const DetectorConfig *config = &profile->detector;
+
+  if (!in_range(config->step_one_lower_bound, 1, DETECTOR_PROFILE_MAX_BOUND) ||
+      !in_range(config->step_one_higher_bound, config->step_one_lower_bound + 1, DETECTOR_PROFILE_MAX_BOUND) ||
+      !in_range(config->step_two_lower_bound, 1, DETECTOR_PROFILE_MAX_BOUND) ||
+      !in_range(config->step_three_higher_bound, 1, DETECTOR_PROFILE_MAX_BOUND)) {
+    return DETECTOR_PROFILE_BAD_BOUNDS;
+  }
+  if (!in_range(config->step_one_samples, 1, DETECTOR_MAX_STEP_SAMPLES) ||
+      !in_range(config->step_two_samples, 1, DETECTOR_MAX_STEP_SAMPLES) ||
+      !in_range(config->step_three_samples, 1, DETECTOR_MAX_STEP_SAMPLES)) {
+    return DETECTOR_PROFILE_BAD_SAMPLES;
+  }
+  if (!in_range(profile->alert_window, DETECTOR_PROFILE_MIN_ALERT_WINDOW, DETECTOR_PROFILE_MAX_ALERT_WINDOW)) {
+    return DETECTOR_PROFILE_BAD_ALERT_WINDOW;
+  }
+  if ((profile->rate_hz != 0) && !is_sampling_rate(profile->rate_hz)) {
+    return DETECTOR_PROFILE_BAD_RATE;
+  }
+  return DETECTOR_PROFILE_OK;
+}
+
+
+
+/*
+	Validates and stores a profile in a slot, in
+	persist first, so RAM never holds what a restart
+	would not find. The same profile again is not
+	written.
+*/
+DetectorProfileResult detector_profiles_store(DetectorProfiles *profiles, uint8_t slot, const DetectorProfile *profile) {
+  if (slot >= DETECTOR_PROFILES) {
+    return DETECTOR_PROFILE_BAD_SLOT;
+  }
+  if (slot == DETECTOR_PROFILE_STANDARD) {
+    return DETECTOR_PROFILE_READ_ONLY;
+  }
+  DetectorProfileResult result = detector_profile_validate(profile);
+  if (result != DETECTOR_PROFILE_OK) {
+    return result;
+  }
+
+  DetectorProfile stored = *profile;
+  stored.name[DETECTOR_PROFILE_NAME_LENGTH - 1] = '\0';
+  stored.version = DETECTOR_PROFILE_VERSION;
+  stored.reserved = 0;
+  if (memcmp(&stored, &profiles->profiles[slot], sizeof(stored)) == 0) {
+    return DETECTOR_PROFILE_OK;
+  }
+  if (persist_write_data(DETECTOR_PROFILE_PERSIST_KEY + slot, &stored, sizeof(stored)) != (int)sizeof(stored)) {
+    return DETECTOR_PROFILE_STORAGE;
+  }
+  profiles->profiles[slot] = stored;
+  profiles->stores++;
+  return DETECTOR_PROFILE_OK;
+}
+
+
+
+DetectorProfileResult detector_profiles_activate(DetectorProfiles *profiles, uint8_t slot) {
+  if (slot >= DETECTOR_PROFILES) {
+    return DETECTOR_PROFILE_BAD_SLOT;
+  }
+  if (!profiles->profiles[slot].version) {
+    return DETECTOR_PROFILE_EMPTY;
+  }
+  if (slot == profiles->active) {
+    return DETECTOR_PROFILE_OK;
+  }
+  if (persist_write_int(DETECTOR_PROFILE_ACTIVE_PERSIST_KEY, slot) != S_SUCCESS) {
+    return DETECTOR_PROFILE_STORAGE;
+  }
+  profiles->active = slot;
+  profiles->switches++;
+  return DETECTOR_PROFILE_OK;
+}
+
+
+
+/*
+	Integer value of a tuple of any width, clamped
+	to 0 .. max: out of range values then fail
+	validation instead of wrapping into range.
+*/
+static uint16_t tuple_value(const Tuple *tuple, uint16_t max) {
+  int32_t value;
+  switch (tuple->length) {
+    case 1:
+      value = (tuple->type == TUPLE_INT) ? tuple->value->int8 : tuple->value->uint8;
+      break;
+    case 2:
+      value = (tuple->type == TUPLE_INT) ? tuple->value->int16 : tuple->value->uint16;
+      break;
+    default:
+      if ((tuple->type == TUPLE_UINT) && (tuple->value->uint32 > INT32_MAX)) {
+        return max;
+      }
+      value = tuple->value->int32;
+      break;
+  }
+  return (value < 0) ? 0 : ((value > max) ? max : (uint16_t)value);
+}
+
+
+
+static void set_field(DetectorProfile *profile, const Tuple *tuple) {
+  DetectorConfig *config = &profile->detector;
+  switch (tuple->key) {
+    case PROFILE_MSG_NAME:
+      if (tuple->type == TUPLE_CSTRING) {
+        strncpy(profile->name, tuple->value->cstring, sizeof(profile->name) - 1);
+        profile->name[sizeof(profile->name) - 1] = '\0';
+      }
+      break;
+    case PROFILE_MSG_STEP_ONE_LOWER_BOUND: config->step_one_lower_bound = tuple_value(tuple, UINT16_MAX); break;
+    case PROFILE_MSG_STEP_ONE_HIGHER_BOUND: config->step_one_higher_bound = tuple_value(tuple, UINT16_MAX); break;
+    case PROFILE_MSG_STEP_ONE_SAMPLES: config->step_one_samples = tuple_value(tuple, UINT16_MAX); break;
+    case PROFILE_MSG_STEP_TWO_LOWER_BOUND: config->step_two_lower_bound = tuple_value(tuple, UINT16_MAX); break;
+    case PROFILE_MSG_STEP_TWO_SAMPLES: config->step_two_samples = tuple_value(tuple, UINT16_MAX); break;
+    case PROFILE_MSG_STEP_THREE_HIGHER_BOUND: config->step_three_higher_bound = tuple_value(tuple, UINT16_MAX); break;
+    case PROFILE_MSG_STEP_THREE_SAMPLES: config->step_three_samples = tuple_value(tuple, UINT16_MAX); break;
+    case PROFILE_MSG_ALERT_WINDOW: profile->alert_window = tuple_value(tuple, UINT8_MAX); break;
+    case PROFILE_MSG_SAMPLING_RATE: profile->rate_hz = tuple_value(tuple, UINT8_MAX); break;
+  }
+}
+
+
+
+/*
+	Handles one message from the phone (see the
+	header): stores, then activates. active_changed
+	is set when the app has to swap the active
+	profile in. Returns the first failure, nothing
+	is stored or switched past it.
+*/
+DetectorProfileResult detector_profiles_receive(DetectorProfiles *profiles, DictionaryIterator *iter,
+                                                bool *active_changed) {
+  *active_changed = false;
+  Tuple *slot_tuple = dict_find(iter, PROFILE_MSG_SLOT);
+  Tuple *activate_tuple = dict_find(iter, PROFILE_MSG_ACTIVATE);
+  DetectorProfileResult result = DETECTOR_PROFILE_OK;
+
+  if (slot_tuple) {
+    uint8_t slot = tuple_value(slot_tuple, UINT8_MAX);
+    if (slot >= DETECTOR_PROFILES) {
+      result = DETECTOR_PROFILE_BAD_SLOT;
+    } else {
+      // Fields left out keep their value, from the standard profile for an empty slot
+      DetectorProfile profile = profiles->profiles[profiles->profiles[slot].version ? slot : DETECTOR_PROFILE_STANDARD];
+      for (Tuple *tuple = dict_read_first(iter); tuple; tuple = dict_read_next(iter)) {
+        set_field(&profile, tuple);
+      }
+      uint32_t stores = profiles->stores;
+      result = detector_profiles_store(profiles, slot, &profile);
+      *active_changed = (profiles->stores != stores) && (slot == profiles->active);
+    }
+  }
+
+  if (activate_tuple && (result == DETECTOR_PROFILE_OK)) {
+    uint8_t active = profiles->active;
+    result = detector_profiles_activate(profiles, tuple_value(activate_tuple, UINT8_MAX));
+    *active_changed |= (profiles->active != active);
+  }
+
+  if ((result != DETECTOR_PROFILE_OK) && (result != DETECTOR_PROFILE_STORAGE)) {
+    profiles->rejected++;
+  }
+  return result;
+}
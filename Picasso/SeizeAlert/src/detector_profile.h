@@ -0,0 +1,106 @@
+#pragma once
+
+/*
+	Named detection profiles for SeizeAlert, set from the phone.
+
+	A profile is everything that decides how eager the app is to
+	alert: the fall detector's DetectorConfig, the countdown
+	length and the accelerometer rate (0 leaves it to the rate
+	controller). There are DETECTOR_PROFILES slots. Slot 0 is
+	"standard", the build's defaults (detector.h), and cannot be
+	overwritten, so a bad push can always be undone by switching
+	back to it; the others hold whatever the phone stored.
+
+	The phone sends one AppMessage per change, with the keys
+	below (also in appinfo.json):
+
+	  - PROFILE_MSG_SLOT and any of the profile fields: stores
+	    that slot, fields left out keep their stored value; a
+	    profile equal to the stored one costs no write
+	  - PROFILE_MSG_ACTIVATE: switches to a slot, after the
+	    store if both are in the message
+
+	detector_profiles_receive() validates a profile as a whole
+	before anything is stored, writes it with the persist API
+	and tells the app whether the active profile changed, which
+	the app then swaps into the running detector between two
+	batches (detector_set_config()). Switching is a copy out of
+	the table kept in RAM plus one 4 byte persist write.
+*/
+
+#include <pebble.h>
+#include <detector.h>
+
+#ifndef ALERT_WINDOW
+#define ALERT_WINDOW 10			// Standard countdown seconds, unless detector_tuned.h sets it
+#endif
+
+#define DETECTOR_PROFILES 4
+#define DETECTOR_PROFILE_STANDARD 0	// Built-in slot
+#define DETECTOR_PROFILE_NAME_LENGTH 16	// With the terminating NUL
+#define DETECTOR_PROFILE_VERSION 1	// Of the stored layout; other versions are ignored
+
+// Persist keys: one per slot, then the active slot
+#define DETECTOR_PROFILE_PERSIST_KEY 0x100
+#define DETECTOR_PROFILE_ACTIVE_PERSIST_KEY (DETECTOR_PROFILE_PERSIST_KEY + DETECTOR_PROFILES)
+
+// What validation accepts
+#define DETECTOR_PROFILE_MAX_BOUND 2000			// mg of deviation from 1 g
+#define DETECTOR_PROFILE_MIN_ALERT_WINDOW 3		// Countdown seconds
+#define DETECTOR_PROFILE_MAX_ALERT_WINDOW 60
+
+// AppMessage keys, as in appinfo.json
+typedef enum {
+  PROFILE_MSG_SLOT = 0,
+  PROFILE_MSG_NAME,
+  PROFILE_MSG_STEP_ONE_LOWER_BOUND,
+  PROFILE_MSG_STEP_ONE_HIGHER_BOUND,
+  PROFILE_MSG_STEP_ONE_SAMPLES,
+  PROFILE_MSG_STEP_TWO_LOWER_BOUND,
+  PROFILE_MSG_STEP_TWO_SAMPLES,
+  PROFILE_MSG_STEP_THREE_HIGHER_BOUND,
+  PROFILE_MSG_STEP_THREE_SAMPLES,
+  PROFILE_MSG_ALERT_WINDOW,
+  PROFILE_MSG_SAMPLING_RATE,
+  PROFILE_MSG_ACTIVATE,
+  PROFILE_MSG_RESULT,		// Reply: DetectorProfileResult
+} DetectorProfileMessageKey;
+
+typedef enum {
+  DETECTOR_PROFILE_OK = 0,
+  DETECTOR_PROFILE_BAD_SLOT,
+  DETECTOR_PROFILE_READ_ONLY,		// Slot 0 is the build's
+  DETECTOR_PROFILE_BAD_BOUNDS,
+  DETECTOR_PROFILE_BAD_SAMPLES,
+  DETECTOR_PROFILE_BAD_ALERT_WINDOW,
+  DETECTOR_PROFILE_BAD_RATE,
+  DETECTOR_PROFILE_EMPTY,		// Activating a slot nothing was stored in
+  DETECTOR_PROFILE_STORAGE,		// persist refused the write
+} DetectorProfileResult;
+
+// Also the stored layout: 34 bytes, no padding
+typedef struct {
+  DetectorConfig detector;
+  char name[DETECTOR_PROFILE_NAME_LENGTH];
+  uint8_t version;			// DETECTOR_PROFILE_VERSION, 0 = empty slot
+  uint8_t alert_window;			// Countdown seconds
+  uint8_t rate_hz;			// AccelSamplingRate, 0 = adaptive
+  uint8_t reserved;
+} DetectorProfile;
+
+typedef struct {
+  DetectorProfile profiles[DETECTOR_PROFILES];
+  uint8_t active;
+
+  uint32_t stores;			// Profiles written since load
+  uint32_t switches;
+  uint32_t rejected;			// Messages refused by validation
+} DetectorProfiles;
+
+void detector_profiles_load(DetectorProfiles *profiles);
+const DetectorProfile *detector_profiles_active(const DetectorProfiles *profiles);
+DetectorProfileResult detector_profile_validate(const DetectorProfile *profile);
+DetectorProfileResult detector_profiles_store(DetectorProfiles *profiles, uint8_t slot, const DetectorProfile *profile);
+DetectorProfileResult detector_profiles_activate(DetectorProfiles *profiles, uint8_t slot);
+DetectorProfileResult detector_profiles_receive(DetectorProfiles *profiles, DictionaryIterator *iter,
+                                                bool *active_changed);
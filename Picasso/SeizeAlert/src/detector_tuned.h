@@ -0,0 +1,7 @@
+#pragma once
+
+/*
+	Fall detector constants chosen by host/tools/seizealert_tune
+	(--header). Empty: detector.h's and detector_profile.h's defaults
+	apply.
+*/
@@ -0,0 +1,78 @@
+#include <pebble.h>
+#include <event_log.h>
+
+
+void event_log_init(EventLog *log, uint32_t tag) {
+  memset(log, 0, sizeof(*log));
+  log->tag = tag;
+  log->session = data_logging_create(tag, DATA_LOGGING_BYTE_ARRAY, sizeof(EventRecord), false);
+}
+
+
+
+void event_log_deinit(EventLog *log) {
+  event_log_flush(log);
+  if (log->session) {
+    data_logging_finish(log->session);
+    log->session = NULL;
+  }
+}
+
+
+
+/*
+	Sends every buffered record in one call. Returns
+	false and keeps the records if the session could
+	not take them.
+*/
+bool event_log_flush(EventLog *log) {
+  if (log->count == 0) {
+    return true;
+  }
+  if (!log->session) {
+    return false;
+  }
+  if (data_logging_log(log->session, log->records, log->count) != DATA_LOGGING_SUCCESS) {
+    return false;
+  }
+  log->count = 0;
+  log->flushes++;
+  return true;
+}
+
+
+
+void event_log_flush_stale(EventLog *log, time_t now) {
+  if ((log->count > 0) && (now - (time_t)log->records[0].time >= EVENT_LOG_MAX_AGE_S)) {
+    event_log_flush(log);
+  }
+}
+
+
+
+/*
+	Buffers one event, flushing when the batch is
+	full or the event is urgent.
+*/
+void event_log_append(EventLog *log, EventType type, uint8_t value, bool urgent) {
+  if ((log->count == EVENT_LOG_BATCH) && !event_log_flush(log)) {
+    memmove(&log->records[0], &log->records[1], (EVENT_LOG_BATCH - 1) * sizeof(EventRecord));
+    log->count--;
+    log->dropped++;
+  }
+
+  time_t now;
+  uint16_t now_ms;
+  time_ms(&now, &now_ms);
+
+  log->records[log->count++] = (EventRecord) {
+    .time = (uint32_t)now,
+    .time_ms = now_ms,
+    .type = type,
+    .value = value,
+  };
+
+  if (urgent || (log->count == EVENT_LOG_BATCH)) {
+    event_log_flush(log);
+  }
+}
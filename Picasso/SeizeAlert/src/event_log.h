@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+	Batched event logging over one long-lived data logging
+	session per tag.
+
+	Events are packed into fixed-size EventRecords and buffered;
+	a whole batch goes to the phone in one data_logging_log()
+	call when the buffer fills, when the oldest record is older
+	than EVENT_LOG_MAX_AGE_S (event_log_flush_stale(), from the
+	minute tick) or right away for urgent events. The session
+	stays open until event_log_deinit(), which flushes what is
+	left and finishes it.
+
+	Records that cannot be logged (session busy or full) stay
+	buffered and go out with the next flush; when the buffer is
+	full the oldest record is dropped.
+*/
+
+#include <pebble.h>
+
+#define EVENT_LOG_BATCH 8		// Records per data_logging_log() call
+#define EVENT_LOG_MAX_AGE_S (10 * 60)	// Flush buffered records at least this often
+
+typedef enum {
+  EVENT_FALL = 0,
+  EVENT_SEIZURE,
+  EVENT_COUNTDOWN,
+} EventType;
+
+// What the phone receives, one DATA_LOGGING_BYTE_ARRAY item per event
+typedef struct __attribute__((__packed__)) {
+  uint32_t time;		// Seconds since the epoch
+  uint16_t time_ms;
+  uint8_t type;			// EventType
+  uint8_t value;		// Event specific, 0 if unused
+} EventRecord;
+
+typedef struct {
+  uint32_t tag;
+  DataLoggingSessionRef session;
+  EventRecord records[EVENT_LOG_BATCH];
+  uint8_t count;
+
+  uint32_t flushes;		// Successful data_logging_log() calls
+  uint32_t dropped;		// Records lost to a full buffer
+} EventLog;
+
+void event_log_init(EventLog *log, uint32_t tag);
+void event_log_deinit(EventLog *log);
+
+void event_log_append(EventLog *log, EventType type, uint8_t value, bool urgent);
+bool event_log_flush(EventLog *log);
+void event_log_flush_stale(EventLog *log, time_t now);
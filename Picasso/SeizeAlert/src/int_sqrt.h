@@ -0,0 +1,26 @@
+#pragma once
+
+/*
+	Integer square root, bit by bit: no libm or float on
+	the watch. floor(sqrt(value)) for any 64 bit value.
+*/
+
+#include <pebble.h>
+
+static inline uint32_t int_sqrt(uint64_t value) {
+  uint64_t root = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+  while (bit > value) {
+    bit >>= 2;
+  }
+  while (bit) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)root;
+}
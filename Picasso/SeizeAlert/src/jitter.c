@@ -0,0 +1,99 @@
+#include <pebble.h>
+#include <jitter.h>
+#include <int_sqrt.h>
+
+
+void jitter_init(JitterHistogram *hist) {
+  memset(hist, 0, sizeof(*hist));
+}
+
+
+
+void jitter_restart(JitterHistogram *hist) {
+  hist->last_ms = 0;
+}
+
+
+
+static void add_interval(JitterHistogram *hist, int32_t error_ms) {
+  int32_t bin = (error_ms + (JITTER_BINS / 2) * JITTER_BIN_MS);
+  bin = (bin < 0) ? 0 : (bin / JITTER_BIN_MS);
+  hist->bins[(bin < JITTER_BINS) ? bin : (JITTER_BINS - 1)]++;
+
+  if ((hist->count == 0) || (error_ms < hist->min_ms)) {
+    hist->min_ms = error_ms;
+  }
+  if ((hist->count == 0) || (error_ms > hist->max_ms)) {
+    hist->max_ms = error_ms;
+  }
+  hist->sum_ms += error_ms;
+  hist->sum_squares += (uint64_t)((int64_t)error_ms * error_ms);
+  hist->count++;
+}
+
+
+
+/*
+	Bins the interval into each sample from the one
+	before it, for samples asked at rate_hz.
+*/
+void jitter_add(JitterHistogram *hist, const AccelData *data, uint32_t num_samples, uint16_t rate_hz) {
+  int32_t period_ms = 1000 / rate_hz;
+  for (uint32_t i = 0; i < num_samples; i++) {
+    uint64_t ms = data[i].timestamp;
+    if (ms == 0) {
+      continue;
+    }
+    if (hist->last_ms) {
+      add_interval(hist, (int32_t)(ms - hist->last_ms) - period_ms);
+    }
+    hist->last_ms = ms;
+  }
+}
+
+
+
+static int16_t clamp_int16(int64_t value) {
+  return (value > INT16_MAX) ? INT16_MAX : ((value < INT16_MIN) ? INT16_MIN : (int16_t)value);
+}
+
+
+
+void jitter_record(const JitterHistogram *hist, JitterRecord *record) {
+  memset(record, 0, sizeof(*record));
+  record->count = hist->count;
+  memcpy(record->bins, hist->bins, sizeof(record->bins));
+  if (hist->count == 0) {
+    return;
+  }
+  record->min_ms = clamp_int16(hist->min_ms);
+  record->max_ms = clamp_int16(hist->max_ms);
+  record->mean_us = clamp_int16((hist->sum_ms * 1000) / (int64_t)hist->count);
+  uint32_t rms_us = int_sqrt((hist->sum_squares * 1000000) / hist->count);
+  record->rms_us = (rms_us > UINT16_MAX) ? UINT16_MAX : rms_us;
+}
+
+
+
+/*
+	Console lines and the record, in a session of
+	its own.
+*/
+void jitter_dump(const JitterHistogram *hist) {
+  JitterRecord record;
+  jitter_record(hist, &record);
+  APP_LOG(APP_LOG_LEVEL_INFO, "jitter: %u intervals, error %d/%d/%d ms min/mean/max, %u us rms",
+          (unsigned)record.count, record.min_ms, record.mean_us / 1000, record.max_ms, (unsigned)record.rms_us);
+  for (int i = 0; i < JITTER_BINS; i++) {
+    if (record.bins[i]) {
+      APP_LOG(APP_LOG_LEVEL_INFO, "jitter: %+4d ms %u", (i - JITTER_BINS / 2) * JITTER_BIN_MS,
+              (unsigned)record.bins[i]);
+    }
+  }
+
+  DataLoggingSessionRef session = data_logging_create(JITTER_LOG_TAG, DATA_LOGGING_BYTE_ARRAY, sizeof(record), false);
+  if (session) {
+    data_logging_log(session, &record, 1);
+    data_logging_finish(session);
+  }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+/*
+	Histogram of the time between accelerometer samples.
+
+	jitter_add() takes every sample the app gets, with its
+	AccelData.timestamp, and bins how far each interval is from
+	the period of the rate the samples were asked at: JITTER_BINS
+	bins of JITTER_BIN_MS, centred on 0 (on time), the first and
+	last ones catching everything earlier or later. Count, min,
+	max, mean and RMS of the error are kept next to the bins.
+
+	jitter_restart() starts a new chain of intervals, when the
+	rate changes or samples were skipped, so no interval spans a
+	gap. Samples without a timestamp (0) are not counted.
+
+	jitter_dump() writes the histogram to the console and, as one
+	JitterRecord, to the JITTER_LOG_TAG data logging tag.
+*/
+
+#include <pebble.h>
+
+#define JITTER_LOG_TAG 0x6a		// 'j'
+#define JITTER_BINS 16
+#define JITTER_BIN_MS 4			// Bins cover -32 .. +32 ms from the period
+
+typedef struct {
+  uint32_t bins[JITTER_BINS];
+  uint32_t count;			// Intervals binned
+  int32_t min_ms;			// Error from the period, negative when early
+  int32_t max_ms;
+  int64_t sum_ms;
+  uint64_t sum_squares;
+
+  uint64_t last_ms;			// Timestamp of the previous sample, 0 = none
+} JitterHistogram;
+
+// What the phone receives
+typedef struct __attribute__((__packed__)) {
+  uint32_t count;
+  int16_t min_ms;
+  int16_t max_ms;
+  int16_t mean_us;			// Mean error, in microseconds
+  uint16_t rms_us;
+  uint32_t bins[JITTER_BINS];
+} JitterRecord;
+
+void jitter_init(JitterHistogram *hist);
+void jitter_restart(JitterHistogram *hist);
+void jitter_add(JitterHistogram *hist, const AccelData *data, uint32_t num_samples, uint16_t rate_hz);
+void jitter_record(const JitterHistogram *hist, JitterRecord *record);
+void jitter_dump(const JitterHistogram *hist);
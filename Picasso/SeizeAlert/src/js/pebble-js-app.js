@@ -0,0 +1,87 @@
+/*
+ * SeizeAlert phone side: detection profiles (see src/detector_profile.h).
+ *
+ * The night profile is sent to its slot on the watch only when the watch
+ * is not known to have it: the first time, when NIGHT_PROFILE changed
+ * since, or when the watch finds the slot empty on a switch to it (the
+ * app was reinstalled). Every store is a persist write on the watch, so a
+ * plain launch sends nothing. The settings button in the Pebble app
+ * switches between the standard and the night profile; the watch keeps
+ * the active one across restarts, and the phone what it last reported.
+ */
+
+var STANDARD_SLOT = 0;
+var NIGHT_SLOT = 1;
+
+// Wider free fall band, weaker impact, longer countdown, 50 Hz all night
+var NIGHT_PROFILE = {
+  'profile_slot': NIGHT_SLOT,
+  'profile_name': 'night',
+  'step_one_lower_bound': 700,
+  'step_one_samples': 3,
+  'step_two_lower_bound': 400,
+  'step_three_higher_bound': 150,
+  'alert_window': 20,
+  'sampling_rate': 50
+};
+
+var RESULTS = ['ok', 'bad slot', 'read only', 'bad bounds', 'bad samples',
+               'bad alert window', 'bad rate', 'empty slot', 'storage full'];
+var RESULT_OK = 0;
+var RESULT_EMPTY = 7;
+
+// localStorage keys: the night profile the watch has, the slot it said was active
+var STORED_KEY = 'night_profile';
+var ACTIVE_KEY = 'active_slot';
+
+var nightProfile = JSON.stringify(NIGHT_PROFILE);
+var activeSlot = parseInt(localStorage.getItem(ACTIVE_KEY) || STANDARD_SLOT, 10);
+var sent = null;			// The message waiting for its reply
+
+function send(message) {
+  sent = message;
+  Pebble.sendAppMessage(message, null, function(e) {
+    sent = null;
+    console.log('SeizeAlert: profile message not delivered: ' + JSON.stringify(e.error));
+  });
+}
+
+function sendNightProfile(activate) {
+  var message = JSON.parse(nightProfile);
+  if (activate !== undefined) {
+    message.activate = activate;
+  }
+  send(message);
+}
+
+Pebble.addEventListener('ready', function() {
+  if (localStorage.getItem(STORED_KEY) !== nightProfile) {
+    sendNightProfile();
+  }
+});
+
+Pebble.addEventListener('showConfiguration', function() {
+  send({ 'activate': (activeSlot === NIGHT_SLOT) ? STANDARD_SLOT : NIGHT_SLOT });
+});
+
+// Every message gets a reply: the result and the active slot
+Pebble.addEventListener('appmessage', function(e) {
+  var result = e.payload.result;
+  var message = sent;
+  sent = null;
+  if (e.payload.activate !== undefined) {
+    activeSlot = e.payload.activate;
+    localStorage.setItem(ACTIVE_KEY, activeSlot);
+  }
+  if (!message) {
+    return;
+  }
+  if ((result === RESULT_OK) && (message.profile_slot === NIGHT_SLOT)) {
+    localStorage.setItem(STORED_KEY, nightProfile);
+  } else if ((result === RESULT_EMPTY) && (message.activate === NIGHT_SLOT) && (message.profile_slot === undefined)) {
+    localStorage.removeItem(STORED_KEY);
+    sendNightProfile(NIGHT_SLOT);
+  } else if (result !== RESULT_OK) {
+    console.log('SeizeAlert: profile refused: ' + (RESULTS[result] || result));
+  }
+});
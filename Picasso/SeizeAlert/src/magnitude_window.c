@@ -0,0 +1,84 @@
+#include <pebble.h>
+#include <magnitude_window.h>
+#include <accel_magnitude.h>
+
+
+static void evict_oldest(MagnitudeWindow *win) {
+  uint8_t oldest = win->next - win->count;
+  window_deque_expire(&win->min, oldest);
+  window_deque_expire(&win->max, oldest);
+  win->count--;
+}
+
+
+
+static uint16_t clamp_length(uint16_t length) {
+  if (length == 0) {
+    return 1;
+  }
+  return (length < MAGNITUDE_WINDOW_SIZE) ? length : MAGNITUDE_WINDOW_SIZE;
+}
+
+
+
+void magnitude_window_init(MagnitudeWindow *win, uint16_t length) {
+  memset(win, 0, sizeof(*win));
+  win->length = clamp_length(length);
+}
+
+
+
+/*
+	Changes the window length, keeping the samples:
+	a shorter window drops its oldest ones, a longer
+	one fills up as samples come.
+*/
+void magnitude_window_set_length(MagnitudeWindow *win, uint16_t length) {
+  win->length = clamp_length(length);
+  while (win->count > win->length) {
+    evict_oldest(win);
+  }
+}
+
+
+
+void magnitude_window_push(MagnitudeWindow *win, const AccelData *sample) {
+  if (win->count == win->length) {
+    evict_oldest(win);
+  }
+
+  uint8_t pos = win->next;
+  uint32_t m2 = ACCEL_MAGNITUDE_SQUARED(sample->x, sample->y, sample->z);
+  win->m2[pos] = (m2 > INT32_MAX) ? INT32_MAX : (int32_t)m2;	// Only clips past ~46 g
+  WINDOW_DEQUE_PUSH(&win->min, win->m2, pos, <);
+  WINDOW_DEQUE_PUSH(&win->max, win->m2, pos, >);
+
+  win->next++;
+  win->count++;
+}
+
+
+
+int32_t magnitude_window_newest(const MagnitudeWindow *win) {
+  return win->count ? win->m2[(uint8_t)(win->next - 1)] : 0;
+}
+
+
+
+/*
+	Min and max over the newest `last` samples
+	(clamped to the window). Returns false if the
+	window is empty.
+*/
+bool magnitude_window_range(const MagnitudeWindow *win, uint16_t last, int32_t *min, int32_t *max) {
+  if (win->count == 0) {
+    return false;
+  }
+  if ((last == 0) || (last > win->count)) {
+    last = win->count;
+  }
+  uint8_t newest = win->next - 1;
+  *min = win->m2[window_deque_suffix_front(&win->min, newest, last)];
+  *max = win->m2[window_deque_suffix_front(&win->max, newest, last)];
+  return true;
+}
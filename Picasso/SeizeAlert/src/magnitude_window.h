@@ -0,0 +1,34 @@
+#pragma once
+
+/*
+	Sliding-window min / max of the squared magnitude
+	x^2 + y^2 + z^2, all the fall detector reads from its
+	recent samples (detector.h, rate_controller.c).
+
+	Keeps the last `length` squared magnitudes (up to
+	MAGNITUDE_WINDOW_SIZE) with a min and a max monotonic
+	deque, for 1.5 KB of RAM. The per-axis features (mean,
+	variance, SMA, jerk) are in accel_window.h, for callers
+	that want them.
+*/
+
+#include <pebble.h>
+#include <window_deque.h>
+
+#define MAGNITUDE_WINDOW_SIZE WINDOW_DEQUE_SIZE
+
+typedef struct {
+  int32_t m2[MAGNITUDE_WINDOW_SIZE];
+  uint16_t length;		// Window length in samples
+  uint16_t count;		// Samples currently in the window
+  uint8_t next;			// Ring position of the next sample
+  WindowDeque min;
+  WindowDeque max;
+} MagnitudeWindow;
+
+void magnitude_window_init(MagnitudeWindow *win, uint16_t length);
+void magnitude_window_set_length(MagnitudeWindow *win, uint16_t length);
+void magnitude_window_push(MagnitudeWindow *win, const AccelData *sample);
+
+int32_t magnitude_window_newest(const MagnitudeWindow *win);
+bool magnitude_window_range(const MagnitudeWindow *win, uint16_t last, int32_t *min, int32_t *max);
@@ -0,0 +1,66 @@
+#include <pebble.h>
+#include <posture.h>
+#include <int_sqrt.h>
+
+
+void posture_init(Posture *posture, uint16_t rate_hz) {
+  memset(posture, 0, sizeof(*posture));
+  posture_set_rate(posture, rate_hz);
+}
+
+
+
+/*
+	Smallest shift whose time constant, 2^shift
+	samples, reaches POSTURE_TAU_MS at rate_hz.
+*/
+void posture_set_rate(Posture *posture, uint16_t rate_hz) {
+  uint8_t shift = 0;
+  while ((shift < 15) && ((((uint32_t)1 << shift) * 1000) < (uint32_t)POSTURE_TAU_MS * rate_hz)) {
+    shift++;
+  }
+  posture->shift = shift;
+}
+
+
+
+void posture_mark(Posture *posture) {
+  memcpy(posture->reference, posture->gravity, sizeof(posture->reference));
+}
+
+
+
+/*
+	cos of the angle from the dot product, then the
+	angle by bisection over cos_lookup(), which falls
+	from 0 to TRIG_MAX_ANGLE / 2. 0 until there is
+	a reference and a gravity vector.
+*/
+int32_t posture_tilt(const Posture *posture) {
+  int64_t dot = 0, reference = 0, gravity = 0;
+  for (int i = 0; i < 3; i++) {
+    int32_t r = posture->reference[i] >> POSTURE_FRACTION_BITS;
+    int32_t g = posture->gravity[i] >> POSTURE_FRACTION_BITS;
+    dot += (int64_t)r * g;
+    reference += (int64_t)r * r;
+    gravity += (int64_t)g * g;
+  }
+  uint32_t norm = int_sqrt((uint64_t)reference * (uint64_t)gravity);
+  if (norm == 0) {
+    return 0;
+  }
+  int64_t cosine = (dot * TRIG_MAX_RATIO) / norm;
+  cosine = (cosine > TRIG_MAX_RATIO) ? TRIG_MAX_RATIO : ((cosine < -TRIG_MAX_RATIO) ? -TRIG_MAX_RATIO : cosine);
+
+  int32_t low = 0;
+  int32_t high = TRIG_MAX_ANGLE / 2;
+  while (low < high) {
+    int32_t middle = (low + high) / 2;
+    if (cos_lookup(middle) > cosine) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
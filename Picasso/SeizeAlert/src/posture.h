@@ -0,0 +1,49 @@
+#pragma once
+
+/*
+	Posture of the wrist, to confirm a fall with.
+
+	posture_add() runs each axis through an integer first order
+	low-pass (g += (a - g) >> shift, in 1/2^POSTURE_FRACTION_BITS
+	mg), which keeps gravity and leaves out motion; the shift is
+	picked per rate so the time constant stays about
+	POSTURE_TAU_MS. posture_mark() keeps the gravity vector as it
+	is as the reference, the posture before an event, and
+	posture_tilt() gives the angle between the reference and
+	gravity now, 0 to TRIG_MAX_ANGLE / 2, from cos_lookup() and
+	an integer square root: no libm or float.
+
+	Someone who fell does not lie the way they stood; a watch
+	taken off and set down on a table mostly does.
+*/
+
+#include <pebble.h>
+
+#define POSTURE_FRACTION_BITS 4
+#define POSTURE_TAU_MS 320
+
+typedef struct {
+  int32_t gravity[3];			// mg << POSTURE_FRACTION_BITS
+  int32_t reference[3];			// Gravity at posture_mark()
+  uint8_t shift;
+  bool primed;				// gravity starts at the first sample
+} Posture;
+
+void posture_init(Posture *posture, uint16_t rate_hz);
+void posture_set_rate(Posture *posture, uint16_t rate_hz);
+void posture_mark(Posture *posture);
+int32_t posture_tilt(const Posture *posture);
+
+// One sample in, on the per-sample path
+static inline void posture_add(Posture *posture, const AccelData *sample) {
+  int32_t axes[3] = { sample->x, sample->y, sample->z };
+  for (int i = 0; i < 3; i++) {
+    int32_t value = axes[i] * (1 << POSTURE_FRACTION_BITS);
+    if (posture->primed) {
+      posture->gravity[i] += (value - posture->gravity[i]) >> posture->shift;
+    } else {
+      posture->gravity[i] = value;
+    }
+  }
+  posture->primed = true;
+}
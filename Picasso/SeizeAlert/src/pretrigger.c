@@ -0,0 +1,55 @@
+#include <pebble.h>
+#include <pretrigger.h>
+
+
+void pretrigger_init(Pretrigger *ring, uint16_t movement_mg, uint16_t rate_hz) {
+  memset(ring, 0, sizeof(*ring));
+  ring->period_ms = 1000 / rate_hz;
+  ring->edges = accel_deviation_edges(movement_mg);
+}
+
+
+
+/*
+	Keeps the samples, overwriting the oldest once
+	full. Returns true if any of them moved.
+*/
+bool pretrigger_push(Pretrigger *ring, const AccelData *data, uint32_t num_samples) {
+  bool moved = false;
+  for (uint32_t i = 0; i < num_samples; i++) {
+    const AccelData *sample = &data[i];
+    moved |= accel_deviation_at_least(ACCEL_MAGNITUDE_SQUARED(sample->x, sample->y, sample->z), ring->edges);
+
+    ring->axes[0][ring->next] = sample->x;
+    ring->axes[1][ring->next] = sample->y;
+    ring->axes[2][ring->next] = sample->z;
+    ring->next = (ring->next + 1 == PRETRIGGER_SAMPLES) ? 0 : (ring->next + 1);
+    if (ring->count < PRETRIGGER_SAMPLES) {
+      ring->count++;
+    }
+  }
+  if (num_samples > 0) {
+    ring->newest_ms = data[num_samples - 1].timestamp;
+  }
+  return moved;
+}
+
+
+
+/*
+	Moves up to max_samples of the oldest samples to
+	out, timestamped back from the newest one. Returns
+	how many; 0 once the ring is empty.
+*/
+uint32_t pretrigger_drain(Pretrigger *ring, AccelData *out, uint32_t max_samples) {
+  uint32_t count = (ring->count < max_samples) ? ring->count : max_samples;
+  uint32_t oldest = (ring->next + PRETRIGGER_SAMPLES - ring->count) % PRETRIGGER_SAMPLES;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t j = (oldest + i) % PRETRIGGER_SAMPLES;
+    uint64_t age_ms = (uint64_t)(ring->count - 1 - i) * ring->period_ms;
+    out[i] = (AccelData) { .x = ring->axes[0][j], .y = ring->axes[1][j], .z = ring->axes[2][j],
+                           .timestamp = (ring->newest_ms > age_ms) ? (ring->newest_ms - age_ms) : 0 };
+  }
+  ring->count -= count;
+  return count;
+}
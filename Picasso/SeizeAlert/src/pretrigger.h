@@ -0,0 +1,33 @@
+#pragma once
+
+/*
+	Pre-trigger ring of accelerometer samples.
+
+	While SeizeAlert waits for a tap or an impact, batches are
+	only copied here (x, y and z, 6 bytes a sample) and checked
+	for movement; nothing is analysed. When analysis wakes up,
+	pretrigger_drain() hands back the last PRETRIGGER_SAMPLES
+	samples, oldest first, so the fall detector starts from what
+	happened before the trigger instead of from the trigger.
+
+	Only the newest sample's timestamp is kept: the ring fills
+	at one rate, so the others are that many periods older.
+*/
+
+#include <pebble.h>
+#include <accel_magnitude.h>
+
+#define PRETRIGGER_SAMPLES 50		// 5 s at 10 Hz, two full wake batches
+
+typedef struct {
+  int16_t axes[3][PRETRIGGER_SAMPLES];
+  uint8_t next;			// Index the next sample goes to
+  uint8_t count;
+  uint64_t newest_ms;		// Timestamp of the newest sample
+  uint16_t period_ms;		// Between two samples, at the rate the ring fills at
+  AccelDeviationEdges edges;	// Movement: any deviation from 1 g past these
+} Pretrigger;
+
+void pretrigger_init(Pretrigger *ring, uint16_t movement_mg, uint16_t rate_hz);
+bool pretrigger_push(Pretrigger *ring, const AccelData *data, uint32_t num_samples);
+uint32_t pretrigger_drain(Pretrigger *ring, AccelData *out, uint32_t max_samples);
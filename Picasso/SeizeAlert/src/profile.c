@@ -0,0 +1,142 @@
+#include <pebble.h>
+#include <profile.h>
+
+#ifdef PROFILE
+
+#ifdef PROFILE_CLOCK_GETTIME
+#include <time.h>
+#endif
+
+static ProfileStats s_stats[PROFILE_SLOTS];
+
+static const char *const PROFILE_NAMES[PROFILE_SLOTS] = {
+  "accel", "tap", "timer", "countdown", "minute_tick", "battery", "bluetooth", "message",
+};
+
+
+static uint64_t watch_ms(void) {
+  time_t seconds;
+  uint16_t ms;
+  time_ms(&seconds, &ms);
+  return ((uint64_t)seconds * 1000) + ms;
+}
+
+
+
+static uint64_t clock_us(void) {
+#ifdef PROFILE_CLOCK_GETTIME
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000) + (uint64_t)(ts.tv_nsec / 1000);
+#else
+  return watch_ms() * 1000;
+#endif
+}
+
+
+
+/*
+	Counts the call and how late it is, if it was
+	due. Returns the start time for profile_end().
+*/
+uint64_t profile_begin(ProfileSlot slot) {
+  ProfileStats *stats = &s_stats[slot];
+  if (stats->due_ms) {
+    int32_t late_ms = (int32_t)((int64_t)watch_ms() - (int64_t)stats->due_ms);
+    if ((stats->expected_calls == 0) || (late_ms < stats->min_late_ms)) {
+      stats->min_late_ms = late_ms;
+    }
+    if ((stats->expected_calls == 0) || (late_ms > stats->max_late_ms)) {
+      stats->max_late_ms = late_ms;
+    }
+    stats->total_late_ms += late_ms;
+    stats->expected_calls++;
+    stats->due_ms = 0;
+  }
+  return clock_us();
+}
+
+
+
+void profile_end(ProfileSlot slot, uint64_t start_us) {
+  ProfileStats *stats = &s_stats[slot];
+  uint32_t us = (uint32_t)(clock_us() - start_us);
+  if ((stats->calls == 0) || (us < stats->min_us)) {
+    stats->min_us = us;
+  }
+  if (us > stats->max_us) {
+    stats->max_us = us;
+  }
+  stats->total_us += us;
+  stats->calls++;
+}
+
+
+
+void profile_expect(ProfileSlot slot, uint32_t delay_ms) {
+  s_stats[slot].due_ms = watch_ms() + delay_ms;
+}
+
+
+
+void profile_expect_aligned(ProfileSlot slot, uint32_t period_ms) {
+  s_stats[slot].due_ms = ((watch_ms() / period_ms) + 1) * period_ms;
+}
+
+
+
+const ProfileStats *profile_stats(ProfileSlot slot) {
+  return &s_stats[slot];
+}
+
+
+
+const char *profile_name(ProfileSlot slot) {
+  return PROFILE_NAMES[slot];
+}
+
+
+
+static int16_t clamp_ms(int64_t ms) {
+  return (ms > INT16_MAX) ? INT16_MAX : ((ms < INT16_MIN) ? INT16_MIN : (int16_t)ms);
+}
+
+
+
+/*
+	Console lines and one record per slot that has
+	been called, in a session of its own.
+*/
+void profile_dump(void) {
+  ProfileRecord records[PROFILE_SLOTS];
+  uint32_t num_records = 0;
+
+  for (int slot = 0; slot < PROFILE_SLOTS; slot++) {
+    const ProfileStats *stats = &s_stats[slot];
+    if (stats->calls == 0) {
+      continue;
+    }
+    ProfileRecord *record = &records[num_records++];
+    record->slot = slot;
+    record->calls = stats->calls;
+    record->min_us = stats->min_us;
+    record->avg_us = (uint32_t)(stats->total_us / stats->calls);
+    record->max_us = stats->max_us;
+    record->avg_late_ms = stats->expected_calls ? clamp_ms(stats->total_late_ms / stats->expected_calls) : 0;
+    record->max_late_ms = stats->expected_calls ? clamp_ms(stats->max_late_ms) : 0;
+    APP_LOG(APP_LOG_LEVEL_INFO, "%s: %u calls, %u/%u/%u us min/avg/max, late %d ms avg %d ms max",
+            PROFILE_NAMES[slot], (unsigned)record->calls, (unsigned)record->min_us, (unsigned)record->avg_us,
+            (unsigned)record->max_us, record->avg_late_ms, record->max_late_ms);
+  }
+
+  if (num_records > 0) {
+    DataLoggingSessionRef session = data_logging_create(PROFILE_LOG_TAG, DATA_LOGGING_BYTE_ARRAY,
+                                                        sizeof(ProfileRecord), false);
+    if (session) {
+      data_logging_log(session, records, num_records);
+      data_logging_finish(session);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,91 @@
+#pragma once
+
+/*
+	Callback profiling, compiled out unless PROFILE is defined.
+
+	PROFILE_BEGIN(slot) / PROFILE_END(slot) around a callback body
+	count the call and its duration into a fixed table, one
+	ProfileStats per ProfileSlot. PROFILE_EXPECT(slot, delay_ms),
+	where the callback is scheduled, and PROFILE_EXPECT_ALIGNED(slot,
+	period_ms), for wakeups on multiples of the period (the minute
+	tick), set when the next call is due; the next PROFILE_BEGIN
+	records how late it came.
+
+	Durations are read from clock_gettime() when the host build
+	defines PROFILE_CLOCK_GETTIME, and from time_ms() on the watch,
+	whose millisecond ticks leave most short callbacks at 0 us:
+	there, read the call counts and the averages of long runs.
+	Lateness is always watch (time_ms()) time.
+
+	PROFILE_DUMP() writes the table to the console and, one
+	ProfileRecord per slot, to the PROFILE_LOG_TAG data logging tag.
+
+	With PROFILE undefined every macro is an empty statement and
+	none of this is compiled.
+*/
+
+#include <pebble.h>
+
+#define PROFILE_LOG_TAG 0x70		// 'p'
+
+typedef enum {
+  PROFILE_ACCEL = 0,		// accel_data_handler
+  PROFILE_TAP,			// accel_tap_handler
+  PROFILE_TIMER,		// timer_callback (peek polling)
+  PROFILE_COUNTDOWN,		// countdown_callback
+  PROFILE_MINUTE_TICK,		// handle_minute_tick
+  PROFILE_BATTERY,		// battery_state_handler
+  PROFILE_BLUETOOTH,		// bluetooth_state_handler
+  PROFILE_MESSAGE,		// inbox_received_handler
+  PROFILE_SLOTS,
+} ProfileSlot;
+
+typedef struct {
+  uint32_t calls;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint64_t total_us;
+
+  uint32_t expected_calls;	// Calls that had a due time
+  int32_t min_late_ms;		// Negative when early
+  int32_t max_late_ms;
+  int64_t total_late_ms;
+  uint64_t due_ms;		// Watch time the next call is due, 0 = none
+} ProfileStats;
+
+// What the phone receives for each slot
+typedef struct __attribute__((__packed__)) {
+  uint8_t slot;			// ProfileSlot
+  uint32_t calls;
+  uint32_t min_us;
+  uint32_t avg_us;
+  uint32_t max_us;
+  int16_t avg_late_ms;
+  int16_t max_late_ms;
+} ProfileRecord;
+
+#ifdef PROFILE
+
+uint64_t profile_begin(ProfileSlot slot);
+void profile_end(ProfileSlot slot, uint64_t start_us);
+void profile_expect(ProfileSlot slot, uint32_t delay_ms);
+void profile_expect_aligned(ProfileSlot slot, uint32_t period_ms);
+void profile_dump(void);
+const ProfileStats *profile_stats(ProfileSlot slot);
+const char *profile_name(ProfileSlot slot);
+
+#define PROFILE_BEGIN(slot) uint64_t profile_start_us_ = profile_begin(slot)
+#define PROFILE_END(slot) profile_end((slot), profile_start_us_)
+#define PROFILE_EXPECT(slot, delay_ms) profile_expect((slot), (delay_ms))
+#define PROFILE_EXPECT_ALIGNED(slot, period_ms) profile_expect_aligned((slot), (period_ms))
+#define PROFILE_DUMP() profile_dump()
+
+#else
+
+#define PROFILE_BEGIN(slot) do { } while (0)
+#define PROFILE_END(slot) do { } while (0)
+#define PROFILE_EXPECT(slot, delay_ms) do { } while (0)
+#define PROFILE_EXPECT_ALIGNED(slot, period_ms) do { } while (0)
+#define PROFILE_DUMP() do { } while (0)
+
+#endif
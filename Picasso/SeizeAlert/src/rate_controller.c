@@ -0,0 +1,75 @@
+#include <pebble.h>
+#include <rate_controller.h>
+
+
+void rate_controller_init(RateController *rc, AccelSamplingRate rate) {
+  memset(rc, 0, sizeof(*rc));
+  rc->rate = rate;
+  rc->active_edges = accel_deviation_edges(RATE_ACTIVE_MG);
+}
+
+
+
+/*
+	True if any of the newest num_samples samples of
+	the detector's window moved.
+*/
+static bool moved(const RateController *rc, const Detector *det, uint32_t num_samples) {
+  int32_t min, max;
+  uint16_t last = (num_samples < det->window.length) ? num_samples : det->window.length;
+  if (!magnitude_window_range(&det->window, last, &min, &max)) {
+    return false;
+  }
+  return accel_deviation_at_least((uint32_t)min, rc->active_edges) ||
+         accel_deviation_at_least((uint32_t)max, rc->active_edges);
+}
+
+
+
+/*
+	Picks the rate for the next batch, after the
+	detector was fed num_samples at rc->rate and
+	reported a candidate or not. Returns true when
+	the rate changed.
+*/
+bool rate_controller_update(RateController *rc, const Detector *det, uint32_t num_samples, bool candidate) {
+  AccelSamplingRate rate = rc->rate;
+
+  if (candidate || (det->state != DETECTOR_IDLE)) {
+    rc->quiet_ms = 0;
+    rate = (rate > RATE_FALL_HZ) ? rate : RATE_FALL_HZ;
+  } else if (moved(rc, det, num_samples)) {
+    rc->quiet_ms = 0;
+    rate = RATE_ACTIVE_HZ;
+  } else {
+    rc->quiet_ms += (num_samples * 1000) / rc->rate;
+    if (rc->quiet_ms >= RATE_QUIET_MS) {
+      rate = RATE_REST_HZ;
+    } else if (rate > RATE_ACTIVE_HZ) {
+      rate = RATE_ACTIVE_HZ;
+    }
+  }
+
+  if (rate == rc->rate) {
+    return false;
+  }
+  rc->rate = rate;
+  rc->changes++;
+  return true;
+}
+
+
+
+/*
+	Something woke analysis up: at least
+	RATE_ACTIVE_HZ, RATE_FALL_HZ for a fall
+	in progress.
+*/
+void rate_controller_wake(RateController *rc, const Detector *det, bool candidate) {
+  AccelSamplingRate rate = (candidate || (det->state != DETECTOR_IDLE)) ? RATE_FALL_HZ : RATE_ACTIVE_HZ;
+  rc->quiet_ms = 0;
+  if (rate > rc->rate) {
+    rc->rate = rate;
+    rc->changes++;
+  }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+/*
+	Adaptive accelerometer sampling rate for SeizeAlert.
+
+	After every batch the controller picks the rate for the next
+	one from what the fall detector saw:
+
+	  - a step one candidate (free fall band), or the FSM past
+	    idle: RATE_FALL_HZ, until the FSM is back to idle
+	  - movement, any deviation from 1 g of RATE_ACTIVE_MG or more
+	    in the batch: at least RATE_ACTIVE_HZ
+	  - RATE_QUIET_MS without movement: RATE_REST_HZ
+
+	The rest rate only has to catch the start of a fall: the
+	detector's steps are timed from the sample timestamps,
+	whatever rate the samples come at, and the first
+	candidate steps the rate up for the rest of the fall.
+
+	When the app stops analysing at the rest rate (tap wake, see
+	SeizeAlert.c), rate_controller_wake() brings the rate back up
+	for whatever woke it.
+*/
+
+#include <pebble.h>
+#include <detector.h>
+
+#define RATE_REST_HZ ACCEL_SAMPLING_10HZ
+#define RATE_ACTIVE_HZ ACCEL_SAMPLING_25HZ
+#define RATE_FALL_HZ ACCEL_SAMPLING_50HZ
+#define RATE_ACTIVE_MG 150		// Deviation from 1 g that counts as movement
+#define RATE_QUIET_MS (10 * 1000)	// Still for this long drops to RATE_REST_HZ
+
+typedef struct {
+  AccelSamplingRate rate;	// Rate of the samples being fed
+  uint32_t quiet_ms;		// Time since the last movement
+  AccelDeviationEdges active_edges;
+
+  uint32_t changes;		// Rate changes since init
+} RateController;
+
+void rate_controller_init(RateController *rc, AccelSamplingRate rate);
+bool rate_controller_update(RateController *rc, const Detector *det, uint32_t num_samples, bool candidate);
+void rate_controller_wake(RateController *rc, const Detector *det, bool candidate);
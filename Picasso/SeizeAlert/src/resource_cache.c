@@ -0,0 +1,69 @@
+#include <pebble.h>
+#include <resource_cache.h>
+
+typedef struct {
+  uint32_t resource_id;
+  GFont font;
+} CachedFont;
+
+typedef struct {
+  uint32_t resource_id;
+  GBitmap *bitmap;
+} CachedBitmap;
+
+static CachedFont s_fonts[RESOURCE_CACHE_MAX_FONTS];
+static uint8_t s_num_fonts;
+static CachedBitmap s_bitmaps[RESOURCE_CACHE_MAX_BITMAPS];
+static uint8_t s_num_bitmaps;
+
+
+/*
+	A full cache still loads the font, but cannot free
+	it: raise RESOURCE_CACHE_MAX_FONTS instead.
+*/
+GFont resource_cache_font(uint32_t resource_id) {
+  for (uint8_t i = 0; i < s_num_fonts; i++) {
+    if (s_fonts[i].resource_id == resource_id) {
+      return s_fonts[i].font;
+    }
+  }
+
+  GFont font = fonts_load_custom_font(resource_get_handle(resource_id));
+  if (s_num_fonts < RESOURCE_CACHE_MAX_FONTS) {
+    s_fonts[s_num_fonts++] = (CachedFont) { .resource_id = resource_id, .font = font };
+  } else {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Font cache full, font %lu not cached", (unsigned long)resource_id);
+  }
+  return font;
+}
+
+
+
+GBitmap *resource_cache_bitmap(uint32_t resource_id) {
+  for (uint8_t i = 0; i < s_num_bitmaps; i++) {
+    if (s_bitmaps[i].resource_id == resource_id) {
+      return s_bitmaps[i].bitmap;
+    }
+  }
+
+  GBitmap *bitmap = gbitmap_create_with_resource(resource_id);
+  if (s_num_bitmaps < RESOURCE_CACHE_MAX_BITMAPS) {
+    s_bitmaps[s_num_bitmaps++] = (CachedBitmap) { .resource_id = resource_id, .bitmap = bitmap };
+  } else {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Bitmap cache full, bitmap %lu not cached", (unsigned long)resource_id);
+  }
+  return bitmap;
+}
+
+
+
+void resource_cache_release_all(void) {
+  for (uint8_t i = 0; i < s_num_fonts; i++) {
+    fonts_unload_custom_font(s_fonts[i].font);
+  }
+  for (uint8_t i = 0; i < s_num_bitmaps; i++) {
+    gbitmap_destroy(s_bitmaps[i].bitmap);
+  }
+  s_num_fonts = 0;
+  s_num_bitmaps = 0;
+}
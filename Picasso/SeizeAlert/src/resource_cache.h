@@ -0,0 +1,20 @@
+#pragma once
+
+/*
+	Loads each custom font and bitmap resource once.
+
+	The first resource_cache_font() / resource_cache_bitmap() of a
+	resource loads it; later calls return the same handle, found in
+	a short table, so switching screens costs no load and no heap.
+	Everything is freed by resource_cache_release_all(), from
+	window_unload. Handles must not be destroyed by their users.
+*/
+
+#include <pebble.h>
+
+#define RESOURCE_CACHE_MAX_FONTS 4
+#define RESOURCE_CACHE_MAX_BITMAPS 6
+
+GFont resource_cache_font(uint32_t resource_id);
+GBitmap *resource_cache_bitmap(uint32_t resource_id);
+void resource_cache_release_all(void);
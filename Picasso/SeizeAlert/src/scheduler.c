@@ -0,0 +1,319 @@
+#include <pebble.h>
+#include <scheduler.h>
+
+#define SCHEDULER_SPAN_MS (SCHEDULER_SLOTS * SCHEDULER_TICK_MS)
+#define SCHEDULER_WORDS (SCHEDULER_SLOTS / 32)
+
+static void arm(Scheduler *sched);
+
+
+
+// The watch's wall clock, low 32 bits of ms
+static uint32_t wall_clock_ms(void) {
+  time_t seconds;
+  uint16_t ms;
+  time_ms(&seconds, &ms);
+  return (uint32_t)(((uint64_t)seconds * 1000) + ms);
+}
+
+
+
+// Signed, so deadlines compare across the clock wrapping
+static int32_t ms_until(uint32_t ms, uint32_t now_ms) {
+  return (int32_t)(ms - now_ms);
+}
+
+
+
+/*
+	The scheduler's clock follows the wall clock
+	but never goes back, and while the timer is
+	armed never goes further than its deadline
+	(plus SCHEDULER_MAX_LATE_MS): it would have
+	fired by then. Setting the watch's time (a sync
+	with the phone, a time zone, DST) neither
+	stalls the tasks nor runs them early.
+*/
+static uint32_t clock_ms(Scheduler *sched) {
+  uint32_t wall_ms = wall_clock_ms();
+  int32_t step_ms = (int32_t)(wall_ms - sched->wall_ms);
+  sched->wall_ms = wall_ms;
+  if (step_ms <= 0) {
+    return sched->now_ms;
+  }
+  if (sched->timer) {
+    int32_t max_ms = ms_until(sched->timer_ms, sched->now_ms) + SCHEDULER_MAX_LATE_MS;
+    max_ms = (max_ms > 0) ? max_ms : 0;
+    step_ms = (step_ms < max_ms) ? step_ms : max_ms;
+  }
+  sched->now_ms += step_ms;
+  return sched->now_ms;
+}
+
+
+
+static uint32_t deadline_ms(const SchedulerTask *task) {
+  return task->due_ms + task->slack_ms;
+}
+
+
+
+static uint8_t slot_of(uint32_t ms) {
+  return (ms / SCHEDULER_TICK_MS) % SCHEDULER_SLOTS;
+}
+
+
+
+void scheduler_init(Scheduler *sched) {
+  memset(sched, 0, sizeof(*sched));
+  memset(sched->slots, SCHEDULER_NONE, sizeof(sched->slots));
+  sched->wall_ms = wall_clock_ms();
+}
+
+
+
+void scheduler_deinit(Scheduler *sched) {
+  if (sched->timer) {
+    app_timer_cancel(sched->timer);
+    sched->timer = NULL;
+  }
+  for (uint8_t task = 0; task < SCHEDULER_TASKS; task++) {
+    sched->tasks[task].set = false;
+  }
+  memset(sched->slots, SCHEDULER_NONE, sizeof(sched->slots));
+  memset(sched->occupied, 0, sizeof(sched->occupied));
+}
+
+
+
+static void file_task(Scheduler *sched, uint8_t task) {
+  uint8_t slot = slot_of(deadline_ms(&sched->tasks[task]));
+  sched->tasks[task].next = sched->slots[slot];
+  sched->slots[slot] = task;
+  sched->occupied[slot / 32] |= 1u << (slot % 32);
+}
+
+
+
+static void unfile_task(Scheduler *sched, uint8_t task) {
+  uint8_t slot = slot_of(deadline_ms(&sched->tasks[task]));
+  uint8_t *at = &sched->slots[slot];
+  while ((*at != SCHEDULER_NONE) && (*at != task)) {
+    at = &sched->tasks[*at].next;
+  }
+  if (*at == task) {
+    *at = sched->tasks[task].next;
+  }
+  if (sched->slots[slot] == SCHEDULER_NONE) {
+    sched->occupied[slot / 32] &= ~(1u << (slot % 32));
+  }
+}
+
+
+
+// First slot from `from` on holding a task, -1 if none
+static int first_occupied(const Scheduler *sched, int from) {
+  for (int word = from / 32; word < SCHEDULER_WORDS; word++) {
+    uint32_t bits = sched->occupied[word];
+    if (word == from / 32) {
+      bits &= ~0u << (from % 32);
+    }
+    if (bits) {
+      return (word * 32) + __builtin_ctz(bits);
+    }
+  }
+  return -1;
+}
+
+
+
+/*
+	Sets a task to run delay_ms from now, then every
+	period_ms if it is not 0, up to slack_ms late
+	to share a wakeup. A task that was set is moved.
+*/
+void scheduler_set(Scheduler *sched, uint8_t task, uint32_t delay_ms, uint32_t period_ms, uint16_t slack_ms,
+                   SchedulerCallback callback, void *data) {
+  if (task >= SCHEDULER_TASKS) {
+    return;
+  }
+  SchedulerTask *entry = &sched->tasks[task];
+  if (entry->set) {
+    unfile_task(sched, task);
+  }
+  entry->callback = callback;
+  entry->data = data;
+  entry->due_ms = clock_ms(sched) + delay_ms;
+  entry->period_ms = period_ms;
+  entry->slack_ms = (slack_ms < SCHEDULER_MAX_SLACK_MS) ? slack_ms : SCHEDULER_MAX_SLACK_MS;
+  entry->set = true;
+  file_task(sched, task);
+  if (!sched->running) {
+    arm(sched);
+  }
+}
+
+
+
+void scheduler_cancel(Scheduler *sched, uint8_t task) {
+  if ((task >= SCHEDULER_TASKS) || !sched->tasks[task].set) {
+    return;
+  }
+  unfile_task(sched, task);
+  sched->tasks[task].set = false;
+  if (!sched->running) {
+    arm(sched);
+  }
+}
+
+
+
+bool scheduler_is_set(const Scheduler *sched, uint8_t task) {
+  return (task < SCHEDULER_TASKS) && sched->tasks[task].set;
+}
+
+
+
+// A task due by now_ms, SCHEDULER_NONE if none is
+static uint8_t find_due(const Scheduler *sched, uint32_t now_ms) {
+  for (int slot = first_occupied(sched, 0); slot >= 0; slot = first_occupied(sched, slot + 1)) {
+    for (uint8_t task = sched->slots[slot]; task != SCHEDULER_NONE; task = sched->tasks[task].next) {
+      if (ms_until(sched->tasks[task].due_ms, now_ms) <= 0) {
+        return task;
+      }
+    }
+  }
+  return SCHEDULER_NONE;
+}
+
+
+
+/*
+	Runs every task due by now, one after the other,
+	each taken out (or moved to its next period)
+	before its callback, which may set or cancel
+	any task. Only the first run of a timer wakeup
+	has the wakeup to itself.
+*/
+static void run_due(Scheduler *sched, bool from_timer) {
+  uint32_t now_ms = clock_ms(sched);
+  bool first = from_timer;
+  uint8_t task;
+
+  sched->running = true;
+  sched->run_ms = now_ms;
+  while ((task = find_due(sched, now_ms)) != SCHEDULER_NONE) {
+    SchedulerTask *entry = &sched->tasks[task];
+    unfile_task(sched, task);
+    if (entry->period_ms) {
+      entry->due_ms += entry->period_ms;
+      int32_t late_ms = -ms_until(entry->due_ms, now_ms);
+      if (late_ms >= 0) {
+        entry->due_ms += ((late_ms / entry->period_ms) + 1) * entry->period_ms;	// Skip missed periods
+      }
+      file_task(sched, task);
+    } else {
+      entry->set = false;
+    }
+
+    sched->runs++;
+    if (!first) {
+      sched->shared++;
+    }
+    first = false;
+    entry->callback(entry->data);
+  }
+  sched->running = false;
+  arm(sched);
+}
+
+
+
+/*
+	Earliest deadline: in the first slot holding one
+	within a turn of the last run (none is earlier),
+	or else the earliest of those further out.
+*/
+static bool next_deadline(const Scheduler *sched, uint32_t *out_ms) {
+  uint32_t from_ms = sched->run_ms;
+  int start = slot_of(from_ms);
+  bool found = false;
+
+  for (int pass = 0; (pass < 2) && !found; pass++) {
+    for (int slot = first_occupied(sched, pass ? 0 : start); (slot >= 0) && !found && (!pass || (slot < start));
+         slot = first_occupied(sched, slot + 1)) {
+      for (uint8_t task = sched->slots[slot]; task != SCHEDULER_NONE; task = sched->tasks[task].next) {
+        uint32_t ms = deadline_ms(&sched->tasks[task]);
+        if ((ms_until(ms, from_ms) < SCHEDULER_SPAN_MS) && (!found || (ms_until(ms, *out_ms) < 0))) {
+          *out_ms = ms;
+          found = true;
+        }
+      }
+    }
+  }
+  if (found) {
+    return true;
+  }
+
+  for (uint8_t task = 0; task < SCHEDULER_TASKS; task++) {
+    const SchedulerTask *entry = &sched->tasks[task];
+    if (entry->set && (!found || (ms_until(deadline_ms(entry), *out_ms) < 0))) {
+      *out_ms = deadline_ms(entry);
+      found = true;
+    }
+  }
+  return found;
+}
+
+
+
+static void timer_fired(void *data) {
+  Scheduler *sched = data;
+  clock_ms(sched);
+  if (ms_until(sched->timer_ms, sched->now_ms) > 0) {
+    sched->now_ms = sched->timer_ms;	// The timer waited that long, whatever the wall clock says
+  }
+  sched->timer = NULL;
+  sched->wakeups++;
+  run_due(sched, true);
+}
+
+
+
+/*
+	Points the app_timer at the earliest deadline,
+	moving it rather than registering a new one.
+*/
+static void arm(Scheduler *sched) {
+  uint32_t now_ms = clock_ms(sched);
+  uint32_t wake_ms;
+  if (!next_deadline(sched, &wake_ms)) {
+    if (sched->timer) {
+      app_timer_cancel(sched->timer);
+      sched->timer = NULL;
+    }
+    return;
+  }
+  if (sched->timer && (sched->timer_ms == wake_ms)) {
+    return;
+  }
+
+  int32_t delay_ms = ms_until(wake_ms, now_ms);
+  delay_ms = (delay_ms > 0) ? delay_ms : 0;
+  sched->timer_ms = wake_ms;
+  if (!sched->timer || !app_timer_reschedule(sched->timer, delay_ms)) {
+    sched->timer = app_timer_register(delay_ms, timer_fired, sched);
+  }
+}
+
+
+
+/*
+	Runs what is due from a wakeup the app got
+	anyway.
+*/
+void scheduler_poll(Scheduler *sched) {
+  if (!sched->running) {
+    run_due(sched, false);
+  }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+/*
+	All of SeizeAlert's timed work on one app_timer.
+
+	The app numbers its tasks (0 .. SCHEDULER_TASKS - 1) and sets
+	each with a delay, a period (0 for a one-shot) and a slack: how
+	late it may run so it shares a wakeup with something else. Tasks
+	are filed in a hashed timer wheel of SCHEDULER_SLOTS slots of
+	SCHEDULER_TICK_MS by their deadline, the due time plus the
+	slack; a deadline further out than the wheel spans waits in its
+	slot for the turns left.
+
+	The one app_timer is armed for the earliest deadline. When it
+	fires, every task that is already due runs, not only the one
+	whose deadline it was, so deadlines close together cost one
+	wakeup. scheduler_poll() does the same from the app's other
+	wakeups (accelerometer batches, the minute tick), so a task
+	with enough slack rides along with those and never wakes the
+	watch itself.
+
+	Periodic tasks keep their grid: the next run is due one period
+	after the last one was due, not after it ran, so a late wakeup
+	does not delay every later run; periods missed entirely are
+	skipped, not run in a burst. scheduler_set() on a set task moves
+	it, scheduler_cancel() takes it out, due or not, also from its
+	own callback.
+
+	The clock counts milliseconds from scheduler_init() as
+	time_ms() moves, but it is monotonic: time_ms() is the wall
+	clock, which the phone, a time zone or DST can set back or
+	forward. A step back is ignored, and a step forward is cut
+	to what the armed timer allows; the timer firing moves the
+	clock to its deadline at least. 32 bits of milliseconds: it
+	wraps after 49 days, which the deadline comparisons allow
+	for.
+*/
+
+#include <pebble.h>
+
+#define SCHEDULER_TASKS 4
+#define SCHEDULER_TICK_MS 10
+#define SCHEDULER_SLOTS 128			// 1.28 s per turn of the wheel
+#define SCHEDULER_MAX_SLACK_MS ((SCHEDULER_SLOTS - 1) * SCHEDULER_TICK_MS)
+#define SCHEDULER_NONE 0xff			// No task
+#define SCHEDULER_MAX_LATE_MS 250		// How late the timer may fire, for the clock
+
+typedef void (*SchedulerCallback)(void *data);
+
+typedef struct {
+  SchedulerCallback callback;
+  void *data;
+  uint32_t due_ms;			// Earliest run, on the scheduler clock
+  uint32_t period_ms;			// 0 = one-shot
+  uint16_t slack_ms;
+  uint8_t next;				// Next task in the same slot
+  bool set;
+} SchedulerTask;
+
+typedef struct {
+  SchedulerTask tasks[SCHEDULER_TASKS];
+  uint8_t slots[SCHEDULER_SLOTS];	// First task of each slot
+  uint32_t occupied[SCHEDULER_SLOTS / 32];	// Slots holding a task
+  uint32_t now_ms;			// The scheduler clock
+  uint32_t wall_ms;			// time_ms() when it was last read, truncated
+  uint32_t run_ms;			// Last run of due tasks: no deadline is earlier
+  bool running;				// Arm the timer once, after the run
+
+  AppTimer *timer;
+  uint32_t timer_ms;			// When it is due
+
+  uint32_t wakeups;			// Times the timer fired
+  uint32_t runs;			// Task callbacks, from the timer or a poll
+  uint32_t shared;			// Runs that shared their wakeup with another one
+} Scheduler;
+
+void scheduler_init(Scheduler *sched);
+void scheduler_deinit(Scheduler *sched);
+
+void scheduler_set(Scheduler *sched, uint8_t task, uint32_t delay_ms, uint32_t period_ms, uint16_t slack_ms,
+                   SchedulerCallback callback, void *data);
+void scheduler_cancel(Scheduler *sched, uint8_t task);
+bool scheduler_is_set(const Scheduler *sched, uint8_t task);
+void scheduler_poll(Scheduler *sched);
@@ -0,0 +1,176 @@
+#include <pebble.h>
+#include <seizure_detector.h>
+#include <accel_magnitude.h>
+
+#define Q14_SHIFT 14
+
+
+void seizure_detector_init(SeizureDetector *sd, const SeizureConfig *config) {
+  memset(sd, 0, sizeof(*sd));
+  sd->config = *config;
+
+  // Bins fully inside [band_low_hz, band_high_hz], below Nyquist
+  uint32_t rate = config->rate_hz ? config->rate_hz : SEIZURE_RATE_HZ;
+  uint32_t first = (config->band_low_hz * SEIZURE_WINDOW_SAMPLES + rate - 1) / rate;
+  uint32_t last = (config->band_high_hz * SEIZURE_WINDOW_SAMPLES) / rate;
+  if (first < 1) {
+    first = 1;
+  }
+  if (last > SEIZURE_WINDOW_SAMPLES / 2 - 1) {
+    last = SEIZURE_WINDOW_SAMPLES / 2 - 1;
+  }
+  if (last >= first + SEIZURE_MAX_BINS) {
+    last = first + SEIZURE_MAX_BINS - 1;
+  }
+
+  sd->first_bin = first;
+  sd->num_bins = (last >= first) ? (last - first + 1) : 0;
+  for (uint32_t i = 0; i < sd->num_bins; i++) {
+    int32_t angle = (TRIG_MAX_ANGLE * (first + i)) / SEIZURE_WINDOW_SAMPLES;
+    sd->coeffs[i] = cos_lookup(angle) >> 1;	// 2 cos in Q14 from cos in Q16
+  }
+}
+
+
+
+void seizure_detector_reset(SeizureDetector *sd) {
+  memset(sd->ring, 0, sizeof(sd->ring));
+  sd->next = 0;
+  sd->count = 0;
+  sd->since_window = 0;
+  sd->rhythmic = 0;
+  sd->quiet = 0;
+  sd->in_episode = false;
+  sd->last_percent = 0;
+}
+
+
+
+/*
+	Deviation of the magnitude from 1 g, linearized
+	around 1 g so no square root is needed:
+	|a| - 1000 ~ (|a|^2 - 1000^2) / 2000.
+*/
+static inline int16_t magnitude_deviation(const AccelData *sample) {
+  int32_t m2 = (int32_t)ACCEL_MAGNITUDE_SQUARED(sample->x, sample->y, sample->z);
+  int32_t deviation = (m2 - ACCEL_ONE_G * ACCEL_ONE_G) / (2 * ACCEL_ONE_G);
+  return (deviation > INT16_MAX) ? INT16_MAX : deviation;
+}
+
+
+
+/*
+	Goertzel power |X_k|^2 of one bin over the
+	mean-removed window, oldest sample first.
+*/
+static int64_t goertzel_power(const int16_t *window, int32_t coeff) {
+  int32_t s1 = 0;
+  int32_t s2 = 0;
+  for (int i = 0; i < SEIZURE_WINDOW_SAMPLES; i++) {
+    int32_t s0 = window[i] + (int32_t)(((int64_t)coeff * s1) >> Q14_SHIFT) - s2;
+    s2 = s1;
+    s1 = s0;
+  }
+  return (int64_t)s1 * s1 + (int64_t)s2 * s2 - ((((int64_t)coeff * s1) >> Q14_SHIFT) * s2);
+}
+
+
+
+/*
+	Analyses the last SEIZURE_WINDOW_SAMPLES samples.
+	Returns true if the window is rhythmic: strong
+	enough and with band_percent of its power in the
+	band. By Parseval the window's power over all N
+	bins is N * sum(x^2); band bins count twice
+	(k and N - k).
+*/
+static bool analyse_window(SeizureDetector *sd) {
+  int16_t window[SEIZURE_WINDOW_SAMPLES];
+  int32_t sum = 0;
+
+  for (int i = 0; i < SEIZURE_WINDOW_SAMPLES; i++) {
+    sum += sd->ring[(sd->next + i) % SEIZURE_WINDOW_SAMPLES];
+  }
+  int32_t mean = sum / SEIZURE_WINDOW_SAMPLES;
+
+  int64_t energy = 0;
+  for (int i = 0; i < SEIZURE_WINDOW_SAMPLES; i++) {
+    int32_t x = sd->ring[(sd->next + i) % SEIZURE_WINDOW_SAMPLES] - mean;
+    x = (x > INT16_MAX) ? INT16_MAX : ((x < INT16_MIN) ? INT16_MIN : x);
+    window[i] = x;
+    energy += x * x;
+  }
+
+  sd->windows++;
+  sd->last_percent = 0;
+
+  int64_t min_rms = sd->config.min_rms;
+  if ((energy == 0) || (energy < SEIZURE_WINDOW_SAMPLES * min_rms * min_rms)) {
+    return false;
+  }
+
+  int64_t band = 0;
+  for (int i = 0; i < sd->num_bins; i++) {
+    band += goertzel_power(window, sd->coeffs[i]);
+  }
+
+  int64_t percent = (200 * band) / (SEIZURE_WINDOW_SAMPLES * energy);
+  sd->last_percent = (percent > 100) ? 100 : percent;
+  return sd->last_percent >= sd->config.band_percent;
+}
+
+
+
+/*
+	Pushes a batch of samples and analyses a window
+	every SEIZURE_HOP_SAMPLES samples. Writes the
+	events it produced (at most
+	SEIZURE_MAX_EVENTS(num_samples)) to events and
+	returns their number, which may exceed max_events;
+	extra events are not stored.
+*/
+uint32_t seizure_detector_feed(SeizureDetector *sd, const AccelData *data, uint32_t num_samples,
+                               SeizureEvent *events, uint32_t max_events) {
+  uint32_t num_events = 0;
+
+  for (uint32_t i = 0; i < num_samples; i++) {
+    sd->ring[sd->next] = magnitude_deviation(&data[i]);
+    sd->next = (sd->next + 1) % SEIZURE_WINDOW_SAMPLES;
+    if (sd->count < SEIZURE_WINDOW_SAMPLES) {
+      sd->count++;
+    }
+
+    if ((++sd->since_window < SEIZURE_HOP_SAMPLES) || (sd->count < SEIZURE_WINDOW_SAMPLES)) {
+      continue;
+    }
+    sd->since_window = 0;
+
+    int8_t event = -1;
+    if (analyse_window(sd)) {
+      sd->quiet = 0;
+      if (sd->rhythmic < UINT8_MAX) {
+        sd->rhythmic++;
+      }
+      if (!sd->in_episode && (sd->rhythmic >= sd->config.sustain_windows)) {
+        sd->in_episode = true;
+        event = SEIZURE_EVENT_ONSET;
+      }
+    } else {
+      sd->rhythmic = 0;
+      if (sd->in_episode && (++sd->quiet >= sd->config.quiet_windows)) {
+        sd->in_episode = false;
+        sd->quiet = 0;
+        event = SEIZURE_EVENT_END;
+      }
+    }
+
+    if (event >= 0) {
+      if (num_events < max_events) {
+        events[num_events] = (SeizureEvent) { .type = event, .sample = i };
+      }
+      num_events++;
+    }
+  }
+
+  return num_events;
+}
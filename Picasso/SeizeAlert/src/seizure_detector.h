@@ -0,0 +1,91 @@
+#pragma once
+
+/*
+	SeizeAlert's seizure detector.
+
+	Looks for the sustained 3-8 Hz shaking of the clonic phase
+	of a tonic-clonic seizure. Every SEIZURE_HOP_SAMPLES samples
+	it runs fixed-point Goertzel filters over the last
+	SEIZURE_WINDOW_SAMPLES samples of the magnitude and compares
+	the power in the band with the total (Parseval) power of the
+	window. A window is rhythmic when enough of its power is in
+	the band and the shaking is strong enough; SEIZURE_SUSTAIN_WINDOWS
+	rhythmic windows in a row report a seizure.
+
+	At 25 Hz a 64 sample window has 0.39 Hz bins and the band is
+	bins 8 to 20. The filters run once per hop, not per sample:
+	about (bins * window / hop) multiply-adds per sample, integer
+	only. Same calling convention as detector_feed().
+*/
+
+#include <pebble.h>
+
+#define SEIZURE_WINDOW_SAMPLES 64	// Power of two, <= 256
+#define SEIZURE_HOP_SAMPLES 32		// 1.28 s at 25 Hz
+#define SEIZURE_MAX_BINS 24
+
+#define SEIZURE_RATE_HZ 25
+#define SEIZURE_BAND_LOW_HZ 3
+#define SEIZURE_BAND_HIGH_HZ 8
+#define SEIZURE_BAND_PERCENT 60		// Share of the window power in the band
+#define SEIZURE_MIN_RMS 150		// Shaking amplitude, milli-g RMS
+#define SEIZURE_SUSTAIN_WINDOWS 8	// ~10 s of rhythmic windows
+#define SEIZURE_QUIET_WINDOWS 4		// Non-rhythmic windows that end an episode
+
+// seizure_detector_feed() reports at most one event per hop
+#define SEIZURE_MAX_EVENTS(num_samples) (((num_samples) + SEIZURE_HOP_SAMPLES - 1) / SEIZURE_HOP_SAMPLES)
+
+typedef struct {
+  uint16_t rate_hz;
+  uint8_t band_low_hz;
+  uint8_t band_high_hz;
+  uint8_t band_percent;
+  uint16_t min_rms;
+  uint8_t sustain_windows;
+  uint8_t quiet_windows;
+} SeizureConfig;
+
+#define SEIZURE_DEFAULT_CONFIG ((SeizureConfig) {	\
+    .rate_hz = SEIZURE_RATE_HZ,				\
+    .band_low_hz = SEIZURE_BAND_LOW_HZ,			\
+    .band_high_hz = SEIZURE_BAND_HIGH_HZ,		\
+    .band_percent = SEIZURE_BAND_PERCENT,		\
+    .min_rms = SEIZURE_MIN_RMS,				\
+    .sustain_windows = SEIZURE_SUSTAIN_WINDOWS,		\
+    .quiet_windows = SEIZURE_QUIET_WINDOWS,		\
+  })
+
+typedef enum {
+  SEIZURE_EVENT_ONSET = 0,	// Sustained rhythmic shaking: log it
+  SEIZURE_EVENT_END,		// The episode's shaking stopped
+} SeizureEventType;
+
+typedef struct {
+  SeizureEventType type;
+  uint32_t sample;		// Index in the batch given to seizure_detector_feed()
+} SeizureEvent;
+
+typedef struct {
+  SeizureConfig config;
+  uint8_t first_bin;
+  uint8_t num_bins;
+  int32_t coeffs[SEIZURE_MAX_BINS];	// 2 cos(2 pi k / N), Q14
+
+  int16_t ring[SEIZURE_WINDOW_SAMPLES];	// Magnitude minus 1 g, milli-g
+  uint8_t next;
+  uint16_t count;
+  uint16_t since_window;
+
+  uint8_t rhythmic;		// Rhythmic windows in a row
+  uint8_t quiet;		// Non-rhythmic windows in a row, during an episode
+  bool in_episode;
+
+  uint8_t last_percent;		// Band share of the last window, for logging
+  uint32_t windows;		// Windows analysed since init
+} SeizureDetector;
+
+void seizure_detector_init(SeizureDetector *sd, const SeizureConfig *config);
+void seizure_detector_reset(SeizureDetector *sd);
+
+uint32_t seizure_detector_feed(SeizureDetector *sd, const AccelData *data, uint32_t num_samples,
+                               SeizureEvent *events, uint32_t max_events);
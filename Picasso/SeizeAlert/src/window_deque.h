@@ -0,0 +1,74 @@
+#pragma once
+
+/*
+	Monotonic deques of ring positions, for sliding-window
+	min / max in O(1) amortized per sample (accel_window.h,
+	magnitude_window.h). Positions are uint8_t, so the rings
+	are WINDOW_DEQUE_SIZE long and wrap on their own.
+*/
+
+#include <pebble.h>
+
+#define WINDOW_DEQUE_SIZE 256
+
+typedef struct {
+  uint8_t pos[WINDOW_DEQUE_SIZE];	// Ring positions, values monotonic front to back
+  uint8_t head;
+  uint16_t count;
+} WindowDeque;
+
+static inline uint8_t window_deque_at(const WindowDeque *deque, uint16_t i) {
+  return deque->pos[(uint8_t)(deque->head + i)];
+}
+
+
+
+/*
+	Appends pos to a monotonic deque, dropping every
+	entry it dominates. Each position is pushed and
+	popped at most once: O(1) amortized. Written as a
+	macro so each ring type and direction gets its own
+	branch-light loop.
+*/
+#define WINDOW_DEQUE_PUSH(deque, ring, pos, keeps)			\
+  do {									\
+    int32_t value = (ring)[pos];					\
+    while ((deque)->count > 0) {					\
+      int32_t back = (ring)[window_deque_at((deque), (deque)->count - 1)];	\
+      if (back keeps value) {						\
+        break;								\
+      }									\
+      (deque)->count--;							\
+    }									\
+    (deque)->pos[(uint8_t)((deque)->head + (deque)->count)] = (pos);	\
+    (deque)->count++;							\
+  } while (0)
+
+
+
+// Drops pos from the front, once it left the window
+static inline void window_deque_expire(WindowDeque *deque, uint8_t pos) {
+  if ((deque->count > 0) && (deque->pos[deque->head] == pos)) {
+    deque->head++;
+    deque->count--;
+  }
+}
+
+
+
+/*
+	First entry no older than `last` samples before
+	newest. Entries get younger front to back, so
+	this is the extreme of the suffix. Costs the
+	number of entries skipped, bounded by the window
+	length.
+*/
+static inline uint8_t window_deque_suffix_front(const WindowDeque *deque, uint8_t newest, uint16_t last) {
+  for (uint16_t i = 0; i < deque->count; i++) {
+    uint8_t pos = window_deque_at(deque, i);
+    if ((uint8_t)(newest - pos) < last) {
+      return pos;
+    }
+  }
+  return newest;
+}
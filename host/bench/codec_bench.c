@@ -0,0 +1,161 @@
+/*
+* accel_codec benchmark.
+*
+* Encodes a trace in store-batch's page-sized blocks, decodes it back,
+* checks the round trip is lossless and reports the compression ratio and
+* encode / decode throughput in MB/s of raw int16 samples.
+*
+*   codec_bench [--trace FILE] [--rate HZ] [--synthetic SECONDS] [--seed N]
+*               [--block SAMPLES] [--out FILE]
+*
+* --out writes the encoded stream, which tools/accel_decode turns back
+* into a trace.
+*/
+
+#include "shim.h"
+#include "accel_codec.h"
+#include "capture.h"
+
+#define DEFAULT_SYNTHETIC_S (60 * 60)
+#define MIN_BENCH_NS 200000000ULL	// Repeat each pass for at least 0.2 s
+
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [--trace FILE] [--rate HZ] [--synthetic SECONDS] [--seed N] [--block SAMPLES] [--out FILE]\n",
+          argv0);
+}
+
+
+
+static uint32_t encode_all(const int16_t *raw, uint32_t num_samples, uint32_t block, uint8_t *out, uint32_t out_size) {
+  uint32_t used = 0;
+  for (uint32_t i = 0; i < num_samples; i += block) {
+    uint32_t count = (num_samples - i < block) ? num_samples - i : block;
+    used += accel_codec_encode(&raw[i * 3], count, out + used, out_size - used);
+  }
+  return used;
+}
+
+
+
+static uint32_t decode_all(const uint8_t *in, uint32_t size, int16_t *samples, uint32_t max_samples) {
+  uint32_t pos = 0;
+  uint32_t total = 0;
+  while (pos < size) {
+    uint32_t count;
+    uint32_t used = accel_codec_decode(in + pos, size - pos, &samples[total * 3], max_samples - total, &count);
+    if (used == 0) {
+      break;
+    }
+    pos += used;
+    total += count;
+  }
+  return total;
+}
+
+
+
+int main(int argc, char **argv) {
+  const char *trace_path = NULL;
+  const char *out_path = NULL;
+  uint32_t rate_hz = 25;
+  uint32_t synthetic_s = DEFAULT_SYNTHETIC_S;
+  uint32_t seed = 0;
+  uint32_t block = CAPTURE_PAGE_SAMPLES;
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "--trace") == 0) && (i + 1 < argc)) {
+      trace_path = argv[++i];
+    } else if ((strcmp(argv[i], "--rate") == 0) && (i + 1 < argc)) {
+      rate_hz = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--synthetic") == 0) && (i + 1 < argc)) {
+      synthetic_s = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--seed") == 0) && (i + 1 < argc)) {
+      seed = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--block") == 0) && (i + 1 < argc)) {
+      block = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--out") == 0) && (i + 1 < argc)) {
+      out_path = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if ((block == 0) || (block > ACCEL_CODEC_MAX_SAMPLES)) {
+    fprintf(stderr, "%s: block must be 1..%d samples\n", argv[0], ACCEL_CODEC_MAX_SAMPLES);
+    return 2;
+  }
+
+  Trace trace;
+  if (trace_path) {
+    if (!trace_load(&trace, trace_path, rate_hz)) {
+      fprintf(stderr, "%s: cannot read trace %s\n", argv[0], trace_path);
+      return 1;
+    }
+    printf("trace:            %s, %u samples @ %u Hz\n", trace_path, trace.num_samples, trace.rate_hz);
+  } else {
+    trace_synthesize(&trace, synthetic_s, rate_hz, seed);
+    printf("trace:            synthetic, %u samples @ %u Hz\n", trace.num_samples, trace.rate_hz);
+  }
+
+  uint32_t n = trace.num_samples;
+  uint32_t num_blocks = (n + block - 1) / block;
+  uint32_t raw_bytes = n * 3 * sizeof(int16_t);
+  uint32_t out_size = num_blocks * ACCEL_CODEC_MAX_BLOCK_BYTES(block);
+  int16_t *raw = malloc(raw_bytes + 1);
+  int16_t *decoded = malloc(raw_bytes + 1);
+  uint8_t *encoded = malloc(out_size + 1);
+  if (!raw || !decoded || !encoded) {
+    fprintf(stderr, "%s: out of memory\n", argv[0]);
+    return 1;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    raw[i * 3] = trace.samples[i].x;
+    raw[i * 3 + 1] = trace.samples[i].y;
+    raw[i * 3 + 2] = trace.samples[i].z;
+  }
+
+  uint32_t encoded_bytes = 0;
+  uint32_t passes = 0;
+  uint64_t start_ns = shim_clock_ns();
+  do {
+    encoded_bytes = encode_all(raw, n, block, encoded, out_size);
+    passes++;
+  } while (shim_clock_ns() - start_ns < MIN_BENCH_NS);
+  double encode_s = (shim_clock_ns() - start_ns) / 1e9 / passes;
+
+  uint32_t decoded_samples = 0;
+  passes = 0;
+  start_ns = shim_clock_ns();
+  do {
+    decoded_samples = decode_all(encoded, encoded_bytes, decoded, n);
+    passes++;
+  } while (shim_clock_ns() - start_ns < MIN_BENCH_NS);
+  double decode_s = (shim_clock_ns() - start_ns) / 1e9 / passes;
+
+  bool lossless = (decoded_samples == n) && (memcmp(raw, decoded, raw_bytes) == 0);
+  double raw_mb = raw_bytes / 1e6;
+
+  printf("blocks:           %u of %u samples\n", num_blocks, block);
+  printf("size:             %u bytes raw, %u encoded, %.2fx, %.2f bytes/sample\n",
+         raw_bytes, encoded_bytes, encoded_bytes ? (double)raw_bytes / encoded_bytes : 0.0,
+         n ? (double)encoded_bytes / n : 0.0);
+  printf("encode:           %.1f MB/s\n", encode_s > 0 ? raw_mb / encode_s : 0.0);
+  printf("decode:           %.1f MB/s\n", decode_s > 0 ? raw_mb / decode_s : 0.0);
+  printf("round trip:       %s\n", lossless ? "lossless" : "MISMATCH");
+
+  if (out_path) {
+    FILE *out = fopen(out_path, "wb");
+    if (!out || (fwrite(encoded, 1, encoded_bytes, out) != encoded_bytes)) {
+      fprintf(stderr, "%s: cannot write %s\n", argv[0], out_path);
+      return 1;
+    }
+    fclose(out);
+  }
+
+  free(raw);
+  free(decoded);
+  free(encoded);
+  trace_free(&trace);
+  return lossless ? 0 : 1;
+}
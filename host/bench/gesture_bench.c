@@ -0,0 +1,102 @@
+/*
+* GestureRecording host benchmark.
+*
+* Replays a trace through the unmodified Picasso/GestureRecording app with
+* scripted buttons: SELECT records a gesture, DOWN exports it as binary
+* chunks through data logging and UP dumps it to the console with APP_LOG,
+* so the two export paths can be compared on the same recording.
+*
+*   gesture_bench [--trace FILE] [--rate HZ] [--seed N] [--spool FILE] [--verbose]
+*
+* --spool writes what data logging received (see shim.h); tools/gesture_receive
+* rebuilds the recording from it.
+*/
+
+#include "shim.h"
+
+#define RECORD_AT_MS 1000
+#define EXPORT_AT_MS (RECORD_AT_MS + 12000)	// After the 10 s recording
+#define DUMP_AT_MS (EXPORT_AT_MS + 1000)
+#define DEFAULT_SYNTHETIC_S 40
+
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [--trace FILE] [--rate HZ] [--seed N] [--spool FILE] [--verbose]\n", argv0);
+}
+
+
+
+int main(int argc, char **argv) {
+  const char *trace_path = NULL;
+  const char *spool_path = NULL;
+  uint32_t rate_hz = 25;
+  uint32_t seed = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "--trace") == 0) && (i + 1 < argc)) {
+      trace_path = argv[++i];
+    } else if ((strcmp(argv[i], "--rate") == 0) && (i + 1 < argc)) {
+      rate_hz = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--seed") == 0) && (i + 1 < argc)) {
+      seed = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--spool") == 0) && (i + 1 < argc)) {
+      spool_path = argv[++i];
+    } else if (strcmp(argv[i], "--verbose") == 0) {
+      shim_set_verbose(true);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  Trace trace;
+  if (trace_path) {
+    if (!trace_load(&trace, trace_path, rate_hz)) {
+      fprintf(stderr, "%s: cannot read trace %s\n", argv[0], trace_path);
+      return 1;
+    }
+    printf("trace:            %s, %u samples @ %u Hz\n", trace_path, trace.num_samples, trace.rate_hz);
+  } else {
+    trace_synthesize(&trace, DEFAULT_SYNTHETIC_S, rate_hz, seed);
+    printf("trace:            synthetic, %u samples @ %u Hz\n", trace.num_samples, trace.rate_hz);
+  }
+  if (trace_duration_ms(&trace) <= DUMP_AT_MS) {
+    fprintf(stderr, "%s: trace must be longer than %u ms\n", argv[0], DUMP_AT_MS);
+    return 1;
+  }
+
+  FILE *spool = NULL;
+  if (spool_path) {
+    spool = fopen(spool_path, "wb");
+    if (!spool) {
+      fprintf(stderr, "%s: cannot write %s\n", argv[0], spool_path);
+      return 1;
+    }
+    shim_set_log_spool(spool);
+  }
+
+  shim_set_trace(&trace);
+  shim_schedule_click(RECORD_AT_MS, BUTTON_ID_SELECT);
+  shim_schedule_click(EXPORT_AT_MS, BUTTON_ID_DOWN);
+  shim_schedule_click(DUMP_AT_MS, BUTTON_ID_UP);
+  pebble_app_main();
+
+  if (spool) {
+    fclose(spool);
+  }
+  shim_report(stdout);
+
+  const ShimStats *stats = shim_stats();
+  const ShimCallbackStats *export = &stats->clicks[BUTTON_ID_DOWN];
+  const ShimCallbackStats *dump = &stats->clicks[BUTTON_ID_UP];
+  printf("binary export:    %llu ns, %llu bytes logged\n",
+         (unsigned long long)export->ns, (unsigned long long)stats->log_bytes);
+  printf("console dump:     %llu ns, %llu bytes in %llu lines\n", (unsigned long long)dump->ns,
+         (unsigned long long)stats->console_bytes, (unsigned long long)stats->console_lines);
+  if (export->ns) {
+    printf("export speedup:   %.1fx\n", (double)dump->ns / export->ns);
+  }
+
+  trace_free(&trace);
+  return 0;
+}
@@ -0,0 +1,226 @@
+/*
+* gesture_recognizer benchmark.
+*
+* Takes templates from the trace the way GestureRecording does (the most
+* active 2 s of a recording, here 10 s of trace from each --template
+* second), streams the whole trace through the recognizer one sample at a
+* time and reports how windows were rejected, the time per window and the
+* matches. The same windows then go through a plain banded DTW with no
+* lower bounds or abandoning, which must find exactly the same matches.
+*
+*   gesture_recognizer_bench [--trace FILE] [--rate HZ] [--synthetic SECONDS] [--seed N]
+*                            [--template SECOND]...
+*
+* Without --template, the synthetic trace's first fall, walk and shake
+* (20, 80 and 140 s in) are the templates.
+*/
+
+#include "shim.h"
+#include "gesture_recognizer.h"
+
+#define DEFAULT_SYNTHETIC_S (60 * 60)
+#define RECORDING_S 10
+#define N GESTURE_TEMPLATE_SAMPLES
+#define R GESTURE_BAND
+#define NO_DISTANCE INT32_MAX
+
+typedef struct {
+  uint32_t sample;		// Last sample of the matched window
+  uint8_t template;
+  int32_t distance;
+} BenchMatch;
+
+static const uint32_t DEFAULT_TEMPLATE_S[] = { 20, 80, 140 };
+
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [--trace FILE] [--rate HZ] [--synthetic SECONDS] [--seed N] [--template SECOND]...\n",
+          argv0);
+}
+
+
+
+static AccelData accel_sample(const Trace *trace, uint32_t i) {
+  return (AccelData) { .x = trace->samples[i].x, .y = trace->samples[i].y, .z = trace->samples[i].z };
+}
+
+
+
+static int32_t reference_dtw(const Trace *trace, uint32_t start, const GestureTemplate *template) {
+  static int32_t cost[N][N];
+  for (int i = 0; i < N; i++) {
+    const TraceSample *s = &trace->samples[start + i];
+    for (int j = 0; j < N; j++) {
+      cost[i][j] = NO_DISTANCE;
+      if ((j < i - R) || (j > i + R)) {
+        continue;
+      }
+      int32_t d = abs(s->x - template->axes[GESTURE_AXIS_X][j]) + abs(s->y - template->axes[GESTURE_AXIS_Y][j]) +
+                  abs(s->z - template->axes[GESTURE_AXIS_Z][j]);
+      int32_t best = ((i == 0) && (j == 0)) ? 0 : NO_DISTANCE;
+      if ((i > 0) && (j > 0) && (cost[i - 1][j - 1] < best)) {
+        best = cost[i - 1][j - 1];
+      }
+      if ((i > 0) && (cost[i - 1][j] < best)) {
+        best = cost[i - 1][j];
+      }
+      if ((j > 0) && (cost[i][j - 1] < best)) {
+        best = cost[i][j - 1];
+      }
+      cost[i][j] = (best == NO_DISTANCE) ? NO_DISTANCE : best + d;
+    }
+  }
+  return cost[N - 1][N - 1];
+}
+
+
+
+/*
+	Every window against every template in full, with
+	the recognizer's rules: closest template within its
+	threshold, none until the matched window slid out.
+*/
+static uint32_t reference_matches(const Trace *trace, const GestureRecognizer *rec, BenchMatch *matches,
+                                  uint32_t max_matches) {
+  uint32_t num_matches = 0;
+  for (uint32_t last = N - 1; last < trace->num_samples; last++) {
+    int best = -1;
+    int32_t best_distance = NO_DISTANCE;
+    for (int t = 0; t < rec->num_templates; t++) {
+      int32_t d = reference_dtw(trace, last - (N - 1), &rec->templates[t]);
+      if ((d <= rec->templates[t].threshold) && (d <= best_distance)) {
+        best = t;
+        best_distance = d;
+      }
+    }
+    if (best >= 0) {
+      if (num_matches < max_matches) {
+        matches[num_matches] = (BenchMatch) { .sample = last, .template = best, .distance = best_distance };
+      }
+      num_matches++;
+      last += N - 1;
+    }
+  }
+  return num_matches;
+}
+
+
+
+static double percent(uint32_t part, uint32_t whole) {
+  return whole ? (100.0 * part) / whole : 0.0;
+}
+
+
+
+int main(int argc, char **argv) {
+  const char *trace_path = NULL;
+  uint32_t rate_hz = 25;
+  uint32_t synthetic_s = DEFAULT_SYNTHETIC_S;
+  uint32_t seed = 0;
+  uint32_t template_s[GESTURE_MAX_TEMPLATES];
+  uint32_t num_template_s = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "--trace") == 0) && (i + 1 < argc)) {
+      trace_path = argv[++i];
+    } else if ((strcmp(argv[i], "--rate") == 0) && (i + 1 < argc)) {
+      rate_hz = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--synthetic") == 0) && (i + 1 < argc)) {
+      synthetic_s = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--seed") == 0) && (i + 1 < argc)) {
+      seed = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--template") == 0) && (i + 1 < argc) && (num_template_s < GESTURE_MAX_TEMPLATES)) {
+      template_s[num_template_s++] = (uint32_t)atoi(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (num_template_s == 0) {
+    num_template_s = ARRAY_LENGTH(DEFAULT_TEMPLATE_S);
+    memcpy(template_s, DEFAULT_TEMPLATE_S, sizeof(DEFAULT_TEMPLATE_S));
+  }
+
+  Trace trace;
+  if (trace_path) {
+    if (!trace_load(&trace, trace_path, rate_hz)) {
+      fprintf(stderr, "%s: cannot read trace %s\n", argv[0], trace_path);
+      return 1;
+    }
+    printf("trace:            %s, %u samples @ %u Hz\n", trace_path, trace.num_samples, trace.rate_hz);
+  } else {
+    trace_synthesize(&trace, synthetic_s, rate_hz, seed);
+    printf("trace:            synthetic, %u samples @ %u Hz\n", trace.num_samples, trace.rate_hz);
+  }
+
+  static GestureRecognizer rec;
+  static GestureBuffer recording;
+  gesture_recognizer_init(&rec);
+  for (uint32_t t = 0; t < num_template_s; t++) {
+    uint32_t first = template_s[t] * trace.rate_hz;
+    uint32_t count = RECORDING_S * trace.rate_hz;
+    if (first + count > trace.num_samples) {
+      fprintf(stderr, "%s: no %u s recording at %u s in the trace\n", argv[0], RECORDING_S, template_s[t]);
+      return 1;
+    }
+    gesture_buffer_init(&recording);
+    for (uint32_t i = first; i < first + count; i++) {
+      AccelData sample = accel_sample(&trace, i);
+      gesture_buffer_push(&recording, &sample);
+    }
+    gesture_recognizer_add(&rec, &recording);
+    printf("template %u:       %u s into the trace\n", t + 1, template_s[t]);
+  }
+
+  uint32_t max_matches = trace.num_samples / N + 1;
+  BenchMatch *matches = calloc(max_matches, sizeof(BenchMatch));
+  BenchMatch *expected = calloc(max_matches, sizeof(BenchMatch));
+  if (!matches || !expected) {
+    fprintf(stderr, "%s: out of memory\n", argv[0]);
+    return 1;
+  }
+
+  uint32_t num_matches = 0;
+  uint32_t per_template[GESTURE_MAX_TEMPLATES] = { 0 };
+  uint64_t start_ns = shim_clock_ns();
+  for (uint32_t i = 0; i < trace.num_samples; i++) {
+    AccelData sample = accel_sample(&trace, i);
+    GestureMatch match;
+    if (gesture_recognizer_push(&rec, &sample, &match)) {
+      matches[num_matches++] = (BenchMatch) { .sample = i, .template = match.template, .distance = match.distance };
+      per_template[match.template]++;
+    }
+  }
+  uint64_t pruned_ns = shim_clock_ns() - start_ns;
+
+  start_ns = shim_clock_ns();
+  uint32_t num_expected = reference_matches(&trace, &rec, expected, max_matches);
+  uint64_t full_ns = shim_clock_ns() - start_ns;
+
+  bool agree = (num_matches == num_expected) &&
+               (memcmp(matches, expected, num_matches * sizeof(BenchMatch)) == 0);
+  const GestureRecognizerStats *stats = &rec.stats;
+  uint32_t full_cells = N * (2 * R + 1) - R * (R + 1);
+  double window_ns = stats->windows ? (double)pruned_ns / stats->windows : 0.0;
+
+  printf("windows:          %u, %u comparisons\n", stats->windows, stats->comparisons);
+  printf("rejected:         %.1f%% LB_Kim, %.1f%% LB_Keogh, %.1f%% DTW (abandoned), %.1f%% accepted\n",
+         percent(stats->kim_pruned, stats->comparisons), percent(stats->keogh_pruned, stats->comparisons),
+         percent(stats->dtw_rejected, stats->comparisons), percent(stats->dtw_accepted, stats->comparisons));
+  printf("DTW cells:        %.1f per comparison, %u for a full DTW\n",
+         stats->comparisons ? (double)stats->dtw_cells / stats->comparisons : 0.0, full_cells);
+  printf("window:           %.0f ns pruned, %.0f ns full DTW, %.1fx\n", window_ns,
+         stats->windows ? (double)full_ns / stats->windows : 0.0, pruned_ns ? (double)full_ns / pruned_ns : 0.0);
+  printf("at %u Hz:         %.1f us of recognizer per second\n", trace.rate_hz, window_ns * trace.rate_hz / 1000);
+  printf("matches:          %u (", num_matches);
+  for (uint32_t t = 0; t < rec.num_templates; t++) {
+    printf("%s%u", t ? ", " : "", per_template[t]);
+  }
+  printf(")\n");
+  printf("full DTW:         %s\n", agree ? "same matches" : "MISMATCH");
+
+  free(matches);
+  free(expected);
+  trace_free(&trace);
+  return agree ? 0 : 1;
+}
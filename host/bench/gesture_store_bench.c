@@ -0,0 +1,218 @@
+/*
+* gesture_store benchmark.
+*
+* Fills GestureRecording's template library from a trace (templates are
+* picked as the app does, from 10 s of trace at each --template second),
+* then times, and counts the persist traffic of, opening the library (the
+* index only, as at app startup), loading every template and saving one.
+* Loaded templates must equal the saved ones to within the quantization,
+* and a damaged chunk must be refused.
+*
+*   gesture_store_bench [--trace FILE] [--rate HZ] [--seed N] [--template SECOND]...
+*/
+
+#include "shim.h"
+#include "gesture_recognizer.h"
+#include "gesture_store.h"
+
+#define DEFAULT_SYNTHETIC_S 600
+#define RECORDING_S 10
+#define MIN_BENCH_NS 200000000ULL	// Repeat each step for at least 0.2 s
+#define N GESTURE_TEMPLATE_SAMPLES
+
+typedef struct {
+  uint64_t reads;
+  uint64_t read_bytes;
+  uint64_t writes;
+  uint64_t write_bytes;
+} PersistTraffic;
+
+static const uint32_t DEFAULT_TEMPLATE_S[] = { 20, 80, 140, 200 };
+
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [--trace FILE] [--rate HZ] [--seed N] [--template SECOND]...\n", argv0);
+}
+
+
+
+static PersistTraffic traffic_since(const PersistTraffic *start) {
+  const ShimStats *stats = shim_stats();
+  return (PersistTraffic) {
+    .reads = stats->persist_reads - start->reads,
+    .read_bytes = stats->persist_read_bytes - start->read_bytes,
+    .writes = stats->persist_writes - start->writes,
+    .write_bytes = stats->persist_write_bytes - start->write_bytes,
+  };
+}
+
+
+
+static PersistTraffic traffic_now(void) {
+  PersistTraffic zero = { 0, 0, 0, 0 };
+  return traffic_since(&zero);
+}
+
+
+
+static void print_step(const char *name, uint64_t ns, uint32_t passes, const PersistTraffic *traffic) {
+  printf("%-18s%8.0f ns, %5.1f reads (%4.0f bytes), %4.1f writes (%4.0f bytes)\n", name,
+         (double)ns / passes, (double)traffic->reads / passes, (double)traffic->read_bytes / passes,
+         (double)traffic->writes / passes, (double)traffic->write_bytes / passes);
+}
+
+
+
+int main(int argc, char **argv) {
+  const char *trace_path = NULL;
+  uint32_t rate_hz = 25;
+  uint32_t seed = 0;
+  uint32_t template_s[GESTURE_STORE_MAX_TEMPLATES];
+  uint32_t num_template_s = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "--trace") == 0) && (i + 1 < argc)) {
+      trace_path = argv[++i];
+    } else if ((strcmp(argv[i], "--rate") == 0) && (i + 1 < argc)) {
+      rate_hz = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--seed") == 0) && (i + 1 < argc)) {
+      seed = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--template") == 0) && (i + 1 < argc) &&
+               (num_template_s < GESTURE_STORE_MAX_TEMPLATES)) {
+      template_s[num_template_s++] = (uint32_t)atoi(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (num_template_s == 0) {
+    num_template_s = ARRAY_LENGTH(DEFAULT_TEMPLATE_S);
+    memcpy(template_s, DEFAULT_TEMPLATE_S, sizeof(DEFAULT_TEMPLATE_S));
+  }
+
+  Trace trace;
+  if (trace_path) {
+    if (!trace_load(&trace, trace_path, rate_hz)) {
+      fprintf(stderr, "%s: cannot read trace %s\n", argv[0], trace_path);
+      return 1;
+    }
+    printf("trace:            %s, %u samples @ %u Hz\n", trace_path, trace.num_samples, trace.rate_hz);
+  } else {
+    trace_synthesize(&trace, DEFAULT_SYNTHETIC_S, rate_hz, seed);
+    printf("trace:            synthetic, %u samples @ %u Hz\n", trace.num_samples, trace.rate_hz);
+  }
+
+  // Templates as the app makes them
+  static GestureRecognizer rec;
+  static GestureBuffer recording;
+  gesture_recognizer_init(&rec);
+  for (uint32_t t = 0; t < num_template_s; t++) {
+    uint32_t first = template_s[t] * trace.rate_hz;
+    uint32_t count = RECORDING_S * trace.rate_hz;
+    if (first + count > trace.num_samples) {
+      fprintf(stderr, "%s: no %u s recording at %u s in the trace\n", argv[0], RECORDING_S, template_s[t]);
+      return 1;
+    }
+    gesture_buffer_init(&recording);
+    for (uint32_t i = first; i < first + count; i++) {
+      AccelData sample = { .x = trace.samples[i].x, .y = trace.samples[i].y, .z = trace.samples[i].z };
+      gesture_buffer_push(&recording, &sample);
+    }
+    gesture_recognizer_add(&rec, &recording);
+  }
+
+  // Save: the last template is saved and deleted again on every pass
+  GestureStore store;
+  shim_persist_clear();
+  gesture_store_open(&store);
+  for (uint32_t t = 0; t + 1 < rec.num_templates; t++) {
+    gesture_store_save(&store, rec.templates[t].axes, NULL);
+  }
+  const GestureTemplate *last = &rec.templates[rec.num_templates - 1];
+  uint32_t passes = 0;
+  uint64_t ns = 0;
+  PersistTraffic traffic = { 0, 0, 0, 0 };
+  do {
+    PersistTraffic start = traffic_now();
+    uint64_t start_ns = shim_clock_ns();
+    int saved = gesture_store_save(&store, last->axes, NULL);
+    ns += shim_clock_ns() - start_ns;
+    PersistTraffic step = traffic_since(&start);
+    traffic.writes += step.writes;
+    traffic.write_bytes += step.write_bytes;
+    passes++;
+    if (saved < 0) {
+      fprintf(stderr, "%s: save failed\n", argv[0]);
+      return 1;
+    }
+    gesture_store_delete(&store, saved);
+  } while (ns < MIN_BENCH_NS);
+  gesture_store_save(&store, last->axes, NULL);
+
+  uint32_t encoded_bytes = 0;
+  uint32_t chunks = 0;
+  for (uint32_t t = 0; t < store.count; t++) {
+    encoded_bytes += store.entries[t].bytes;
+    chunks += store.entries[t].num_chunks;
+  }
+  printf("library:          %u templates, %u bytes encoded (%.0f each, %u raw), %u chunks, %u of %d bytes used\n",
+         store.count, encoded_bytes, (double)encoded_bytes / store.count, (unsigned)sizeof(last->axes), chunks,
+         shim_stats()->persist_bytes, SHIM_PERSIST_BYTES);
+  print_step("save:", ns, passes, &traffic);
+
+  // Open, as at startup: the index only
+  passes = 0;
+  ns = 0;
+  PersistTraffic start = traffic_now();
+  do {
+    GestureStore opened;
+    uint64_t start_ns = shim_clock_ns();
+    gesture_store_open(&opened);
+    ns += shim_clock_ns() - start_ns;
+    passes++;
+  } while (ns < MIN_BENCH_NS);
+  traffic = traffic_since(&start);
+  print_step("open (index):", ns, passes, &traffic);
+
+  // Load every template, as the first recognition does
+  static int16_t axes[GESTURE_STORE_MAX_TEMPLATES][GESTURE_AXES][N];
+  bool loaded = true;
+  passes = 0;
+  ns = 0;
+  start = traffic_now();
+  do {
+    uint64_t start_ns = shim_clock_ns();
+    for (uint8_t t = 0; t < store.count; t++) {
+      loaded &= gesture_store_load(&store, t, axes[t]);
+    }
+    ns += shim_clock_ns() - start_ns;
+    passes++;
+  } while (ns < MIN_BENCH_NS);
+  traffic = traffic_since(&start);
+  print_step("load (all):", ns, passes, &traffic);
+
+  int max_error = 0;
+  for (uint8_t t = 0; t < store.count; t++) {
+    for (int axis = 0; axis < GESTURE_AXES; axis++) {
+      for (int i = 0; i < N; i++) {
+        int error = abs(axes[t][axis][i] - rec.templates[t].axes[axis][i]);
+        max_error = (error > max_error) ? error : max_error;
+      }
+    }
+  }
+  bool exact = loaded && (max_error <= GESTURE_STORE_QUANT_MG / 2);
+  printf("round trip:       max error %d mg (quantum %d mg), %s\n", max_error, GESTURE_STORE_QUANT_MG,
+         exact ? "ok" : "MISMATCH");
+
+  // A flipped bit in a chunk must be caught
+  uint8_t chunk[PERSIST_DATA_MAX_LENGTH];
+  uint32_t key = GESTURE_STORE_CHUNK_KEY(store.entries[0].id, 0);
+  int length = persist_read_data(key, chunk, sizeof(chunk));
+  chunk[length / 2] ^= 0x10;
+  persist_write_data(key, chunk, length);
+  bool refused = !gesture_store_load(&store, 0, axes[0]);
+  printf("damaged chunk:    %s\n", refused ? "refused" : "ACCEPTED");
+
+  trace_free(&trace);
+  return (exact && refused) ? 0 : 1;
+}
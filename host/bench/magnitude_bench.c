@@ -0,0 +1,221 @@
+/*
+* Per-sample cost of SeizeAlert's magnitude test.
+*
+* Compares, on the same trace, the FSM's three band decisions
+* (step-one band, >= STEP_TWO_LOWER_BOUND, >= STEP_THREE_HIGHER_BOUND)
+* computed three ways:
+*
+*   my_sqrt   the original float Newton square root
+*   isqrt     integer square root, then the same integer deviation
+*   squared   m2 against compile-time squared band edges (accel_magnitude.h)
+*   edges     m2 against the runtime edges the detector uses (what ships)
+*
+* and counts samples where a variant disagrees with my_sqrt.
+*
+*   magnitude_bench [--trace FILE] [--rate HZ] [--synthetic SECONDS] [--passes N]
+*/
+
+#include <pebble.h>
+
+#include "detector.h"
+#include "shim.h"
+
+#define BAND_STEP_ONE (1 << 0)
+#define BAND_STEP_TWO (1 << 1)
+#define BAND_STEP_THREE (1 << 2)
+
+typedef uint32_t (*BandFunction)(int x, int y, int z);
+
+
+/*
+	Custom square root function, verbatim from
+	SeizeAlert before the integer rewrite.
+*/
+float my_sqrt(const float num) {
+  const uint MAX_STEPS = 40;
+  const float MAX_ERROR = 0.001;
+
+  float answer = num;
+  float ans_sqr = answer * answer;
+  uint step = 0;
+  while((ans_sqr - num > MAX_ERROR) && (step++ < MAX_STEPS)) {
+    answer = (answer + (num / answer)) / 2;
+    ans_sqr = answer * answer;
+  }
+  return answer;
+}
+
+
+
+static uint32_t bands_from_test(int test) {
+  uint32_t bands = 0;
+  if ((test >= STEP_ONE_LOWER_BOUND) && (test <= STEP_ONE_HIGHER_BOUND)) bands |= BAND_STEP_ONE;
+  if (test >= STEP_TWO_LOWER_BOUND) bands |= BAND_STEP_TWO;
+  if (test >= STEP_THREE_HIGHER_BOUND) bands |= BAND_STEP_THREE;
+  return bands;
+}
+
+
+
+static uint32_t bands_my_sqrt(int x, int y, int z) {
+  x = x * x;
+  y = y * y;
+  z = z * z;
+  return bands_from_test((int)(abs(my_sqrt(x + y + z)-1000)));
+}
+
+
+
+/*
+	Bit-by-bit integer square root, floor(sqrt(v)).
+*/
+static uint32_t isqrt32(uint32_t v) {
+  uint32_t root = 0;
+  uint32_t bit = 1u << 30;
+  while (bit > v) {
+    bit >>= 2;
+  }
+  while (bit) {
+    if (v >= root + bit) {
+      v -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+
+
+static uint32_t bands_isqrt(int x, int y, int z) {
+  uint32_t m2 = ACCEL_MAGNITUDE_SQUARED(x, y, z);
+  uint32_t root = isqrt32(m2);
+  int test;
+  if (root >= ACCEL_ONE_G) {
+    test = (int)root - ACCEL_ONE_G;
+  } else {
+    test = ACCEL_ONE_G - (int)((root * root == m2) ? root : root + 1);	// 1000 - ceil(sqrt(m2))
+  }
+  return bands_from_test(test);
+}
+
+
+
+static uint32_t bands_squared(int x, int y, int z) {
+  uint32_t m2 = ACCEL_MAGNITUDE_SQUARED(x, y, z);
+  uint32_t bands = 0;
+  if (ACCEL_DEVIATION_AT_LEAST(m2, STEP_ONE_LOWER_BOUND) && ACCEL_DEVIATION_AT_MOST(m2, STEP_ONE_HIGHER_BOUND)) bands |= BAND_STEP_ONE;
+  if (ACCEL_DEVIATION_AT_LEAST(m2, STEP_TWO_LOWER_BOUND)) bands |= BAND_STEP_TWO;
+  if (ACCEL_DEVIATION_AT_LEAST(m2, STEP_THREE_HIGHER_BOUND)) bands |= BAND_STEP_THREE;
+  return bands;
+}
+
+
+
+static AccelDeviationEdges s_edges[4];
+
+static uint32_t bands_edges(int x, int y, int z) {
+  uint32_t m2 = ACCEL_MAGNITUDE_SQUARED(x, y, z);
+  uint32_t bands = 0;
+  if (accel_deviation_at_least(m2, s_edges[0]) && !accel_deviation_at_least(m2, s_edges[1])) bands |= BAND_STEP_ONE;
+  if (accel_deviation_at_least(m2, s_edges[2])) bands |= BAND_STEP_TWO;
+  if (accel_deviation_at_least(m2, s_edges[3])) bands |= BAND_STEP_THREE;
+  return bands;
+}
+
+
+
+static void run(const char *name, BandFunction bands, const Trace *trace, uint32_t passes, double reference_ns) {
+  uint32_t checksum = 0;
+  uint64_t mismatches = 0;
+
+  for (uint32_t i = 0; i < trace->num_samples; i++) {
+    const TraceSample *s = &trace->samples[i];
+    if (bands(s->x, s->y, s->z) != bands_my_sqrt(s->x, s->y, s->z)) {
+      mismatches++;
+    }
+  }
+
+  uint64_t start_ns = shim_clock_ns();
+  for (uint32_t pass = 0; pass < passes; pass++) {
+    for (uint32_t i = 0; i < trace->num_samples; i++) {
+      const TraceSample *s = &trace->samples[i];
+      checksum += bands(s->x, s->y, s->z);
+    }
+  }
+  uint64_t elapsed_ns = shim_clock_ns() - start_ns;
+  double ns_per_sample = (double)elapsed_ns / ((double)passes * trace->num_samples);
+
+  printf("  %-8s %8.2f ns/sample %8.2fx  %llu mismatches  (checksum %u)\n", name, ns_per_sample,
+         reference_ns / ns_per_sample, (unsigned long long)mismatches, checksum);
+}
+
+
+
+static double time_reference(const Trace *trace, uint32_t passes) {
+  uint32_t checksum = 0;
+  uint64_t start_ns = shim_clock_ns();
+  for (uint32_t pass = 0; pass < passes; pass++) {
+    for (uint32_t i = 0; i < trace->num_samples; i++) {
+      const TraceSample *s = &trace->samples[i];
+      checksum += bands_my_sqrt(s->x, s->y, s->z);
+    }
+  }
+  uint64_t elapsed_ns = shim_clock_ns() - start_ns;
+  double ns_per_sample = (double)elapsed_ns / ((double)passes * trace->num_samples);
+  printf("  %-8s %8.2f ns/sample %8.2fx  reference     (checksum %u)\n", "my_sqrt", ns_per_sample, 1.0, checksum);
+  return ns_per_sample;
+}
+
+
+
+int main(int argc, char **argv) {
+  const char *trace_path = NULL;
+  uint32_t rate_hz = 25;
+  uint32_t synthetic_s = 60 * 60;
+  uint32_t passes = 10;
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "--trace") == 0) && (i + 1 < argc)) {
+      trace_path = argv[++i];
+    } else if ((strcmp(argv[i], "--rate") == 0) && (i + 1 < argc)) {
+      rate_hz = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--synthetic") == 0) && (i + 1 < argc)) {
+      synthetic_s = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--passes") == 0) && (i + 1 < argc)) {
+      passes = (uint32_t)atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--trace FILE] [--rate HZ] [--synthetic SECONDS] [--passes N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  Trace trace;
+  if (trace_path) {
+    if (!trace_load(&trace, trace_path, rate_hz)) {
+      fprintf(stderr, "%s: cannot read trace %s\n", argv[0], trace_path);
+      return 1;
+    }
+  } else {
+    trace_synthesize(&trace, synthetic_s, rate_hz, 0);
+  }
+  if (passes == 0) {
+    passes = 1;
+  }
+
+  printf("magnitude test, %u samples x %u passes\n", trace.num_samples, passes);
+  double reference_ns = time_reference(&trace, passes);
+  run("isqrt", bands_isqrt, &trace, passes, reference_ns);
+  run("squared", bands_squared, &trace, passes, reference_ns);
+
+  s_edges[0] = accel_deviation_edges(STEP_ONE_LOWER_BOUND);
+  s_edges[1] = accel_deviation_edges(STEP_ONE_HIGHER_BOUND + 1);
+  s_edges[2] = accel_deviation_edges(STEP_TWO_LOWER_BOUND);
+  s_edges[3] = accel_deviation_edges(STEP_THREE_HIGHER_BOUND);
+  run("edges", bands_edges, &trace, passes, reference_ns);
+
+  trace_free(&trace);
+  return 0;
+}
@@ -0,0 +1,124 @@
+/*
+* SeizeAlert's scheduler across wall clock steps.
+*
+* Runs SeizeAlert's false alarm countdown on scheduler.h (a 1 s task with
+* COUNTDOWN_SLACK_MS of slack, COUNTDOWN_RUNS runs) next to its minute log
+* flush, polled from 1 s accelerometer batches as the app does, and sets the
+* shim's wall clock by --step MS (negative: back) --step-at MS into the trace,
+* while the countdown is running, as a sync with the phone, a time zone
+* change or the end of DST would. Every countdown run must come one period
+* after the one before, give or take the slack and SCHEDULER_MAX_LATE_MS,
+* whatever the clock did.
+*
+*   scheduler_bench [--step MS] [--step-at MS] [--timer-jitter MS]
+*/
+
+#include "shim.h"
+#include "scheduler.h"
+
+#define TRACE_S 60
+#define COUNTDOWN_AT_MS 5000
+#define COUNTDOWN_PERIOD_MS 1000
+#define COUNTDOWN_SLACK_MS 100		// As SeizeAlert.c's
+#define COUNTDOWN_RUNS 10
+#define LOG_FLUSH_PERIOD_MS (60 * 1000)
+
+enum {
+  TASK_START = 0,
+  TASK_COUNTDOWN,
+  TASK_LOG_FLUSH,
+};
+
+static Scheduler s_scheduler;
+static uint64_t s_runs_ms[COUNTDOWN_RUNS];
+static uint32_t s_runs;
+
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [--step MS] [--step-at MS] [--timer-jitter MS]\n", argv0);
+}
+
+
+
+static void countdown_callback(void *data) {
+  s_runs_ms[s_runs++] = shim_now_ms();
+  if (s_runs == COUNTDOWN_RUNS) {
+    scheduler_cancel(&s_scheduler, TASK_COUNTDOWN);
+  }
+}
+
+
+
+static void start_callback(void *data) {
+  scheduler_set(&s_scheduler, TASK_COUNTDOWN, COUNTDOWN_PERIOD_MS, COUNTDOWN_PERIOD_MS, COUNTDOWN_SLACK_MS,
+                countdown_callback, NULL);
+}
+
+
+
+static void flush_callback(void *data) {
+}
+
+
+
+static void accel_handler(AccelData *data, uint32_t num_samples) {
+  scheduler_poll(&s_scheduler);
+}
+
+
+
+int main(int argc, char **argv) {
+  int64_t step_ms = -60 * 60 * 1000;
+  uint64_t step_at_ms = COUNTDOWN_AT_MS + 2500;
+  ShimJitter jitter = { 0, 0, 1 };
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "--step") == 0) && (i + 1 < argc)) {
+      step_ms = atoll(argv[++i]);
+    } else if ((strcmp(argv[i], "--step-at") == 0) && (i + 1 < argc)) {
+      step_at_ms = (uint64_t)atoll(argv[++i]);
+    } else if ((strcmp(argv[i], "--timer-jitter") == 0) && (i + 1 < argc)) {
+      jitter.timer_ms = (uint32_t)atoi(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  Trace trace;
+  trace_synthesize_event(&trace, TRACE_EVENT_REST, TRACE_S, 25, 1);
+  shim_set_trace(&trace);
+  shim_set_jitter(jitter);
+  shim_schedule_clock_step(step_at_ms, step_ms);
+
+  scheduler_init(&s_scheduler);
+  scheduler_set(&s_scheduler, TASK_START, COUNTDOWN_AT_MS, 0, 0, start_callback, NULL);
+  scheduler_set(&s_scheduler, TASK_LOG_FLUSH, LOG_FLUSH_PERIOD_MS, LOG_FLUSH_PERIOD_MS, SCHEDULER_MAX_SLACK_MS,
+                flush_callback, NULL);
+  accel_data_service_subscribe(25, accel_handler);
+  app_event_loop();
+  accel_data_service_unsubscribe();
+
+  printf("clock step:       %+lld ms at %.2f s\n", (long long)step_ms, step_at_ms / 1000.0);
+  printf("countdown:        %u of %d runs, wakeups %u, runs %u (%u shared)\n", s_runs, COUNTDOWN_RUNS,
+         s_scheduler.wakeups, s_scheduler.runs, s_scheduler.shared);
+  scheduler_deinit(&s_scheduler);
+  trace_free(&trace);
+
+  int32_t min_ms = COUNTDOWN_PERIOD_MS - COUNTDOWN_SLACK_MS - SCHEDULER_MAX_LATE_MS;
+  int32_t max_ms = COUNTDOWN_PERIOD_MS + COUNTDOWN_SLACK_MS + SCHEDULER_MAX_LATE_MS + (SHIM_JITTER_CAP * jitter.timer_ms);
+  uint32_t off = 0;
+  for (uint32_t i = 0; i < s_runs; i++) {
+    int32_t interval_ms = (int32_t)(s_runs_ms[i] - (i ? s_runs_ms[i - 1] : COUNTDOWN_AT_MS));
+    printf("  run %2u at %6.2f s, %4d ms after the one before\n", i + 1, s_runs_ms[i] / 1000.0, interval_ms);
+    if ((interval_ms < min_ms) || (interval_ms > max_ms)) {
+      off++;
+    }
+  }
+  if ((s_runs != COUNTDOWN_RUNS) || off) {
+    fprintf(stderr, "%s: the countdown ran %u of %d times, %u outside %d .. %d ms of the one before\n", argv[0],
+            s_runs, COUNTDOWN_RUNS, off, min_ms, max_ms);
+    return 1;
+  }
+  return 0;
+}
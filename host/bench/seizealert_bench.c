@@ -0,0 +1,499 @@
+/*
+* SeizeAlert host benchmark.
+*
+* Replays an accelerometer trace through the unmodified Picasso/SeizeAlert
+* app and reports what the detection path costs per sample.
+*
+*   seizealert_bench [--trace FILE] [--rate HZ] [--synthetic SECONDS] [--seed N]
+*                    [--night-at SECONDS] [--timer-jitter MS] [--sample-jitter MS]
+*                    [--verbose]
+*
+* Without --trace a synthetic trace is generated (one scripted fall, walk
+* or shake per minute). The seizure detector is also run on its own over
+* the trace, one hop at a time, to report what each analysed window costs.
+* On synthetic traces, the countdowns the app logged are matched with the
+* scripted falls to report the detection latency, and the black box
+* windows logged with the falls are decoded and measured.
+*
+* --night-at pushes detection profiles (detector_profile.h) over AppMessage
+* at that point of the trace, as the phone would: first one that must be
+* rejected, then a high-sensitivity night profile that is stored and made
+* active, then the same night profile a second later, which must cost no
+* persist write. The replies are checked, and a standalone fall detector
+* measures what a swap costs and checks that swapping leaves the detection
+* as it is.
+*
+* --timer-jitter and --sample-jitter make the shim late with app timers
+* (mean MS, exponential) and early or late with each batched sample (up
+* to MS), as the watch is under load (shim_set_jitter()). The interval
+* histogram the app keeps (jitter.h) is dumped by an UP click at the end of
+* the trace and printed, whether there was jitter or not.
+*
+* seizealert_bench_fixed is the app sampling at 25 Hz all the time
+* (ACCEL_ADAPTIVE_RATE=0), to compare samples and latency with.
+*
+* Built with PROFILE (seizealert_bench_profile), the app's own callback
+* profile is dumped by the same UP click, as on the watch, and printed.
+*/
+
+#include "shim.h"
+#include "seizure_detector.h"
+#include "profile.h"
+#include "event_log.h"
+#include "blackbox.h"
+#include "detector_profile.h"
+#include "jitter.h"
+
+#define DEFAULT_SYNTHETIC_S (60 * 60)
+#define COUNTDOWN_TAG 0xe		// SeizeAlert.c's countdown log
+#define FALL_WINDOW_MS (60 * 1000)	// A countdown this soon after a scripted fall is its detection
+#define NIGHT_SLOT 1
+#define SWAP_BATCH 10			// Samples between two swaps in bench_profile_swap()
+
+static uint32_t s_replies[DETECTOR_PROFILE_STORAGE + 1];	// By DetectorProfileResult
+static int32_t s_reply_active = -1;
+
+
+/*
+	Feeds the trace to a standalone seizure detector
+	in hops, so every timed call analyses one window.
+*/
+static void bench_seizure_detector(const Trace *trace) {
+  SeizureConfig config = SEIZURE_DEFAULT_CONFIG;
+  config.rate_hz = trace->rate_hz;
+  SeizureDetector detector;
+  seizure_detector_init(&detector, &config);
+
+  AccelData hop[SEIZURE_HOP_SAMPLES];
+  SeizureEvent events[SEIZURE_MAX_EVENTS(SEIZURE_HOP_SAMPLES)];
+  uint64_t ns = 0;
+  uint32_t onsets = 0;
+
+  for (uint32_t i = 0; i < trace->num_samples; i += SEIZURE_HOP_SAMPLES) {
+    uint32_t count = trace->num_samples - i;
+    count = (count < SEIZURE_HOP_SAMPLES) ? count : SEIZURE_HOP_SAMPLES;
+    for (uint32_t j = 0; j < count; j++) {
+      const TraceSample *sample = &trace->samples[i + j];
+      hop[j] = (AccelData) { .x = sample->x, .y = sample->y, .z = sample->z };
+    }
+
+    uint64_t start_ns = shim_clock_ns();
+    uint32_t num_events = seizure_detector_feed(&detector, hop, count, events, ARRAY_LENGTH(events));
+    ns += shim_clock_ns() - start_ns;
+
+    for (uint32_t j = 0; j < num_events && j < ARRAY_LENGTH(events); j++) {
+      onsets += (events[j].type == SEIZURE_EVENT_ONSET);
+    }
+  }
+
+  printf("seizure detector: %u windows, %.1f ns/window, %.1f ns/sample, %u onsets\n",
+         detector.windows, detector.windows ? (double)ns / detector.windows : 0.0,
+         trace->num_samples ? (double)ns / trace->num_samples : 0.0, onsets);
+}
+
+
+
+static uint32_t get_le(const uint8_t *in, int bytes) {
+  uint32_t value = 0;
+  for (int i = 0; i < bytes; i++) {
+    value |= (uint32_t)in[i] << (8 * i);
+  }
+  return value;
+}
+
+
+
+/*
+	Reads the countdown records back from the data
+	logging spool and reports how long after each
+	scripted fall its countdown started.
+*/
+static void report_fall_latency(FILE *spool, const Trace *trace) {
+  uint8_t header[SHIM_SPOOL_HEADER_BYTES];
+  uint8_t item[UINT16_MAX];
+  uint32_t fall = 0;
+  uint32_t detected = 0;
+  uint64_t total_ms = 0;
+  uint64_t max_ms = 0;
+
+  rewind(spool);
+  while (fread(header, sizeof(header), 1, spool) == 1) {
+    uint32_t tag = get_le(&header[0], 4);
+    uint32_t item_length = get_le(&header[4], 2);
+    uint32_t num_items = get_le(&header[6], 4);
+    for (uint32_t i = 0; i < num_items; i++) {
+      if ((item_length > 0) && (fread(item, item_length, 1, spool) != 1)) {
+        return;
+      }
+      if ((tag != COUNTDOWN_TAG) || (item_length != sizeof(EventRecord))) {
+        continue;
+      }
+      EventRecord record;
+      memcpy(&record, item, sizeof(record));
+      uint64_t at_ms = ((uint64_t)(record.time - SHIM_START_TIME) * 1000) + record.time_ms;
+      while ((fall < trace->num_falls) && (at_ms >= trace_synthetic_fall_ms(fall) + FALL_WINDOW_MS)) {
+        fall++;
+      }
+      if ((fall < trace->num_falls) && (at_ms >= trace_synthetic_fall_ms(fall))) {
+        uint64_t latency_ms = at_ms - trace_synthetic_fall_ms(fall);
+        total_ms += latency_ms;
+        max_ms = (latency_ms > max_ms) ? latency_ms : max_ms;
+        detected++;
+        fall++;
+      }
+    }
+  }
+  printf("falls:            %u of %u detected, countdown %.2f s after the fall on average, %.2f s max\n",
+         detected, trace->num_falls, detected ? total_ms / 1000.0 / detected : 0.0, max_ms / 1000.0);
+}
+
+
+
+/*
+	Decodes the black box windows in the spool and
+	reports how much motion around the trigger they
+	hold and what it took to log it.
+*/
+static void report_blackbox(FILE *spool) {
+  uint8_t header[SHIM_SPOOL_HEADER_BYTES];
+  uint8_t *bytes = NULL;
+  uint32_t num_bytes = 0;
+
+  rewind(spool);
+  while (fread(header, sizeof(header), 1, spool) == 1) {
+    uint32_t tag = get_le(&header[0], 4);
+    uint32_t length = get_le(&header[4], 2) * get_le(&header[6], 4);
+    uint8_t *at = NULL;
+    if (tag == BLACKBOX_TAG) {
+      bytes = realloc(bytes, num_bytes + length);
+      at = &bytes[num_bytes];
+      num_bytes += length;
+    }
+    if ((length > 0) && (at ? (fread(at, length, 1, spool) != 1) : (fseek(spool, length, SEEK_CUR) != 0))) {
+      break;
+    }
+  }
+
+  uint32_t windows = 0;
+  uint32_t corrupt = 0;
+  uint64_t samples = 0;
+  uint64_t pre_ms = 0;
+  uint64_t post_ms = 0;
+  uint32_t pos = 0;
+  while (pos + sizeof(BlackBoxHeader) <= num_bytes) {
+    BlackBoxHeader window;
+    memcpy(&window, &bytes[pos], sizeof(window));
+    pos += sizeof(window);
+    if (window.magic != BLACKBOX_MAGIC) {
+      corrupt++;
+      break;
+    }
+
+    uint32_t count = 0;
+    uint32_t ms = 0;
+    uint32_t trigger_ms = 0;
+    for (uint32_t b = 0; b < window.num_blocks; b++) {
+      int16_t decoded[ACCEL_CODEC_MAX_SAMPLES * 3];
+      uint32_t num_decoded;
+      uint32_t used = (pos < num_bytes) ? accel_codec_decode(&bytes[pos + 1], num_bytes - pos - 1, decoded,
+                                                                ACCEL_CODEC_MAX_SAMPLES, &num_decoded) : 0;
+      if ((used == 0) || (bytes[pos] == 0)) {
+        corrupt++;
+        count = 0;
+        break;
+      }
+      for (uint32_t i = 0; i < num_decoded; i++, count++) {
+        if (count == window.trigger_sample) {
+          trigger_ms = ms;
+        }
+        ms += 1000 / bytes[pos];
+      }
+      pos += 1 + used;
+    }
+    if (count != window.num_samples) {
+      corrupt += (count != 0);
+      break;
+    }
+    windows++;
+    samples += count;
+    pre_ms += trigger_ms;
+    post_ms += ms - trigger_ms;
+  }
+
+  printf("black box:        %u windows, %.1f s before / %.1f s after the trigger on average, "
+         "%.0f bytes each (%.1fx under int16), %u corrupt\n",
+         windows, windows ? pre_ms / 1000.0 / windows : 0.0, windows ? post_ms / 1000.0 / windows : 0.0,
+         windows ? (double)num_bytes / windows : 0.0, num_bytes ? (samples * 6.0) / num_bytes : 0.0, corrupt);
+  free(bytes);
+}
+
+
+
+/*
+	What the phone would send to store the night
+	profile in NIGHT_SLOT and switch to it: wider
+	free fall band, weaker impact, longer countdown,
+	and 50 Hz all night.
+*/
+static uint16_t write_night_profile(uint8_t *buffer, uint16_t size) {
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, size);
+  dict_write_uint8(&iter, PROFILE_MSG_SLOT, NIGHT_SLOT);
+  dict_write_cstring(&iter, PROFILE_MSG_NAME, "night");
+  dict_write_int32(&iter, PROFILE_MSG_STEP_ONE_LOWER_BOUND, 700);
+  dict_write_int32(&iter, PROFILE_MSG_STEP_ONE_SAMPLES, 3);
+  dict_write_int32(&iter, PROFILE_MSG_STEP_TWO_LOWER_BOUND, 400);
+  dict_write_int32(&iter, PROFILE_MSG_STEP_THREE_HIGHER_BOUND, 150);
+  dict_write_int32(&iter, PROFILE_MSG_ALERT_WINDOW, 20);
+  dict_write_int32(&iter, PROFILE_MSG_SAMPLING_RATE, ACCEL_SAMPLING_50HZ);
+  dict_write_int32(&iter, PROFILE_MSG_ACTIVATE, NIGHT_SLOT);
+  return dict_write_end(&iter);
+}
+
+
+
+// A step three longer than the window holds: must be refused
+static uint16_t write_bad_profile(uint8_t *buffer, uint16_t size) {
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, size);
+  dict_write_uint8(&iter, PROFILE_MSG_SLOT, NIGHT_SLOT);
+  dict_write_int32(&iter, PROFILE_MSG_STEP_THREE_SAMPLES, DETECTOR_MAX_STEP_SAMPLES + 1);
+  dict_write_int32(&iter, PROFILE_MSG_ACTIVATE, NIGHT_SLOT);
+  return dict_write_end(&iter);
+}
+
+
+
+static void outbox_handler(DictionaryIterator *iter) {
+  Tuple *result = dict_find(iter, PROFILE_MSG_RESULT);
+  Tuple *active = dict_find(iter, PROFILE_MSG_ACTIVATE);
+  if (result && (result->value->uint8 < ARRAY_LENGTH(s_replies))) {
+    s_replies[result->value->uint8]++;
+  }
+  if (active) {
+    s_reply_active = active->value->uint8;
+  }
+}
+
+
+
+/*
+	Two fall detectors on the trace in batches: one
+	as is, one swapped to another config and back
+	before every batch, ending each batch on the
+	first config. Both must report the same events.
+	Times the swaps.
+*/
+static void bench_profile_swap(const Trace *trace) {
+  DetectorConfig standard = DETECTOR_DEFAULT_CONFIG;
+  DetectorConfig night = standard;
+  night.step_one_lower_bound = 700;
+  night.step_two_samples = 60;
+  Detector plain, swapped;
+  detector_init(&plain, &standard);
+  detector_init(&swapped, &standard);
+
+  AccelData batch[SWAP_BATCH];
+  DetectorEvent plain_events[DETECTOR_MAX_EVENTS(SWAP_BATCH)];
+  DetectorEvent swapped_events[DETECTOR_MAX_EVENTS(SWAP_BATCH)];
+  uint64_t swaps = 0;
+  uint64_t ns = 0;
+  uint32_t events = 0;
+  uint32_t mismatches = 0;
+
+  for (uint32_t i = 0; i < trace->num_samples; i += SWAP_BATCH) {
+    uint32_t count = trace->num_samples - i;
+    count = (count < SWAP_BATCH) ? count : SWAP_BATCH;
+    for (uint32_t j = 0; j < count; j++) {
+      const TraceSample *sample = &trace->samples[i + j];
+      batch[j] = (AccelData) { .x = sample->x, .y = sample->y, .z = sample->z };
+    }
+
+    uint64_t start_ns = shim_clock_ns();
+    detector_set_config(&swapped, &night);
+    detector_set_config(&swapped, &standard);
+    ns += shim_clock_ns() - start_ns;
+    swaps += 2;
+
+    uint32_t num_plain = detector_feed(&plain, batch, count, plain_events, ARRAY_LENGTH(plain_events));
+    uint32_t num_swapped = detector_feed(&swapped, batch, count, swapped_events, ARRAY_LENGTH(swapped_events));
+    events += num_plain;
+    if ((num_plain != num_swapped) ||
+        (memcmp(plain_events, swapped_events, num_plain * sizeof(DetectorEvent)) != 0)) {
+      mismatches++;
+    }
+  }
+
+  printf("profile swap:     %llu swaps, %.1f ns/swap, %u events, %u batches differ\n",
+         (unsigned long long)swaps, swaps ? (double)ns / swaps : 0.0, events, mismatches);
+}
+
+
+
+/*
+	Prints the last interval histogram the app
+	logged.
+*/
+static void report_jitter(FILE *spool) {
+  uint8_t header[SHIM_SPOOL_HEADER_BYTES];
+  JitterRecord record;
+  bool found = false;
+
+  rewind(spool);
+  while (fread(header, sizeof(header), 1, spool) == 1) {
+    uint32_t tag = get_le(&header[0], 4);
+    uint32_t length = get_le(&header[4], 2) * get_le(&header[6], 4);
+    if ((tag == JITTER_LOG_TAG) && (length == sizeof(record))) {
+      if (fread(&record, sizeof(record), 1, spool) != 1) {
+        break;
+      }
+      found = true;
+    } else if ((length > 0) && (fseek(spool, length, SEEK_CUR) != 0)) {
+      break;
+    }
+  }
+  if (!found) {
+    return;
+  }
+
+  printf("sample intervals: %u, error %d/%.2f/%d ms min/mean/max, %.2f ms rms\n", (unsigned)record.count,
+         record.min_ms, record.mean_us / 1000.0, record.max_ms, record.rms_us / 1000.0);
+  for (int i = 0; i < JITTER_BINS; i++) {
+    if (record.bins[i]) {
+      printf("  %+4d ms %10u\n", (i - JITTER_BINS / 2) * JITTER_BIN_MS, (unsigned)record.bins[i]);
+    }
+  }
+}
+
+
+
+static void report_profiles(void) {
+  const ShimStats *stats = shim_stats();
+  const ShimCallbackStats *message = &stats->callbacks[SHIM_CB_MESSAGE];
+  printf("profiles:         %u stored, %u rejected, active slot %d, %llu persist writes, "
+         "%.1f us/message (store, switch, reply)\n",
+         s_replies[DETECTOR_PROFILE_OK], s_replies[DETECTOR_PROFILE_BAD_SAMPLES], (int)s_reply_active,
+         (unsigned long long)stats->persist_writes, message->calls ? message->ns / 1000.0 / message->calls : 0.0);
+}
+
+
+
+#ifdef PROFILE
+static void print_profile(void) {
+  printf("profile:          calls       min us    avg us    max us   late ms avg/min/max\n");
+  for (int slot = 0; slot < PROFILE_SLOTS; slot++) {
+    const ProfileStats *stats = profile_stats(slot);
+    if (stats->calls == 0) {
+      continue;
+    }
+    printf("  %-12s %10u %10u %9.1f %9u", profile_name(slot), stats->calls, stats->min_us,
+           (double)stats->total_us / stats->calls, stats->max_us);
+    if (stats->expected_calls) {
+      printf("   %.1f/%d/%d", (double)stats->total_late_ms / stats->expected_calls, stats->min_late_ms,
+             stats->max_late_ms);
+    }
+    printf("\n");
+  }
+}
+#endif
+
+
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [--trace FILE] [--rate HZ] [--synthetic SECONDS] [--seed N] [--night-at SECONDS] "
+          "[--timer-jitter MS] [--sample-jitter MS] [--verbose]\n", argv0);
+}
+
+
+
+int main(int argc, char **argv) {
+  const char *trace_path = NULL;
+  uint32_t rate_hz = 25;
+  uint32_t synthetic_s = DEFAULT_SYNTHETIC_S;
+  uint32_t seed = 0;
+  int32_t night_s = -1;
+  ShimJitter jitter = { 0 };
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "--trace") == 0) && (i + 1 < argc)) {
+      trace_path = argv[++i];
+    } else if ((strcmp(argv[i], "--rate") == 0) && (i + 1 < argc)) {
+      rate_hz = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--synthetic") == 0) && (i + 1 < argc)) {
+      synthetic_s = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--seed") == 0) && (i + 1 < argc)) {
+      seed = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--night-at") == 0) && (i + 1 < argc)) {
+      night_s = atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--timer-jitter") == 0) && (i + 1 < argc)) {
+      jitter.timer_ms = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--sample-jitter") == 0) && (i + 1 < argc)) {
+      jitter.sample_ms = (uint32_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--verbose") == 0) {
+      shim_set_verbose(true);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  Trace trace;
+  if (trace_path) {
+    if (!trace_load(&trace, trace_path, rate_hz)) {
+      fprintf(stderr, "%s: cannot read trace %s\n", argv[0], trace_path);
+      return 1;
+    }
+    printf("trace:            %s, %u samples @ %u Hz\n", trace_path, trace.num_samples, trace.rate_hz);
+  } else {
+    trace_synthesize(&trace, synthetic_s, rate_hz, seed);
+    printf("trace:            synthetic, %u samples @ %u Hz, %u falls, %u seizures\n",
+           trace.num_samples, trace.rate_hz, trace.num_falls, trace.num_seizures);
+  }
+
+  FILE *spool = trace_path ? NULL : tmpfile();
+  shim_set_log_spool(spool);
+  shim_set_trace(&trace);
+  jitter.seed = seed + 1;
+  shim_set_jitter(jitter);
+  shim_schedule_click(trace_duration_ms(&trace) - 1, BUTTON_ID_UP);
+  if (night_s >= 0) {
+    uint8_t message[SHIM_MESSAGE_BYTES];
+    shim_schedule_message((uint64_t)night_s * 1000, message, write_bad_profile(message, sizeof(message)));
+    shim_schedule_message((uint64_t)night_s * 1000, message, write_night_profile(message, sizeof(message)));
+    shim_schedule_message((uint64_t)night_s * 1000 + 1000, message, write_night_profile(message, sizeof(message)));
+    shim_set_outbox_handler(outbox_handler);
+  }
+  uint64_t start_ns = shim_clock_ns();
+  pebble_app_main();
+  uint64_t wall_ns = shim_clock_ns() - start_ns;
+
+  shim_report(stdout);
+
+  const ShimStats *stats = shim_stats();
+  uint64_t detector_ns = stats->callbacks[SHIM_CB_TIMER].ns + stats->callbacks[SHIM_CB_ACCEL].ns;
+  uint64_t samples = stats->samples_delivered;
+  if (samples) {
+    double ns_per_sample = (double)detector_ns / samples;
+    printf("detector:         %.1f ns/sample, %.0f samples/s\n",
+           ns_per_sample, ns_per_sample > 0 ? 1e9 / ns_per_sample : 0.0);
+  }
+  if (spool) {
+    report_fall_latency(spool, &trace);
+    report_blackbox(spool);
+    report_jitter(spool);
+    fclose(spool);
+  }
+#ifdef PROFILE
+  print_profile();
+#endif
+  if (night_s >= 0) {
+    report_profiles();
+    bench_profile_swap(&trace);
+  }
+  bench_seizure_detector(&trace);
+  printf("replay:           %.3f s wall, %.0fx real time\n",
+         wall_ns / 1e9, wall_ns ? (stats->simulated_ms * 1e6) / wall_ns : 0.0);
+
+  trace_free(&trace);
+  return 0;
+}
@@ -0,0 +1,165 @@
+/*
+* SeizeAlert watchface benchmark.
+*
+* Replays a synthetic day through the unmodified Picasso/SeizeAlert app with
+* a scripted battery and Bluetooth day on top: the battery drains 1% every
+* 12 minutes, charges from 30% to 100% overnight and drains again, and the
+* phone drops out for 5 minutes every 3 hours. Reports what the watchface
+* costs: frames, layer updates, dirty marks and render time, per hour.
+*
+*   watchface_bench [--hours N] [--seed N] [--events] [--verbose]
+*
+* The wrist rests all day unless --events replays the synthetic trace with
+* its fall, walk or shake every minute (and a fall alert every 3 minutes).
+*/
+
+#include "shim.h"
+
+#define DEFAULT_HOURS 24
+#define HOUR_MS (60ULL * 60 * 1000)
+
+#define DRAIN_STEP_MS (12ULL * 60 * 1000)	// 1% every 12 minutes
+#define CHARGE_STEP_MS (90ULL * 1000)		// 1% every 90 s on the charger
+#define PLUG_AT_MS (14 * HOUR_MS)
+#define UNPLUG_AT_MS (20 * HOUR_MS)
+#define LOW_PERCENT 30
+#define BLUETOOTH_PERIOD_MS (3 * HOUR_MS)
+#define BLUETOOTH_GAP_MS (5ULL * 60 * 1000)
+
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [--hours N] [--seed N] [--events] [--verbose]\n", argv0);
+}
+
+
+
+/*
+	A wrist lying still, a few milli-g of noise.
+*/
+static void rest_trace(Trace *trace, uint32_t seconds, uint32_t rate_hz, uint32_t seed) {
+  memset(trace, 0, sizeof(*trace));
+  trace->rate_hz = rate_hz;
+  trace->num_samples = seconds * rate_hz;
+  trace->samples = calloc(trace->num_samples, sizeof(TraceSample));
+  if (!trace->samples) {
+    trace->num_samples = 0;
+    return;
+  }
+  uint32_t state = seed ? seed : 0x5eed;
+  for (uint32_t i = 0; i < trace->num_samples; i++) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    trace->samples[i] = (TraceSample) {
+      .x = (int16_t)(state % 17) - 8,
+      .y = (int16_t)((state >> 8) % 17) - 8,
+      .z = -1000 + (int16_t)((state >> 16) % 17) - 8,
+    };
+  }
+}
+
+
+
+static BatteryChargeState charge_state(uint8_t percent, bool plugged) {
+  return (BatteryChargeState) {
+    .charge_percent = percent,
+    .is_charging = plugged && (percent < 100),
+    .is_plugged = plugged,
+  };
+}
+
+
+
+/*
+	Schedules one state change per percent, as the
+	firmware reports them.
+*/
+static uint32_t script_battery(uint64_t end_ms) {
+  uint32_t events = 0;
+  uint8_t percent = 100;
+  shim_schedule_battery(0, charge_state(percent, false));
+
+  uint64_t t = DRAIN_STEP_MS;
+  for (; (t < PLUG_AT_MS) && (percent > LOW_PERCENT); t += DRAIN_STEP_MS) {
+    shim_schedule_battery(t, charge_state(--percent, false));
+    events++;
+  }
+  shim_schedule_battery(PLUG_AT_MS, charge_state(percent, true));
+  events++;
+  for (t = PLUG_AT_MS + CHARGE_STEP_MS; (t < UNPLUG_AT_MS) && (percent < 100); t += CHARGE_STEP_MS) {
+    shim_schedule_battery(t, charge_state(++percent, true));
+    events++;
+  }
+  shim_schedule_battery(UNPLUG_AT_MS, charge_state(percent, false));
+  events++;
+  for (t = UNPLUG_AT_MS + DRAIN_STEP_MS; (t < end_ms) && (percent > 0); t += DRAIN_STEP_MS) {
+    shim_schedule_battery(t, charge_state(--percent, false));
+    events++;
+  }
+  return events;
+}
+
+
+
+static uint32_t script_bluetooth(uint64_t end_ms) {
+  uint32_t events = 0;
+  for (uint64_t t = BLUETOOTH_PERIOD_MS; t + BLUETOOTH_GAP_MS < end_ms; t += BLUETOOTH_PERIOD_MS) {
+    shim_schedule_bluetooth(t, false);
+    shim_schedule_bluetooth(t + BLUETOOTH_GAP_MS, true);
+    events += 2;
+  }
+  return events;
+}
+
+
+
+int main(int argc, char **argv) {
+  uint32_t hours = DEFAULT_HOURS;
+  uint32_t seed = 0;
+  bool events = false;
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "--hours") == 0) && (i + 1 < argc)) {
+      hours = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--seed") == 0) && (i + 1 < argc)) {
+      seed = (uint32_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--events") == 0) {
+      events = true;
+    } else if (strcmp(argv[i], "--verbose") == 0) {
+      shim_set_verbose(true);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (hours == 0) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  Trace trace;
+  if (events) {
+    trace_synthesize(&trace, hours * 60 * 60, 25, seed);
+  } else {
+    rest_trace(&trace, hours * 60 * 60, 25, seed);
+  }
+  uint64_t end_ms = trace_duration_ms(&trace);
+  printf("trace:            %s, %u samples @ %u Hz, %u falls\n", events ? "synthetic" : "resting",
+         trace.num_samples, trace.rate_hz, trace.num_falls);
+  uint32_t battery_events = script_battery(end_ms);
+  uint32_t bluetooth_events = script_bluetooth(end_ms);
+  printf("script:           %u battery changes, %u Bluetooth changes\n", battery_events, bluetooth_events);
+
+  shim_set_trace(&trace);
+  pebble_app_main();
+  shim_report(stdout);
+
+  const ShimStats *stats = shim_stats();
+  const ShimCallbackStats *render = &stats->callbacks[SHIM_CB_RENDER];
+  printf("per hour:         %.1f frames, %.1f layer updates, %.1f marks, %.1f us rendering\n",
+         (double)stats->frames_rendered / hours, (double)stats->layer_updates / hours,
+         (double)stats->layers_marked_dirty / hours, render->ns / 1000.0 / hours);
+
+  trace_free(&trace);
+  return 0;
+}
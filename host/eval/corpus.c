@@ -0,0 +1,119 @@
+/*
+* Packed trace corpus, see corpus.h.
+*/
+
+#include "corpus.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/*
+	Writes the traces that loaded, in set order.
+	Returns false if the file cannot be written.
+*/
+bool corpus_write(const TraceSet *set, const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+
+  CorpusHeader header = { .magic = CORPUS_MAGIC, .num_traces = set->num_traces - set->failed };
+  bool ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+  uint64_t first_sample = 0;
+  for (uint32_t i = 0; ok && (i < set->num_traces); i++) {
+    const Trace *trace = &set->traces[i];
+    if (trace->num_samples == 0) {
+      continue;
+    }
+    CorpusEntry entry = {
+      .first_sample = first_sample,
+      .num_samples = trace->num_samples,
+      .rate_hz = trace->rate_hz,
+      .num_labels = trace->num_labels,
+    };
+    const char *name = strrchr(set->paths[i], '/');
+    snprintf(entry.name, sizeof(entry.name), "%s", name ? (name + 1) : set->paths[i]);
+    memcpy(entry.labels, trace->labels, sizeof(entry.labels));
+    ok = (fwrite(&entry, sizeof(entry), 1, file) == 1);
+    first_sample += trace->num_samples;
+  }
+  for (uint32_t i = 0; ok && (i < set->num_traces); i++) {
+    const Trace *trace = &set->traces[i];
+    ok = (fwrite(trace->samples, sizeof(TraceSample), trace->num_samples, file) == trace->num_samples);
+  }
+  return (fclose(file) == 0) && ok;
+}
+
+
+
+/*
+	Maps a corpus_write() file. Returns false if it
+	cannot be mapped or does not hold what its
+	entries say.
+*/
+bool corpus_map(Corpus *corpus, const char *path) {
+  memset(corpus, 0, sizeof(*corpus));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if ((fstat(fd, &st) != 0) || ((size_t)st.st_size < sizeof(CorpusHeader))) {
+    close(fd);
+    return false;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  corpus->map = map;
+  corpus->map_size = st.st_size;
+
+  const CorpusHeader *header = map;
+  size_t entries_end = sizeof(*header) + (size_t)header->num_traces * sizeof(CorpusEntry);
+  if ((memcmp(header->magic, CORPUS_MAGIC, sizeof(header->magic)) != 0) || (entries_end > corpus->map_size)) {
+    corpus_unmap(corpus);
+    return false;
+  }
+  const CorpusEntry *entries = (const CorpusEntry *)(header + 1);
+  const TraceSample *samples = (const TraceSample *)((const uint8_t *)map + entries_end);
+  uint64_t num_samples = (corpus->map_size - entries_end) / sizeof(TraceSample);
+
+  TraceSet *set = &corpus->set;
+  set->num_traces = header->num_traces;
+  set->traces = calloc(set->num_traces ? set->num_traces : 1, sizeof(Trace));
+  set->paths = calloc(set->num_traces ? set->num_traces : 1, sizeof(char *));
+  for (uint32_t i = 0; i < set->num_traces; i++) {
+    const CorpusEntry *entry = &entries[i];
+    if ((entry->first_sample + entry->num_samples > num_samples) || (entry->num_labels > TRACE_MAX_LABELS)) {
+      corpus_unmap(corpus);
+      return false;
+    }
+    Trace *trace = &set->traces[i];
+    trace->samples = (TraceSample *)&samples[entry->first_sample];	// Read-only mapping
+    trace->num_samples = entry->num_samples;
+    trace->rate_hz = entry->rate_hz;
+    trace->num_labels = entry->num_labels;
+    memcpy(trace->labels, entry->labels, sizeof(trace->labels));
+    set->paths[i] = (char *)entry->name;
+  }
+  return true;
+}
+
+
+
+void corpus_unmap(Corpus *corpus) {
+  if (corpus->map) {
+    munmap(corpus->map, corpus->map_size);
+  }
+  free(corpus->set.traces);
+  free(corpus->set.paths);
+  memset(corpus, 0, sizeof(*corpus));
+}
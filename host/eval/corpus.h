@@ -0,0 +1,46 @@
+/*
+* Packed trace corpus, memory-mapped read-only.
+*
+* corpus_write() packs a TraceSet, labels and samples, into one file in
+* host byte order. corpus_map() maps that file read-only and returns a
+* TraceSet whose traces point into the mapping. Every worker then reads
+* the same copy of the samples, and nothing is parsed again.
+*
+*   CorpusHeader
+*   CorpusEntry    one per trace
+*   TraceSample    every trace's samples, one after the other
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include "eval.h"
+
+#define CORPUS_MAGIC "SACORP1"
+#define CORPUS_NAME_BYTES 64
+
+typedef struct {
+  char magic[8];
+  uint32_t num_traces;
+  uint32_t reserved;
+} CorpusHeader;
+
+typedef struct {
+  char name[CORPUS_NAME_BYTES];		// File the trace came from, truncated
+  uint64_t first_sample;		// Index into the samples that follow the entries
+  uint32_t num_samples;
+  uint32_t rate_hz;
+  uint32_t num_labels;
+  TraceLabel labels[TRACE_MAX_LABELS];
+} CorpusEntry;
+
+typedef struct {
+  TraceSet set;				// Traces point into the mapping: do not trace_set_free()
+  void *map;
+  size_t map_size;
+} Corpus;
+
+bool corpus_write(const TraceSet *set, const char *path);
+bool corpus_map(Corpus *corpus, const char *path);
+void corpus_unmap(Corpus *corpus);
@@ -0,0 +1,321 @@
+/*
+* Offline evaluation of SeizeAlert's detectors, see eval.h.
+*/
+
+#include "eval.h"
+
+#include <dirent.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const EvalField EVAL_FIELD_TABLE[EVAL_FIELDS] = {
+  { "step_one_lower_bound", "STEP_ONE_LOWER_BOUND", offsetof(EvalConfig, detector.step_one_lower_bound) },
+  { "step_one_higher_bound", "STEP_ONE_HIGHER_BOUND", offsetof(EvalConfig, detector.step_one_higher_bound) },
+  { "step_one_samples", "STEP_ONE_SAMPLES", offsetof(EvalConfig, detector.step_one_samples) },
+  { "step_two_lower_bound", "STEP_TWO_LOWER_BOUND", offsetof(EvalConfig, detector.step_two_lower_bound) },
+  { "step_two_samples", "STEP_TWO_SAMPLES", offsetof(EvalConfig, detector.step_two_samples) },
+  { "step_three_higher_bound", "STEP_THREE_HIGHER_BOUND", offsetof(EvalConfig, detector.step_three_higher_bound) },
+  { "step_three_samples", "STEP_THREE_SAMPLES", offsetof(EvalConfig, detector.step_three_samples) },
+  { "alert_window", "ALERT_WINDOW", offsetof(EvalConfig, alert_window) },
+};
+
+typedef struct {
+  TraceSet *set;
+  uint32_t rate_hz;
+} LoadJob;
+
+typedef struct {
+  const TraceSet *set;
+  const EvalConfig *config;
+  const SeizureConfig *seizure_config;
+  EvalResult *results;
+} EvalJob;
+
+
+static int skip_hidden(const struct dirent *entry) {
+  return entry->d_name[0] != '.';
+}
+
+
+
+static void load_task(uint32_t index, void *context) {
+  LoadJob *job = context;
+  Trace *trace = &job->set->traces[index];
+  if (!trace_load(trace, job->set->paths[index], job->rate_hz)) {
+    memset(trace, 0, sizeof(*trace));
+  }
+}
+
+
+
+/*
+	Loads every file in dir, in name order, on
+	workers threads. Files that are not traces are
+	counted in set->failed and left empty.
+*/
+bool trace_set_load(TraceSet *set, const char *dir, uint32_t rate_hz, uint32_t workers) {
+  memset(set, 0, sizeof(*set));
+  struct dirent **entries;
+  int count = scandir(dir, &entries, skip_hidden, alphasort);
+  if (count < 0) {
+    return false;
+  }
+
+  set->paths = calloc(count ? count : 1, sizeof(char *));
+  set->traces = calloc(count ? count : 1, sizeof(Trace));
+  for (int i = 0; i < count; i++) {
+    size_t length = strlen(dir) + strlen(entries[i]->d_name) + 2;
+    set->paths[i] = malloc(length);
+    snprintf(set->paths[i], length, "%s/%s", dir, entries[i]->d_name);
+    free(entries[i]);
+  }
+  free(entries);
+  set->num_traces = count;
+
+  LoadJob job = { .set = set, .rate_hz = rate_hz };
+  pool_run(set->num_traces, workers, load_task, &job);
+  for (uint32_t i = 0; i < set->num_traces; i++) {
+    set->failed += (set->traces[i].num_samples == 0);
+  }
+  return true;
+}
+
+
+
+void trace_set_free(TraceSet *set) {
+  for (uint32_t i = 0; i < set->num_traces; i++) {
+    trace_free(&set->traces[i]);
+    free(set->paths[i]);
+  }
+  free(set->traces);
+  free(set->paths);
+  memset(set, 0, sizeof(*set));
+}
+
+
+
+/*
+	Scores a detection at at_ms against the trace's
+	labels of that kind.
+*/
+static void score_detection(const Trace *trace, TraceLabelKind kind, uint32_t at_ms, bool *matched,
+                            EvalResult *result) {
+  EvalScore *score = &result->scores[kind];
+  uint32_t match_ms = (kind == TRACE_LABEL_FALL) ? EVAL_FALL_MATCH_MS : EVAL_SEIZURE_MATCH_MS;
+  for (uint32_t i = 0; i < trace->num_labels; i++) {
+    const TraceLabel *label = &trace->labels[i];
+    if ((label->kind != kind) || (at_ms < label->onset_ms) || (at_ms >= label->onset_ms + match_ms)) {
+      continue;
+    }
+    if (!matched[i]) {
+      uint32_t delay_ms = at_ms - label->onset_ms;
+      matched[i] = true;
+      score->detected++;
+      score->total_delay_ms += delay_ms;
+      score->max_delay_ms = (delay_ms > score->max_delay_ms) ? delay_ms : score->max_delay_ms;
+    }
+    return;		// A repeat inside the label's window is no false alarm either
+  }
+  score->false_alarms++;
+}
+
+
+
+/*
+	Replays one trace. Without a seizure_config only
+	the fall detector runs.
+*/
+void eval_trace(const Trace *trace, const EvalConfig *config, const SeizureConfig *seizure_config,
+                EvalResult *result) {
+  memset(result, 0, sizeof(*result));
+  if (trace->num_samples == 0) {
+    return;
+  }
+  result->duration_ms = trace_duration_ms(trace);
+  result->samples = trace->num_samples;
+  for (uint32_t i = 0; i < trace->num_labels; i++) {
+    result->scores[trace->labels[i].kind].labels++;
+  }
+
+  Detector detector;
+  detector_init(&detector, &config->detector);
+  detector_set_rate(&detector, trace->rate_hz);
+  SeizureDetector seizure_detector;
+  if (seizure_config) {
+    SeizureConfig seizure = *seizure_config;
+    seizure.rate_hz = trace->rate_hz;
+    seizure_detector_init(&seizure_detector, &seizure);
+  }
+
+  bool matched[TRACE_MAX_LABELS] = { false };
+  uint32_t countdown_samples = config->alert_window * trace->rate_hz;
+  uint32_t rearm_at = 0;		// Sample the countdown ends at
+  AccelData batch[EVAL_BATCH_SAMPLES];
+  DetectorEvent events[DETECTOR_MAX_EVENTS(EVAL_BATCH_SAMPLES)];
+  SeizureEvent seizure_events[SEIZURE_MAX_EVENTS(EVAL_BATCH_SAMPLES)];
+
+  for (uint32_t start = 0; start < trace->num_samples; start += EVAL_BATCH_SAMPLES) {
+    uint32_t count = trace->num_samples - start;
+    count = (count < EVAL_BATCH_SAMPLES) ? count : EVAL_BATCH_SAMPLES;
+    for (uint32_t i = 0; i < count; i++) {
+      const TraceSample *sample = &trace->samples[start + i];
+      batch[i] = (AccelData) { .x = sample->x, .y = sample->y, .z = sample->z };
+    }
+
+    if (!detector.armed && (start >= rearm_at)) {
+      detector_set_armed(&detector, true);
+    }
+    uint32_t num_events = detector_feed(&detector, batch, count, events, ARRAY_LENGTH(events));
+    for (uint32_t i = 0; i < num_events; i++) {
+      if (events[i].type == DETECTOR_EVENT_FALL) {
+        uint32_t at = start + events[i].sample;
+        score_detection(trace, TRACE_LABEL_FALL, (uint32_t)(((uint64_t)at * 1000) / trace->rate_hz),
+                        matched, result);
+        detector_set_armed(&detector, false);
+        rearm_at = at + countdown_samples;
+      }
+    }
+
+    if (!seizure_config) {
+      continue;
+    }
+    num_events = seizure_detector_feed(&seizure_detector, batch, count, seizure_events,
+                                       ARRAY_LENGTH(seizure_events));
+    for (uint32_t i = 0; i < num_events; i++) {
+      if (seizure_events[i].type == SEIZURE_EVENT_ONSET) {
+        uint32_t at = start + seizure_events[i].sample;
+        score_detection(trace, TRACE_LABEL_SEIZURE, (uint32_t)(((uint64_t)at * 1000) / trace->rate_hz),
+                        matched, result);
+      }
+    }
+  }
+}
+
+
+
+void eval_add(EvalResult *total, const EvalResult *result) {
+  for (int kind = 0; kind < TRACE_LABEL_KINDS; kind++) {
+    EvalScore *to = &total->scores[kind];
+    const EvalScore *from = &result->scores[kind];
+    to->labels += from->labels;
+    to->detected += from->detected;
+    to->false_alarms += from->false_alarms;
+    to->total_delay_ms += from->total_delay_ms;
+    to->max_delay_ms = (from->max_delay_ms > to->max_delay_ms) ? from->max_delay_ms : to->max_delay_ms;
+  }
+  total->duration_ms += result->duration_ms;
+  total->samples += result->samples;
+}
+
+
+
+static void eval_task(uint32_t index, void *context) {
+  EvalJob *job = context;
+  eval_trace(&job->set->traces[index], job->config, job->seizure_config, &job->results[index]);
+}
+
+
+
+/*
+	Evaluates every trace of the set on workers
+	threads. results (one per trace) may be NULL;
+	total is summed in trace order either way.
+*/
+PoolStats eval_set(const TraceSet *set, const EvalConfig *config, const SeizureConfig *seizure_config,
+                   uint32_t workers, EvalResult *results, EvalResult *total) {
+  EvalResult *own = results ? NULL : calloc(set->num_traces ? set->num_traces : 1, sizeof(EvalResult));
+  EvalJob job = { .set = set, .config = config, .seizure_config = seizure_config, .results = results ? results : own };
+  PoolStats stats = pool_run(set->num_traces, workers, eval_task, &job);
+
+  memset(total, 0, sizeof(*total));
+  for (uint32_t i = 0; i < set->num_traces; i++) {
+    eval_add(total, &job.results[i]);
+  }
+  free(own);
+  return stats;
+}
+
+
+
+double eval_precision(const EvalScore *score) {
+  uint32_t alarms = score->detected + score->false_alarms;
+  return alarms ? (double)score->detected / alarms : 1.0;
+}
+
+
+
+double eval_recall(const EvalScore *score) {
+  return score->labels ? (double)score->detected / score->labels : 1.0;
+}
+
+
+
+double eval_false_alarms_per_day(const EvalScore *score, uint64_t duration_ms) {
+  return duration_ms ? ((double)score->false_alarms * EVAL_DAY_MS) / duration_ms : 0.0;
+}
+
+
+
+double eval_mean_delay_s(const EvalScore *score) {
+  return score->detected ? (score->total_delay_ms / 1000.0) / score->detected : 0.0;
+}
+
+
+
+const EvalField *eval_field(const char *name, size_t length) {
+  for (int i = 0; i < EVAL_FIELDS; i++) {
+    const EvalField *field = &EVAL_FIELD_TABLE[i];
+    if ((strlen(field->name) == length) && (strncmp(field->name, name, length) == 0)) {
+      return field;
+    }
+  }
+  return NULL;
+}
+
+
+
+uint16_t eval_config_get(const EvalConfig *config, const EvalField *field) {
+  uint16_t value;
+  memcpy(&value, (const uint8_t *)config + field->offset, sizeof(value));
+  return value;
+}
+
+
+
+void eval_config_put(EvalConfig *config, const EvalField *field, uint16_t value) {
+  memcpy((uint8_t *)config + field->offset, &value, sizeof(value));
+}
+
+
+
+/*
+	Sets one field from "name=value". Returns false
+	if there is no such field or the value is not
+	a number.
+*/
+bool eval_config_set(EvalConfig *config, const char *assignment) {
+  const char *equals = strchr(assignment, '=');
+  if (!equals) {
+    return false;
+  }
+  char *end;
+  unsigned long value = strtoul(equals + 1, &end, 0);
+  const EvalField *field = eval_field(assignment, equals - assignment);
+  if (!field || (end == equals + 1) || (*end != '\0') || (value > UINT16_MAX)) {
+    return false;
+  }
+  eval_config_put(config, field, (uint16_t)value);
+  return true;
+}
+
+
+
+void eval_config_print(FILE *out, const EvalConfig *config) {
+  for (int i = 0; i < EVAL_FIELDS; i++) {
+    const EvalField *field = &EVAL_FIELD_TABLE[i];
+    fprintf(out, "%s%s=%u", i ? " " : "", field->name, eval_config_get(config, field));
+  }
+  fprintf(out, "\n");
+}
@@ -0,0 +1,96 @@
+/*
+* Offline evaluation of SeizeAlert's detectors on labeled traces.
+*
+* A TraceSet is every trace file in a directory (see trace.h for the
+* format and its "# fall MS" / "# seizure MS" labels; a trace without
+* labels is daily activity). eval_trace() replays one trace through the
+* app's fall and seizure detectors the way SeizeAlert.c drives them:
+* in batches, the fall detector disarmed for the countdown (ALERT_WINDOW)
+* after each fall it reports, the seizure detector always running.
+* An EvalConfig holds what may be changed: the DetectorConfig and the
+* countdown, each field named by an EvalField.
+*
+* A detection up to EVAL_FALL_MATCH_MS (EVAL_SEIZURE_MATCH_MS) after a
+* labeled onset detects that label, once; any other detection is a
+* false alarm.
+*/
+
+#pragma once
+
+#include <pebble.h>
+
+#include "trace.h"
+#include "pool.h"
+#include "detector.h"
+#include "seizure_detector.h"
+
+#define EVAL_BATCH_SAMPLES 10			// SeizeAlert.c's ACCEL_BATCH_SAMPLES
+#ifdef ALERT_WINDOW				// From detector_tuned.h
+#define EVAL_ALERT_WINDOW ALERT_WINDOW
+#else
+#define EVAL_ALERT_WINDOW 10			// detector_profile.h's default
+#endif
+#define EVAL_FALL_MATCH_MS (30 * 1000)
+#define EVAL_SEIZURE_MATCH_MS (60 * 1000)
+#define EVAL_DAY_MS (24ULL * 60 * 60 * 1000)
+
+typedef struct {
+  DetectorConfig detector;
+  uint16_t alert_window;			// Countdown seconds, the fall detector is disarmed
+} EvalConfig;
+
+#define EVAL_DEFAULT_CONFIG ((EvalConfig) {	\
+    .detector = DETECTOR_DEFAULT_CONFIG,	\
+    .alert_window = EVAL_ALERT_WINDOW,		\
+  })
+
+// A uint16_t field of EvalConfig
+typedef struct {
+  const char *name;				// As in the structs
+  const char *macro;				// Its constant, in detector.h or SeizeAlert.c
+  size_t offset;
+} EvalField;
+
+#define EVAL_FIELDS 8
+extern const EvalField EVAL_FIELD_TABLE[EVAL_FIELDS];
+
+typedef struct {
+  uint32_t labels;
+  uint32_t detected;
+  uint32_t false_alarms;
+  uint64_t total_delay_ms;		// Onset to detection, over the detected labels
+  uint32_t max_delay_ms;
+} EvalScore;
+
+typedef struct {
+  EvalScore scores[TRACE_LABEL_KINDS];
+  uint64_t duration_ms;
+  uint64_t samples;
+} EvalResult;
+
+typedef struct {
+  char **paths;
+  Trace *traces;			// num_samples is 0 for the ones that failed to load
+  uint32_t num_traces;
+  uint32_t failed;
+} TraceSet;
+
+bool trace_set_load(TraceSet *set, const char *dir, uint32_t rate_hz, uint32_t workers);
+void trace_set_free(TraceSet *set);
+
+void eval_trace(const Trace *trace, const EvalConfig *config, const SeizureConfig *seizure_config,
+                EvalResult *result);
+PoolStats eval_set(const TraceSet *set, const EvalConfig *config, const SeizureConfig *seizure_config,
+                   uint32_t workers, EvalResult *results, EvalResult *total);
+void eval_add(EvalResult *total, const EvalResult *result);
+
+double eval_precision(const EvalScore *score);
+double eval_recall(const EvalScore *score);
+double eval_false_alarms_per_day(const EvalScore *score, uint64_t duration_ms);
+double eval_mean_delay_s(const EvalScore *score);
+
+const EvalField *eval_field(const char *name, size_t length);
+uint16_t eval_config_get(const EvalConfig *config, const EvalField *field);
+void eval_config_put(EvalConfig *config, const EvalField *field, uint16_t value);
+bool eval_config_set(EvalConfig *config, const char *assignment);
+void eval_config_print(FILE *out, const EvalConfig *config);
@@ -0,0 +1,158 @@
+/*
+* Work-stealing thread pool, see pool.h.
+*/
+
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+  pthread_mutex_t lock;
+  uint32_t begin;		// Next index the owner runs
+  uint32_t end;			// Thieves take from here down
+  uint32_t ran;
+  uint32_t steals;
+} PoolShare;
+
+typedef struct {
+  PoolShare shares[POOL_MAX_WORKERS];
+  uint32_t num_workers;
+  PoolTask task;
+  void *context;
+} Pool;
+
+typedef struct {
+  Pool *pool;
+  uint32_t id;
+} PoolWorker;
+
+
+uint32_t pool_default_workers(void) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cores < 1) {
+    return 1;
+  }
+  return (cores > POOL_MAX_WORKERS) ? POOL_MAX_WORKERS : (uint32_t)cores;
+}
+
+
+
+static bool take(PoolShare *share, uint32_t *index) {
+  pthread_mutex_lock(&share->lock);
+  bool taken = (share->begin < share->end);
+  if (taken) {
+    *index = share->begin++;
+  }
+  pthread_mutex_unlock(&share->lock);
+  return taken;
+}
+
+
+
+/*
+	Moves the back half of the largest other share
+	into the worker's own. Returns false once every
+	share is empty.
+*/
+static bool steal(Pool *pool, uint32_t id) {
+  for (;;) {
+    uint32_t victim = id;
+    uint32_t most = 0;
+    for (uint32_t i = 0; i < pool->num_workers; i++) {
+      PoolShare *share = &pool->shares[i];
+      pthread_mutex_lock(&share->lock);
+      uint32_t left = share->end - share->begin;
+      pthread_mutex_unlock(&share->lock);
+      if ((i != id) && (left > most)) {
+        most = left;
+        victim = i;
+      }
+    }
+    if (most == 0) {
+      return false;
+    }
+
+    PoolShare *from = &pool->shares[victim];
+    uint32_t begin = 0, end = 0;
+    pthread_mutex_lock(&from->lock);
+    uint32_t left = from->end - from->begin;
+    if (left > 0) {
+      end = from->end;
+      begin = end - ((left + 1) / 2);
+      from->end = begin;
+    }
+    pthread_mutex_unlock(&from->lock);
+    if (begin == end) {
+      continue;		// Emptied meanwhile: look again
+    }
+
+    PoolShare *own = &pool->shares[id];
+    pthread_mutex_lock(&own->lock);
+    own->begin = begin;
+    own->end = end;
+    own->steals++;
+    pthread_mutex_unlock(&own->lock);
+    return true;
+  }
+}
+
+
+
+static void *worker_main(void *arg) {
+  PoolWorker *worker = arg;
+  Pool *pool = worker->pool;
+  PoolShare *own = &pool->shares[worker->id];
+  uint32_t index;
+  do {
+    while (take(own, &index)) {
+      pool->task(index, pool->context);
+      own->ran++;
+    }
+  } while (steal(pool, worker->id));
+  return NULL;
+}
+
+
+
+PoolStats pool_run(uint32_t num_tasks, uint32_t num_workers, PoolTask task, void *context) {
+  Pool pool;
+  PoolWorker workers[POOL_MAX_WORKERS];
+  pthread_t threads[POOL_MAX_WORKERS];
+
+  num_workers = (num_workers < 1) ? 1 : ((num_workers > POOL_MAX_WORKERS) ? POOL_MAX_WORKERS : num_workers);
+  memset(&pool, 0, sizeof(pool));
+  pool.num_workers = num_workers;
+  pool.task = task;
+  pool.context = context;
+  for (uint32_t i = 0; i < num_workers; i++) {
+    PoolShare *share = &pool.shares[i];
+    pthread_mutex_init(&share->lock, NULL);
+    share->begin = (uint32_t)(((uint64_t)num_tasks * i) / num_workers);
+    share->end = (uint32_t)(((uint64_t)num_tasks * (i + 1)) / num_workers);
+  }
+
+  // Worker 0 is the calling thread
+  for (uint32_t i = 0; i < num_workers; i++) {
+    workers[i] = (PoolWorker) { .pool = &pool, .id = i };
+  }
+  for (uint32_t i = 1; i < num_workers; i++) {
+    pthread_create(&threads[i], NULL, worker_main, &workers[i]);
+  }
+  worker_main(&workers[0]);
+  for (uint32_t i = 1; i < num_workers; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  PoolStats stats = { .workers = num_workers, .min_tasks = UINT32_MAX };
+  for (uint32_t i = 0; i < num_workers; i++) {
+    PoolShare *share = &pool.shares[i];
+    stats.steals += share->steals;
+    stats.max_tasks = (share->ran > stats.max_tasks) ? share->ran : stats.max_tasks;
+    stats.min_tasks = (share->ran < stats.min_tasks) ? share->ran : stats.min_tasks;
+    pthread_mutex_destroy(&share->lock);
+  }
+  return stats;
+}
@@ -0,0 +1,30 @@
+/*
+* Work-stealing thread pool for the host evaluation tools.
+*
+* pool_run() calls task(index, context) once for every index in
+* [0, num_tasks) on num_workers threads. Each worker starts with a
+* contiguous share of the indices and takes them from the front; a
+* worker that runs out steals the back half of the largest share left,
+* so a few long traces do not leave the other cores idle.
+*
+* Tasks run concurrently: they may only write what belongs to their
+* index (a slot of a results array, say).
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#define POOL_MAX_WORKERS 64
+
+typedef void (*PoolTask)(uint32_t index, void *context);
+
+typedef struct {
+  uint32_t workers;
+  uint32_t steals;
+  uint32_t max_tasks;		// Most tasks one worker ran
+  uint32_t min_tasks;
+} PoolStats;
+
+uint32_t pool_default_workers(void);	// Online cores, at most POOL_MAX_WORKERS
+PoolStats pool_run(uint32_t num_tasks, uint32_t num_workers, PoolTask task, void *context);
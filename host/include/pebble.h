@@ -0,0 +1,431 @@
+/*
+* Host stand-in for the Pebble SDK 2 <pebble.h>.
+*
+* Only the parts of the SDK used by the apps in this repository are
+* declared here. Everything is implemented by shim/pebble_shim.c, which
+* replays recorded (or synthetic) accelerometer traces through the app's
+* callbacks as fast as the host allows, so the watch sources can be
+* built and profiled on Linux without modification.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "pebble_fonts.h"
+#include "resource_ids.auto.h"
+
+
+#define ARRAY_LENGTH(array) (sizeof((array)) / sizeof((array)[0]))
+
+
+/////////////////////////////////////////// Logging /////////////////////////////////////////////
+
+typedef enum {
+  APP_LOG_LEVEL_ERROR = 1,
+  APP_LOG_LEVEL_WARNING = 50,
+  APP_LOG_LEVEL_INFO = 100,
+  APP_LOG_LEVEL_DEBUG = 200,
+  APP_LOG_LEVEL_DEBUG_VERBOSE = 255,
+} AppLogLevel;
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+#define APP_LOG(level, fmt, args...) app_log(level, __FILE__, __LINE__, fmt, ## args)
+
+
+/////////////////////////////////////////// Time /////////////////////////////////////////////
+
+// The watch clock follows the replayed trace, not the host clock.
+time_t shim_time(time_t *tloc);
+#define time(tloc) shim_time(tloc)
+
+uint16_t time_ms(time_t *t_utc, uint16_t *out_ms);
+
+bool clock_is_24h_style(void);
+
+typedef enum {
+  SECOND_UNIT = 1 << 0,
+  MINUTE_UNIT = 1 << 1,
+  HOUR_UNIT = 1 << 2,
+  DAY_UNIT = 1 << 3,
+  MONTH_UNIT = 1 << 4,
+  YEAR_UNIT = 1 << 5,
+} TimeUnits;
+
+typedef void (*TickHandler)(struct tm *tick_time, TimeUnits units_changed);
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler);
+void tick_timer_service_unsubscribe(void);
+
+
+/////////////////////////////////////////// Timers /////////////////////////////////////////////
+
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data);
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer_handle);
+
+
+/////////////////////////////////////////// Accelerometer /////////////////////////////////////////////
+
+typedef struct {
+  int16_t x;
+  int16_t y;
+  int16_t z;
+  bool did_vibrate;
+  uint64_t timestamp;
+} AccelData;
+
+typedef enum {
+  ACCEL_AXIS_X = 0,
+  ACCEL_AXIS_Y = 1,
+  ACCEL_AXIS_Z = 2,
+} AccelAxisType;
+
+typedef enum {
+  ACCEL_SAMPLING_10HZ = 10,
+  ACCEL_SAMPLING_25HZ = 25,
+  ACCEL_SAMPLING_50HZ = 50,
+  ACCEL_SAMPLING_100HZ = 100,
+} AccelSamplingRate;
+
+typedef void (*AccelDataHandler)(AccelData *data, uint32_t num_samples);
+typedef void (*AccelTapHandler)(AccelAxisType axis, int32_t direction);
+
+int accel_service_peek(AccelData *data);
+int accel_service_set_sampling_rate(AccelSamplingRate rate);
+int accel_service_set_samples_per_update(uint32_t num_samples);
+
+void accel_data_service_subscribe(uint32_t samples_per_update, AccelDataHandler handler);
+void accel_data_service_unsubscribe(void);
+
+void accel_tap_service_subscribe(AccelTapHandler handler);
+void accel_tap_service_unsubscribe(void);
+
+
+/////////////////////////////////////////// Data Logging /////////////////////////////////////////////
+
+typedef void *DataLoggingSessionRef;
+
+typedef enum {
+  DATA_LOGGING_BYTE_ARRAY = 0,
+  DATA_LOGGING_UINT = 2,
+  DATA_LOGGING_INT = 3,
+} DataLoggingItemType;
+
+typedef enum {
+  DATA_LOGGING_SUCCESS = 0,
+  DATA_LOGGING_BUSY,
+  DATA_LOGGING_FULL,
+  DATA_LOGGING_NOT_FOUND,
+  DATA_LOGGING_CLOSED,
+  DATA_LOGGING_INVALID_PARAMS,
+} DataLoggingResult;
+
+DataLoggingSessionRef data_logging_create(uint32_t tag, DataLoggingItemType item_type, uint16_t item_length, bool resume);
+void data_logging_finish(DataLoggingSessionRef logging_session);
+DataLoggingResult data_logging_log(DataLoggingSessionRef logging_session, const void *data, uint32_t num_items);
+
+
+/////////////////////////////////////////// Persistent Storage /////////////////////////////////////////////
+
+#define PERSIST_DATA_MAX_LENGTH 256
+#define PERSIST_STRING_MAX_LENGTH PERSIST_DATA_MAX_LENGTH
+
+typedef enum {
+  S_SUCCESS = 0,
+  E_ERROR = -1,
+  E_UNKNOWN = -2,
+  E_INTERNAL = -3,
+  E_INVALID_ARGUMENT = -4,
+  E_OUT_OF_MEMORY = -5,
+  E_OUT_OF_STORAGE = -6,
+  E_OUT_OF_RESOURCES = -7,
+  E_RANGE = -8,
+  E_DOES_NOT_EXIST = -9,
+  E_INVALID_OPERATION = -10,
+  E_BUSY = -11,
+  S_TRUE = 1,
+  S_FALSE = 0,
+  S_NO_MORE_ITEMS = 2,
+  S_NO_ACTION_REQUIRED = 3,
+} StatusCode;
+
+typedef int32_t status_t;
+
+bool persist_exists(const uint32_t key);
+int persist_get_size(const uint32_t key);
+int32_t persist_read_int(const uint32_t key);
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size);
+status_t persist_write_int(const uint32_t key, const int32_t value);
+int persist_write_data(const uint32_t key, const void *data, const size_t size);
+status_t persist_delete(const uint32_t key);
+
+
+/////////////////////////////////////////// Dictionary / App Message /////////////////////////////////////////////
+
+typedef enum {
+  TUPLE_BYTE_ARRAY = 0,
+  TUPLE_CSTRING = 1,
+  TUPLE_UINT = 2,
+  TUPLE_INT = 3,
+} TupleType;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t key;
+  TupleType type:8;
+  uint16_t length;
+  union {
+    uint8_t data[0];
+    char cstring[0];
+    uint8_t uint8;
+    uint16_t uint16;
+    uint32_t uint32;
+    int8_t int8;
+    int16_t int16;
+    int32_t int32;
+  } __attribute__((__packed__)) value[];
+} Tuple;
+
+typedef struct Dictionary Dictionary;
+
+typedef struct {
+  Dictionary *dictionary;
+  const void *end;
+  Tuple *cursor;
+} DictionaryIterator;
+
+typedef enum {
+  DICT_OK = 0,
+  DICT_NOT_ENOUGH_STORAGE = 1 << 1,
+  DICT_INVALID_ARGS = 1 << 2,
+  DICT_INTERNAL_INCONSISTENCY = 1 << 3,
+  DICT_MALLOC_FAILED = 1 << 4,
+} DictionaryResult;
+
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t *const buffer, const uint16_t size);
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t *const data, const uint16_t size);
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key, const char *const cstring);
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key, const void *integer, const uint8_t width_bytes, const bool is_signed);
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value);
+DictionaryResult dict_write_uint16(DictionaryIterator *iter, const uint32_t key, const uint16_t value);
+DictionaryResult dict_write_int8(DictionaryIterator *iter, const uint32_t key, const int8_t value);
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value);
+uint32_t dict_write_end(DictionaryIterator *iter);
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t *const buffer, const uint16_t size);
+Tuple *dict_read_first(DictionaryIterator *iter);
+Tuple *dict_read_next(DictionaryIterator *iter);
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key);
+
+#define APP_MESSAGE_INBOX_SIZE_MINIMUM 124
+#define APP_MESSAGE_OUTBOX_SIZE_MINIMUM 636
+
+typedef enum {
+  APP_MSG_OK = 0,
+  APP_MSG_SEND_TIMEOUT = 1 << 1,
+  APP_MSG_SEND_REJECTED = 1 << 2,
+  APP_MSG_NOT_CONNECTED = 1 << 3,
+  APP_MSG_APP_NOT_RUNNING = 1 << 4,
+  APP_MSG_INVALID_ARGS = 1 << 5,
+  APP_MSG_BUSY = 1 << 6,
+  APP_MSG_BUFFER_OVERFLOW = 1 << 7,
+  APP_MSG_ALREADY_RELEASED = 1 << 9,
+  APP_MSG_CALLBACK_ALREADY_REGISTERED = 1 << 10,
+  APP_MSG_CALLBACK_NOT_REGISTERED = 1 << 11,
+  APP_MSG_OUT_OF_MEMORY = 1 << 12,
+  APP_MSG_CLOSED = 1 << 13,
+  APP_MSG_INTERNAL_ERROR = 1 << 14,
+} AppMessageResult;
+
+typedef void (*AppMessageInboxReceived)(DictionaryIterator *iterator, void *context);
+typedef void (*AppMessageInboxDropped)(AppMessageResult reason, void *context);
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound);
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback);
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback);
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator);
+AppMessageResult app_message_outbox_send(void);
+
+
+/////////////////////////////////////////// Math /////////////////////////////////////////////
+
+#define TRIG_MAX_RATIO 0xffff
+#define TRIG_MAX_ANGLE 0x10000
+
+int32_t sin_lookup(int32_t angle);
+int32_t cos_lookup(int32_t angle);
+
+
+/////////////////////////////////////////// Battery / Bluetooth / Vibes /////////////////////////////////////////////
+
+typedef struct {
+  uint8_t charge_percent;
+  bool is_charging;
+  bool is_plugged;
+} BatteryChargeState;
+
+typedef void (*BatteryStateHandler)(BatteryChargeState charge);
+typedef void (*BluetoothConnectionHandler)(bool connected);
+
+BatteryChargeState battery_state_service_peek(void);
+void battery_state_service_subscribe(BatteryStateHandler handler);
+void battery_state_service_unsubscribe(void);
+
+bool bluetooth_connection_service_peek(void);
+void bluetooth_connection_service_subscribe(BluetoothConnectionHandler handler);
+void bluetooth_connection_service_unsubscribe(void);
+
+void vibes_short_pulse(void);
+void vibes_long_pulse(void);
+void vibes_double_pulse(void);
+
+
+/////////////////////////////////////////// Graphics /////////////////////////////////////////////
+
+typedef struct {
+  int16_t x;
+  int16_t y;
+} GPoint;
+
+typedef struct {
+  int16_t w;
+  int16_t h;
+} GSize;
+
+typedef struct {
+  GPoint origin;
+  GSize size;
+} GRect;
+
+#define GPoint(x, y) ((GPoint){ (x), (y) })
+#define GSize(w, h) ((GSize){ (w), (h) })
+#define GRect(x, y, w, h) ((GRect){ { (x), (y) }, { (w), (h) } })
+
+typedef enum {
+  GColorClear = ~0,
+  GColorBlack = 0,
+  GColorWhite = 1,
+} GColor;
+
+typedef enum {
+  GCornerNone = 0,
+  GCornersAll = 0xf,
+} GCornerMask;
+
+typedef enum {
+  GCompOpAssign,
+  GCompOpAssignInverted,
+  GCompOpOr,
+  GCompOpAnd,
+  GCompOpClear,
+  GCompOpSet,
+} GCompOp;
+
+typedef enum {
+  GTextOverflowModeWordWrap,
+  GTextOverflowModeTrailingEllipsis,
+  GTextOverflowModeFill,
+} GTextOverflowMode;
+
+typedef enum {
+  GTextAlignmentLeft,
+  GTextAlignmentCenter,
+  GTextAlignmentRight,
+} GTextAlignment;
+
+typedef struct GContext GContext;
+typedef struct GBitmap GBitmap;
+typedef struct GFont *GFont;
+typedef void *ResHandle;
+
+ResHandle resource_get_handle(uint32_t resource_id);
+
+GFont fonts_get_system_font(const char *font_key);
+GFont fonts_load_custom_font(ResHandle handle);
+void fonts_unload_custom_font(GFont font);
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id);
+void gbitmap_destroy(GBitmap *bitmap);
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color);
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask);
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect);
+
+
+/////////////////////////////////////////// Layers / Windows /////////////////////////////////////////////
+
+typedef struct Layer Layer;
+typedef struct TextLayer TextLayer;
+typedef struct BitmapLayer BitmapLayer;
+typedef struct Window Window;
+
+typedef void (*LayerUpdateProc)(Layer *layer, GContext *ctx);
+
+Layer *layer_create(GRect frame);
+void layer_destroy(Layer *layer);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+void layer_add_child(Layer *parent, Layer *child);
+void layer_mark_dirty(Layer *layer);
+GRect layer_get_bounds(const Layer *layer);
+void layer_set_hidden(Layer *layer, bool hidden);
+
+TextLayer *text_layer_create(GRect frame);
+void text_layer_destroy(TextLayer *text_layer);
+Layer *text_layer_get_layer(TextLayer *text_layer);
+void text_layer_set_text(TextLayer *text_layer, const char *text);
+void text_layer_set_font(TextLayer *text_layer, GFont font);
+void text_layer_set_text_color(TextLayer *text_layer, GColor color);
+void text_layer_set_background_color(TextLayer *text_layer, GColor color);
+void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode line_mode);
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment);
+
+BitmapLayer *bitmap_layer_create(GRect frame);
+void bitmap_layer_destroy(BitmapLayer *bitmap_layer);
+Layer *bitmap_layer_get_layer(const BitmapLayer *bitmap_layer);
+void bitmap_layer_set_bitmap(BitmapLayer *bitmap_layer, const GBitmap *bitmap);
+
+typedef struct {
+  void (*load)(Window *window);
+  void (*appear)(Window *window);
+  void (*disappear)(Window *window);
+  void (*unload)(Window *window);
+} WindowHandlers;
+
+typedef enum {
+  BUTTON_ID_BACK = 0,
+  BUTTON_ID_UP,
+  BUTTON_ID_SELECT,
+  BUTTON_ID_DOWN,
+  NUM_BUTTONS,
+} ButtonId;
+
+typedef void *ClickRecognizerRef;
+typedef void (*ClickHandler)(ClickRecognizerRef recognizer, void *context);
+typedef void (*ClickConfigProvider)(void *context);
+
+Window *window_create(void);
+void window_destroy(Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+void window_set_click_config_provider(Window *window, ClickConfigProvider click_config_provider);
+void window_set_background_color(Window *window, GColor background_color);
+Layer *window_get_root_layer(const Window *window);
+void window_stack_push(Window *window, bool animated);
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler);
+
+
+/////////////////////////////////////////// App /////////////////////////////////////////////
+
+void app_event_loop(void);
@@ -0,0 +1,5 @@
+/*
+* Resource ids for apps that declare no media in appinfo.json.
+*/
+
+#pragma once
@@ -0,0 +1,15 @@
+/*
+* Resource ids for Picasso/SeizeAlert, in appinfo.json order.
+* The Pebble SDK generates this file at build time; the host build
+* keeps a copy because it does not run the resource compiler.
+*/
+
+#pragma once
+
+#define RESOURCE_ID_IMAGE_MENU_ICON 1
+#define RESOURCE_ID_PEBBLE_LOGO 2
+#define RESOURCE_ID_BATTERY_CHARGE 3
+#define RESOURCE_ID_BATTERY_ICON 4
+#define RESOURCE_ID_BLUETOOTH_ICON 5
+#define RESOURCE_ID_FONT_ROBOTO_CONDENSED_21 6
+#define RESOURCE_ID_FONT_ROBOTO_BOLD_SUBSET_49 7
@@ -0,0 +1,1861 @@
+/*
+* Host implementation of the Pebble SDK subset declared in include/pebble.h.
+*
+* app_event_loop() is a discrete event simulation: it advances a virtual
+* clock to the next due app timer, accelerometer batch, tick, scripted
+* button press or phone message and dispatches it, until the loaded trace is exhausted.
+* Host time spent inside every app callback is accumulated per callback
+* kind so harnesses can report the cost of the code under test.
+*/
+
+#include "shim.h"
+
+#include <math.h>
+#include <stdarg.h>
+
+#undef time
+
+#define SHIM_MAX_TIMERS 32
+#define SHIM_MAX_CLICKS 64
+#define SHIM_MAX_STATE_EVENTS 1024
+#define SHIM_MAX_SESSIONS 16
+#define SHIM_MAX_MESSAGES 64
+#define SHIM_MAX_CLOCK_STEPS 16
+#define SHIM_MAX_BATCH 100
+#define SHIM_NEVER UINT64_MAX
+
+// Taps: an axis jumping this much between two trace samples, at most one
+// per SHIM_TAP_REFRACTORY_MS, like the firmware's shake/tap detector
+#define SHIM_TAP_MG 1000
+#define SHIM_TAP_REFRACTORY_MS 500
+
+// Rough heap cost of SDK objects, so leaks show up in the report
+#define SHIM_FONT_BYTES 2048
+#define SHIM_BITMAP_BYTES 512
+
+//////////////////////////////////////////  Objects  ///////////////////////////////////////////////
+
+struct GContext {
+  GColor stroke_color;
+  GColor fill_color;
+  GCompOp compositing_mode;
+};
+
+struct GBitmap {
+  uint32_t resource_id;
+};
+
+struct GFont {
+  const char *key;
+  uint32_t resource_id;
+  bool custom;
+};
+
+struct Layer {
+  GRect frame;
+  LayerUpdateProc update_proc;
+  Layer *parent;
+  Layer *next;			// Registry of live layers, in creation order
+  bool hidden;
+  bool dirty;
+};
+
+struct TextLayer {
+  Layer layer;
+  const char *text;
+  GFont font;
+  GColor text_color;
+  GColor background_color;
+  GTextOverflowMode overflow_mode;
+  GTextAlignment alignment;
+};
+
+struct BitmapLayer {
+  Layer layer;
+  const GBitmap *bitmap;
+};
+
+struct Window {
+  Layer root;
+  WindowHandlers handlers;
+  ClickConfigProvider click_config_provider;
+  GColor background_color;
+  bool loaded;
+};
+
+typedef struct {
+  uint32_t id;			// 0 = free slot
+  uint64_t deadline_ms;		// With the injected delay
+  uint32_t delay_ms;
+  AppTimerCallback callback;
+  void *data;
+} ShimTimer;
+
+typedef struct {
+  uint64_t at_ms;
+  ButtonId button_id;
+} ShimClick;
+
+// A scripted battery or Bluetooth state change
+typedef struct {
+  uint64_t at_ms;
+  bool bluetooth;
+  bool connected;
+  BatteryChargeState charge;
+} ShimStateEvent;
+
+// The wall clock set at_ms, by step_ms (negative: back)
+typedef struct {
+  uint64_t at_ms;
+  int64_t step_ms;
+} ShimClockStep;
+
+// A scripted message from the phone
+typedef struct {
+  uint64_t at_ms;
+  uint16_t size;
+  uint8_t data[SHIM_MESSAGE_BYTES];
+} ShimMessage;
+
+// Count of the tuples that follow, as on the wire
+struct Dictionary {
+  uint8_t count;
+} __attribute__((__packed__));
+
+typedef struct {
+  bool used;
+  uint32_t key;
+  uint16_t size;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} ShimPersistValue;
+
+typedef struct {
+  bool open;
+  uint32_t tag;
+  DataLoggingItemType item_type;
+  uint16_t item_length;
+  ShimLogTagStats *tag_stats;	// NULL once SHIM_MAX_LOG_TAGS tags are in use
+} ShimSession;
+
+//////////////////////////////////////////  State  ///////////////////////////////////////////////
+
+static const Trace *s_trace;
+static bool s_verbose;
+static ShimJitter s_jitter;
+static uint32_t s_jitter_state = 1;	// xorshift32
+static ShimStats s_stats;
+static uint64_t s_now_ms;
+
+static ShimTimer s_timers[SHIM_MAX_TIMERS];
+static uint32_t s_next_timer_id = 1;
+
+static ShimClick s_clicks[SHIM_MAX_CLICKS];
+static uint32_t s_num_clicks;
+static ClickHandler s_click_handlers[NUM_BUTTONS];
+
+static ShimStateEvent s_state_events[SHIM_MAX_STATE_EVENTS];
+static uint32_t s_num_state_events;
+static uint32_t s_next_state_event;	// Events are kept in time order
+static BatteryChargeState s_battery = { .charge_percent = 80, .is_charging = false, .is_plugged = false };
+static bool s_bluetooth_connected = true;
+
+static ShimSession s_sessions[SHIM_MAX_SESSIONS];
+static uint32_t s_log_busy_every;
+static FILE *s_log_spool;
+
+static ShimPersistValue s_persist[SHIM_PERSIST_MAX_KEYS];
+
+static ShimClockStep s_clock_steps[SHIM_MAX_CLOCK_STEPS];
+static uint32_t s_num_clock_steps;
+
+static ShimMessage s_messages[SHIM_MAX_MESSAGES];
+static uint32_t s_num_messages;
+static uint32_t s_next_message;		// Kept in time order, like state events
+static bool s_app_message_open;
+static uint32_t s_inbox_size;
+static uint32_t s_outbox_size;
+static uint8_t s_inbox[SHIM_MESSAGE_BYTES];
+static uint8_t s_outbox[SHIM_MESSAGE_BYTES];
+static DictionaryIterator s_outbox_iter;
+static bool s_outbox_pending;		// Between app_message_outbox_begin() and _send()
+static AppMessageInboxReceived s_inbox_received;
+static AppMessageInboxDropped s_inbox_dropped;
+static ShimOutboxHandler s_outbox_handler;
+
+static uint32_t s_rate_hz = 25;
+static uint64_t s_stream_origin_ms;	// Time of sample 0 at the current rate
+static uint64_t s_stream_next;		// Next sample index to deliver
+static uint32_t s_samples_per_update = 25;
+static AccelDataHandler s_accel_handler;
+static AccelTapHandler s_tap_handler;
+static uint32_t s_tap_next;		// Trace sample the tap search continues from
+static bool s_tap_found;		// s_tap_next is a tap
+
+static TimeUnits s_tick_units;
+static TickHandler s_tick_handler;
+static uint64_t s_next_tick_ms;
+
+static BatteryStateHandler s_battery_handler;
+static BluetoothConnectionHandler s_bluetooth_handler;
+
+static Layer *s_layers;
+static Window *s_top_window;
+static struct GContext s_gcontext;
+
+
+/////////////////////////////////////////// Bookkeeping /////////////////////////////////////////////
+
+uint64_t shim_clock_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+}
+
+
+
+static void heap_add(int64_t bytes) {
+  s_stats.heap_bytes += bytes;
+  if (s_stats.heap_bytes > s_stats.heap_peak) {
+    s_stats.heap_peak = s_stats.heap_bytes;
+  }
+}
+
+
+
+static void *shim_alloc(size_t size) {
+  void *ptr = calloc(1, size);
+  if (!ptr) {
+    fprintf(stderr, "shim: out of memory\n");
+    abort();
+  }
+  heap_add((int64_t)size);
+  return ptr;
+}
+
+
+
+static void shim_free(void *ptr, size_t size) {
+  if (ptr) {
+    heap_add(-(int64_t)size);
+    free(ptr);
+  }
+}
+
+
+
+#define SHIM_DISPATCH(kind, call) do {			\
+    uint64_t start_ns_ = shim_clock_ns();		\
+    call;						\
+    s_stats.callbacks[kind].ns += shim_clock_ns() - start_ns_;	\
+    s_stats.callbacks[kind].calls++;			\
+  } while (0)
+
+
+/////////////////////////////////////////// Control /////////////////////////////////////////////
+
+void shim_set_trace(const Trace *trace) {
+  s_trace = trace;
+}
+
+
+
+void shim_set_verbose(bool verbose) {
+  s_verbose = verbose;
+}
+
+
+
+void shim_set_jitter(ShimJitter jitter) {
+  s_jitter = jitter;
+  s_jitter_state = jitter.seed ? jitter.seed : 1;
+}
+
+
+
+static uint32_t jitter_random(void) {
+  s_jitter_state ^= s_jitter_state << 13;
+  s_jitter_state ^= s_jitter_state >> 17;
+  s_jitter_state ^= s_jitter_state << 5;
+  return s_jitter_state;
+}
+
+
+
+// Scheduling delay of a timer, exponential with mean timer_ms
+static uint32_t timer_delay_ms(void) {
+  if (s_jitter.timer_ms == 0) {
+    return 0;
+  }
+  double u = (jitter_random() + 1.0) / 4294967297.0;
+  double delay = -log(u) * s_jitter.timer_ms;
+  double cap = (double)s_jitter.timer_ms * SHIM_JITTER_CAP;
+  return (uint32_t)((delay < cap) ? delay : cap);
+}
+
+
+
+/*
+	How early (negative) or late stream sample index
+	is taken, in -sample_ms .. sample_ms. A hash of
+	the index, so a sample keeps its error however
+	often it is looked at.
+*/
+static int32_t sample_error_ms(uint64_t index) {
+  if (s_jitter.sample_ms == 0) {
+    return 0;
+  }
+  uint32_t hash = (uint32_t)(index * 2654435761u) ^ s_jitter.seed;
+  hash ^= hash >> 15;
+  hash *= 2246822519u;
+  hash ^= hash >> 13;
+  return (int32_t)(hash % (2 * s_jitter.sample_ms + 1)) - (int32_t)s_jitter.sample_ms;
+}
+
+
+
+void shim_schedule_click(uint64_t at_ms, ButtonId button_id) {
+  if (s_num_clicks < SHIM_MAX_CLICKS) {
+    s_clicks[s_num_clicks++] = (ShimClick) { .at_ms = at_ms, .button_id = button_id };
+  }
+}
+
+
+
+/*
+	Inserts in time order; events at the same time
+	fire in the order they were scheduled.
+*/
+static void schedule_state_event(ShimStateEvent event) {
+  if (s_num_state_events == SHIM_MAX_STATE_EVENTS) {
+    return;
+  }
+  uint32_t i = s_num_state_events++;
+  while ((i > s_next_state_event) && (s_state_events[i - 1].at_ms > event.at_ms)) {
+    s_state_events[i] = s_state_events[i - 1];
+    i--;
+  }
+  s_state_events[i] = event;
+}
+
+
+
+void shim_schedule_battery(uint64_t at_ms, BatteryChargeState charge) {
+  schedule_state_event((ShimStateEvent) { .at_ms = at_ms, .bluetooth = false, .charge = charge });
+}
+
+
+
+void shim_schedule_bluetooth(uint64_t at_ms, bool connected) {
+  schedule_state_event((ShimStateEvent) { .at_ms = at_ms, .bluetooth = true, .connected = connected });
+}
+
+
+
+/*
+	Delivers a dictionary built with dict_write_begin()
+	.. dict_write_end() to the app's inbox at at_ms.
+	Messages at the same time arrive in the order they
+	were scheduled.
+*/
+void shim_schedule_message(uint64_t at_ms, const uint8_t *dictionary, uint16_t size) {
+  if ((s_num_messages == SHIM_MAX_MESSAGES) || (size > SHIM_MESSAGE_BYTES)) {
+    return;
+  }
+  uint32_t i = s_num_messages++;
+  while ((i > s_next_message) && (s_messages[i - 1].at_ms > at_ms)) {
+    s_messages[i] = s_messages[i - 1];
+    i--;
+  }
+  s_messages[i].at_ms = at_ms;
+  s_messages[i].size = size;
+  memcpy(s_messages[i].data, dictionary, size);
+}
+
+
+
+void shim_schedule_clock_step(uint64_t at_ms, int64_t step_ms) {
+  if (s_num_clock_steps < SHIM_MAX_CLOCK_STEPS) {
+    s_clock_steps[s_num_clock_steps++] = (ShimClockStep) { .at_ms = at_ms, .step_ms = step_ms };
+  }
+}
+
+
+
+void shim_set_outbox_handler(ShimOutboxHandler handler) {
+  s_outbox_handler = handler;
+}
+
+
+
+void shim_set_log_busy(uint32_t every) {
+  s_log_busy_every = every;
+}
+
+
+
+void shim_set_log_spool(FILE *spool) {
+  s_log_spool = spool;
+}
+
+
+
+const ShimStats *shim_stats(void) {
+  return &s_stats;
+}
+
+
+
+uint64_t shim_now_ms(void) {
+  return s_now_ms;
+}
+
+
+/////////////////////////////////////////// Logging / Time /////////////////////////////////////////////
+
+/*
+	Formats every line like the firmware does before
+	sending it to the phone, so APP_LOG costs show up
+	in callback times, but only prints when verbose.
+*/
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...) {
+  char line[256];
+  va_list args;
+  va_start(args, fmt);
+  int length = vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+
+  s_stats.console_lines++;
+  s_stats.console_bytes += (length > 0) ? (uint64_t)length : 0;
+  if (s_verbose) {
+    fprintf(stderr, "[%8llu ms] %s:%d %s\n", (unsigned long long)s_now_ms, src_filename, src_line_number, line);
+  }
+}
+
+
+
+/*
+	Wall clock in ms: simulated time from
+	SHIM_START_TIME, moved by the clock steps
+	scheduled by now.
+*/
+static uint64_t wall_ms(void) {
+  int64_t ms = ((int64_t)SHIM_START_TIME * 1000) + (int64_t)s_now_ms;
+  for (uint32_t i = 0; i < s_num_clock_steps; i++) {
+    if (s_clock_steps[i].at_ms <= s_now_ms) {
+      ms += s_clock_steps[i].step_ms;
+    }
+  }
+  return (uint64_t)ms;
+}
+
+
+
+time_t shim_time(time_t *tloc) {
+  time_t now = (time_t)(wall_ms() / 1000);
+  if (tloc) {
+    *tloc = now;
+  }
+  return now;
+}
+
+
+
+uint16_t time_ms(time_t *t_utc, uint16_t *out_ms) {
+  uint16_t ms = (uint16_t)(wall_ms() % 1000);
+  shim_time(t_utc);
+  if (out_ms) {
+    *out_ms = ms;
+  }
+  return ms;
+}
+
+
+
+bool clock_is_24h_style(void) {
+  return true;
+}
+
+
+
+static uint64_t tick_period_ms(void) {
+  if (s_tick_units & SECOND_UNIT) return 1000;
+  if (s_tick_units & MINUTE_UNIT) return 60 * 1000;
+  if (s_tick_units & HOUR_UNIT) return 60 * 60 * 1000;
+  return 24 * 60 * 60 * 1000;
+}
+
+
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler) {
+  s_tick_units = tick_units;
+  s_tick_handler = handler;
+
+  uint64_t period = tick_period_ms();
+  s_next_tick_ms = s_now_ms + (period - (wall_ms() % period));
+}
+
+
+
+void tick_timer_service_unsubscribe(void) {
+  s_tick_handler = NULL;
+}
+
+
+
+static uint64_t next_tick_ms(void) {
+  return s_tick_handler ? s_next_tick_ms : SHIM_NEVER;
+}
+
+
+
+static void fire_tick(void) {
+  static struct tm last;
+  static bool have_last = false;
+  time_t now = shim_time(NULL);
+  struct tm tick_time;
+  gmtime_r(&now, &tick_time);
+
+  TimeUnits changed = SECOND_UNIT;
+  if (!have_last || (tick_time.tm_min != last.tm_min)) changed |= MINUTE_UNIT;
+  if (!have_last || (tick_time.tm_hour != last.tm_hour)) changed |= HOUR_UNIT;
+  if (!have_last || (tick_time.tm_mday != last.tm_mday)) changed |= DAY_UNIT;
+  if (!have_last || (tick_time.tm_mon != last.tm_mon)) changed |= MONTH_UNIT;
+  if (!have_last || (tick_time.tm_year != last.tm_year)) changed |= YEAR_UNIT;
+  last = tick_time;
+  have_last = true;
+  s_next_tick_ms += tick_period_ms();
+
+  SHIM_DISPATCH(SHIM_CB_TICK, s_tick_handler(&tick_time, changed));
+}
+
+
+/////////////////////////////////////////// Timers /////////////////////////////////////////////
+
+static ShimTimer *timer_lookup(AppTimer *timer_handle) {
+  uint32_t id = (uint32_t)(uintptr_t)timer_handle;
+  if (id == 0) {
+    return NULL;
+  }
+  for (int i = 0; i < SHIM_MAX_TIMERS; i++) {
+    if (s_timers[i].id == id) {
+      return &s_timers[i];
+    }
+  }
+  return NULL;
+}
+
+
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+  for (int i = 0; i < SHIM_MAX_TIMERS; i++) {
+    ShimTimer *timer = &s_timers[i];
+    if (timer->id == 0) {
+      timer->id = s_next_timer_id++;
+      timer->delay_ms = timer_delay_ms();
+      timer->deadline_ms = s_now_ms + timeout_ms + timer->delay_ms;
+      timer->callback = callback;
+      timer->data = callback_data;
+      return (AppTimer *)(uintptr_t)timer->id;
+    }
+  }
+  fprintf(stderr, "shim: out of app timers\n");
+  return NULL;
+}
+
+
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+  ShimTimer *timer = timer_lookup(timer_handle);
+  if (!timer) {
+    return false;
+  }
+  timer->delay_ms = timer_delay_ms();
+  timer->deadline_ms = s_now_ms + new_timeout_ms + timer->delay_ms;
+  return true;
+}
+
+
+
+void app_timer_cancel(AppTimer *timer_handle) {
+  ShimTimer *timer = timer_lookup(timer_handle);
+  if (timer) {
+    timer->id = 0;
+  }
+}
+
+
+
+static ShimTimer *next_timer(void) {
+  ShimTimer *next = NULL;
+  for (int i = 0; i < SHIM_MAX_TIMERS; i++) {
+    ShimTimer *timer = &s_timers[i];
+    if (timer->id && (!next || (timer->deadline_ms < next->deadline_ms) ||
+        ((timer->deadline_ms == next->deadline_ms) && (timer->id < next->id)))) {
+      next = timer;
+    }
+  }
+  return next;
+}
+
+
+
+static void fire_timer(ShimTimer *timer) {
+  AppTimerCallback callback = timer->callback;
+  void *data = timer->data;
+  timer->id = 0;		// One-shot: the handle is dead once it fires
+  s_stats.timer_delay_ms += timer->delay_ms;
+  if (timer->delay_ms > s_stats.max_timer_delay_ms) {
+    s_stats.max_timer_delay_ms = timer->delay_ms;
+  }
+  SHIM_DISPATCH(SHIM_CB_TIMER, callback(data));
+}
+
+
+/////////////////////////////////////////// Accelerometer /////////////////////////////////////////////
+
+static AccelData sample_at(uint64_t t_ms) {
+  AccelData data = { .timestamp = ((uint64_t)SHIM_START_TIME * 1000) + t_ms };
+  if (s_trace && s_trace->num_samples) {
+    uint64_t index = (t_ms * s_trace->rate_hz) / 1000;
+    if (index >= s_trace->num_samples) {
+      index = s_trace->num_samples - 1;
+    }
+    const TraceSample *sample = &s_trace->samples[index];
+    data.x = sample->x;
+    data.y = sample->y;
+    data.z = sample->z;
+  }
+  return data;
+}
+
+
+
+static uint64_t stream_sample_ms(uint64_t index) {
+  return s_stream_origin_ms + ((index * 1000) / s_rate_hz);
+}
+
+
+
+int accel_service_peek(AccelData *data) {
+  *data = sample_at(s_now_ms);
+  s_stats.peeks++;
+  s_stats.samples_delivered++;
+  return 0;
+}
+
+
+
+int accel_service_set_sampling_rate(AccelSamplingRate rate) {
+  if ((rate != ACCEL_SAMPLING_10HZ) && (rate != ACCEL_SAMPLING_25HZ) &&
+      (rate != ACCEL_SAMPLING_50HZ) && (rate != ACCEL_SAMPLING_100HZ)) {
+    return -1;
+  }
+  // Restart the sample stream at the new rate from the next sample due
+  uint64_t next_ms = stream_sample_ms(s_stream_next);
+  s_rate_hz = rate;
+  s_stream_origin_ms = next_ms;
+  s_stream_next = 0;
+  return 0;
+}
+
+
+
+int accel_service_set_samples_per_update(uint32_t num_samples) {
+  if (num_samples > SHIM_MAX_BATCH) {
+    return -1;
+  }
+  s_samples_per_update = num_samples;
+  return 0;
+}
+
+
+
+void accel_data_service_subscribe(uint32_t samples_per_update, AccelDataHandler handler) {
+  s_samples_per_update = samples_per_update;
+  s_accel_handler = handler;
+  s_stream_origin_ms = s_now_ms;
+  s_stream_next = 0;
+}
+
+
+
+void accel_data_service_unsubscribe(void) {
+  s_accel_handler = NULL;
+}
+
+
+
+void accel_tap_service_subscribe(AccelTapHandler handler) {
+  s_tap_handler = handler;
+}
+
+
+
+void accel_tap_service_unsubscribe(void) {
+  s_tap_handler = NULL;
+}
+
+
+
+/*
+	Dominant axis of the jump into trace sample i,
+	if it is a tap.
+*/
+static bool tap_at(uint32_t i, AccelAxisType *axis, int32_t *direction) {
+  if (i == 0) {
+    return false;
+  }
+  const TraceSample *a = &s_trace->samples[i - 1];
+  const TraceSample *b = &s_trace->samples[i];
+  int32_t deltas[3] = { b->x - a->x, b->y - a->y, b->z - a->z };
+  int best = 0;
+  for (int k = 1; k < 3; k++) {
+    if (abs(deltas[k]) > abs(deltas[best])) {
+      best = k;
+    }
+  }
+  if (abs(deltas[best]) < SHIM_TAP_MG) {
+    return false;
+  }
+  *axis = (AccelAxisType)best;
+  *direction = (deltas[best] > 0) ? 1 : -1;
+  return true;
+}
+
+
+
+static uint64_t next_tap_ms(void) {
+  if (!s_tap_handler || !s_trace || (s_trace->rate_hz == 0)) {
+    return SHIM_NEVER;
+  }
+  uint32_t now_index = (uint32_t)((s_now_ms * s_trace->rate_hz + 999) / 1000);
+  if (s_tap_next < now_index) {
+    s_tap_next = now_index;
+    s_tap_found = false;
+  }
+  if (!s_tap_found) {
+    AccelAxisType axis;
+    int32_t direction;
+    while ((s_tap_next < s_trace->num_samples) && !tap_at(s_tap_next, &axis, &direction)) {
+      s_tap_next++;
+    }
+    s_tap_found = (s_tap_next < s_trace->num_samples);
+  }
+  return s_tap_found ? ((uint64_t)s_tap_next * 1000) / s_trace->rate_hz : SHIM_NEVER;
+}
+
+
+
+static void fire_tap(void) {
+  AccelAxisType axis;
+  int32_t direction;
+  tap_at(s_tap_next, &axis, &direction);
+  s_tap_next += (SHIM_TAP_REFRACTORY_MS * s_trace->rate_hz) / 1000;
+  s_tap_found = false;
+  SHIM_DISPATCH(SHIM_CB_TAP, s_tap_handler(axis, direction));
+}
+
+
+
+static uint64_t next_batch_ms(void) {
+  if (!s_accel_handler) {
+    return SHIM_NEVER;
+  }
+  uint32_t count = s_samples_per_update ? s_samples_per_update : 1;
+  return stream_sample_ms(s_stream_next + count - 1);
+}
+
+
+
+static void fire_batch(void) {
+  static AccelData batch[SHIM_MAX_BATCH];
+  uint32_t count = s_samples_per_update ? s_samples_per_update : 1;
+  for (uint32_t i = 0; i < count; i++) {
+    uint64_t index = s_stream_next + i;
+    int64_t at_ms = (int64_t)stream_sample_ms(index) + sample_error_ms(index);
+    batch[i] = sample_at((at_ms > 0) ? (uint64_t)at_ms : 0);
+  }
+  s_stream_next += count;
+  s_stats.samples_delivered += count;
+  SHIM_DISPATCH(SHIM_CB_ACCEL, s_accel_handler(batch, count));
+}
+
+
+/////////////////////////////////////////// Data Logging /////////////////////////////////////////////
+
+static ShimLogTagStats *log_tag_stats(uint32_t tag) {
+  for (uint32_t i = 0; i < s_stats.num_log_tags; i++) {
+    if (s_stats.log_tags[i].tag == tag) {
+      return &s_stats.log_tags[i];
+    }
+  }
+  if (s_stats.num_log_tags == SHIM_MAX_LOG_TAGS) {
+    return NULL;
+  }
+  ShimLogTagStats *tag_stats = &s_stats.log_tags[s_stats.num_log_tags++];
+  tag_stats->tag = tag;
+  return tag_stats;
+}
+
+
+
+static void put_le(uint8_t *out, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    out[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+
+
+static void spool_items(const ShimSession *session, const void *data, uint32_t num_items) {
+  uint8_t header[SHIM_SPOOL_HEADER_BYTES];
+  put_le(&header[0], session->tag, 4);
+  put_le(&header[4], session->item_length, 2);
+  put_le(&header[6], num_items, 4);
+  fwrite(header, 1, sizeof(header), s_log_spool);
+  fwrite(data, session->item_length, num_items, s_log_spool);
+}
+
+
+
+DataLoggingSessionRef data_logging_create(uint32_t tag, DataLoggingItemType item_type, uint16_t item_length, bool resume) {
+  for (int i = 0; i < SHIM_MAX_SESSIONS; i++) {
+    ShimSession *session = &s_sessions[i];
+    if (!session->open) {
+      *session = (ShimSession) {
+        .open = true,
+        .tag = tag,
+        .item_type = item_type,
+        .item_length = item_length,
+        .tag_stats = log_tag_stats(tag),
+      };
+      s_stats.log_sessions_created++;
+      return session;
+    }
+  }
+  return NULL;
+}
+
+
+
+void data_logging_finish(DataLoggingSessionRef logging_session) {
+  ShimSession *session = logging_session;
+  if (session && session->open) {
+    session->open = false;
+    s_stats.log_sessions_finished++;
+  }
+}
+
+
+
+DataLoggingResult data_logging_log(DataLoggingSessionRef logging_session, const void *data, uint32_t num_items) {
+  ShimSession *session = logging_session;
+  s_stats.log_calls++;
+  if (!session || !data) {
+    s_stats.log_errors++;
+    return DATA_LOGGING_INVALID_PARAMS;
+  }
+  if (!session->open) {
+    s_stats.log_errors++;
+    return DATA_LOGGING_CLOSED;
+  }
+  if (s_log_busy_every && (s_stats.log_calls % s_log_busy_every == 0)) {
+    s_stats.log_busy++;
+    return DATA_LOGGING_BUSY;
+  }
+  s_stats.log_items += num_items;
+  s_stats.log_bytes += (uint64_t)num_items * session->item_length;
+  if (s_log_spool) {
+    spool_items(session, data, num_items);
+  }
+  if (session->tag_stats) {
+    session->tag_stats->calls++;
+    session->tag_stats->items += num_items;
+    session->tag_stats->bytes += (uint64_t)num_items * session->item_length;
+  }
+  return DATA_LOGGING_SUCCESS;
+}
+
+
+/////////////////////////////////////////// Persistent Storage /////////////////////////////////////////////
+
+void shim_persist_clear(void) {
+  memset(s_persist, 0, sizeof(s_persist));
+  s_stats.persist_keys = 0;
+  s_stats.persist_bytes = 0;
+}
+
+
+
+static ShimPersistValue *persist_lookup(uint32_t key) {
+  for (int i = 0; i < SHIM_PERSIST_MAX_KEYS; i++) {
+    if (s_persist[i].used && (s_persist[i].key == key)) {
+      return &s_persist[i];
+    }
+  }
+  return NULL;
+}
+
+
+
+bool persist_exists(const uint32_t key) {
+  return persist_lookup(key) != NULL;
+}
+
+
+
+int persist_get_size(const uint32_t key) {
+  ShimPersistValue *value = persist_lookup(key);
+  return value ? value->size : E_DOES_NOT_EXIST;
+}
+
+
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+  ShimPersistValue *value = persist_lookup(key);
+  if (!value) {
+    return E_DOES_NOT_EXIST;
+  }
+  size_t size = (value->size < buffer_size) ? value->size : buffer_size;
+  memcpy(buffer, value->data, size);
+  s_stats.persist_reads++;
+  s_stats.persist_read_bytes += size;
+  return (int)size;
+}
+
+
+
+int32_t persist_read_int(const uint32_t key) {
+  int32_t value = 0;
+  persist_read_data(key, &value, sizeof(value));
+  return value;
+}
+
+
+
+/*
+	Values longer than PERSIST_DATA_MAX_LENGTH are cut,
+	like on the watch. Fails with E_OUT_OF_STORAGE past
+	SHIM_PERSIST_BYTES.
+*/
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+  size_t length = (size < PERSIST_DATA_MAX_LENGTH) ? size : PERSIST_DATA_MAX_LENGTH;
+  ShimPersistValue *value = persist_lookup(key);
+  uint32_t old_size = value ? value->size : 0;
+
+  if (s_stats.persist_bytes - old_size + length > SHIM_PERSIST_BYTES) {
+    return E_OUT_OF_STORAGE;
+  }
+  for (int i = 0; !value && (i < SHIM_PERSIST_MAX_KEYS); i++) {
+    if (!s_persist[i].used) {
+      value = &s_persist[i];
+      value->used = true;
+      value->key = key;
+      s_stats.persist_keys++;
+    }
+  }
+  if (!value) {
+    return E_OUT_OF_RESOURCES;
+  }
+
+  memcpy(value->data, data, length);
+  value->size = length;
+  s_stats.persist_bytes = s_stats.persist_bytes - old_size + length;
+  s_stats.persist_writes++;
+  s_stats.persist_write_bytes += length;
+  return (int)length;
+}
+
+
+
+status_t persist_write_int(const uint32_t key, const int32_t value) {
+  int written = persist_write_data(key, &value, sizeof(value));
+  return (written < 0) ? written : S_SUCCESS;
+}
+
+
+
+status_t persist_delete(const uint32_t key) {
+  ShimPersistValue *value = persist_lookup(key);
+  if (!value) {
+    return E_DOES_NOT_EXIST;
+  }
+  s_stats.persist_bytes -= value->size;
+  s_stats.persist_keys--;
+  s_stats.persist_deletes++;
+  memset(value, 0, sizeof(*value));
+  return S_SUCCESS;
+}
+
+
+/////////////////////////////////////////// Dictionary / App Message /////////////////////////////////////////////
+
+static Tuple *dict_first(const DictionaryIterator *iter) {
+  return (Tuple *)((uint8_t *)iter->dictionary + sizeof(Dictionary));
+}
+
+
+
+// tuple if it lies whole before the end of the dictionary, else NULL
+static Tuple *dict_checked(const DictionaryIterator *iter, Tuple *tuple) {
+  const uint8_t *at = (const uint8_t *)tuple;
+  const uint8_t *end = (const uint8_t *)iter->end;
+  if ((iter->dictionary->count == 0) || (at + sizeof(Tuple) > end) || (at + sizeof(Tuple) + tuple->length > end)) {
+    return NULL;
+  }
+  return tuple;
+}
+
+
+
+static Tuple *dict_after(Tuple *tuple) {
+  return (Tuple *)((uint8_t *)tuple + sizeof(Tuple) + tuple->length);
+}
+
+
+
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t *const buffer, const uint16_t size) {
+  if (!iter || !buffer || (size < sizeof(Dictionary))) {
+    return DICT_INVALID_ARGS;
+  }
+  iter->dictionary = (Dictionary *)buffer;
+  iter->dictionary->count = 0;
+  iter->end = buffer + size;
+  iter->cursor = dict_first(iter);
+  return DICT_OK;
+}
+
+
+
+static DictionaryResult dict_write_tuple(DictionaryIterator *iter, uint32_t key, TupleType type,
+                                         const void *data, uint16_t length) {
+  if (!iter || !iter->dictionary || (!data && length)) {
+    return DICT_INVALID_ARGS;
+  }
+  uint8_t *at = (uint8_t *)iter->cursor;
+  if ((at + sizeof(Tuple) + length > (const uint8_t *)iter->end) || (iter->dictionary->count == UINT8_MAX)) {
+    return DICT_NOT_ENOUGH_STORAGE;
+  }
+  Tuple *tuple = iter->cursor;
+  tuple->key = key;
+  tuple->type = type;
+  tuple->length = length;
+  memcpy(tuple->value->data, data, length);
+  iter->cursor = dict_after(tuple);
+  iter->dictionary->count++;
+  return DICT_OK;
+}
+
+
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t *const data, const uint16_t size) {
+  return dict_write_tuple(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+
+
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key, const char *const cstring) {
+  return dict_write_tuple(iter, key, TUPLE_CSTRING, cstring, cstring ? (uint16_t)(strlen(cstring) + 1) : 0);
+}
+
+
+
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key, const void *integer, const uint8_t width_bytes, const bool is_signed) {
+  if ((width_bytes != 1) && (width_bytes != 2) && (width_bytes != 4)) {
+    return DICT_INVALID_ARGS;
+  }
+  return dict_write_tuple(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT, integer, width_bytes);
+}
+
+
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value) {
+  return dict_write_int(iter, key, &value, sizeof(value), false);
+}
+
+
+
+DictionaryResult dict_write_uint16(DictionaryIterator *iter, const uint32_t key, const uint16_t value) {
+  return dict_write_int(iter, key, &value, sizeof(value), false);
+}
+
+
+
+DictionaryResult dict_write_int8(DictionaryIterator *iter, const uint32_t key, const int8_t value) {
+  return dict_write_int(iter, key, &value, sizeof(value), true);
+}
+
+
+
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value) {
+  return dict_write_int(iter, key, &value, sizeof(value), true);
+}
+
+
+
+// Returns the dictionary's size in bytes, and ends it there
+uint32_t dict_write_end(DictionaryIterator *iter) {
+  if (!iter || !iter->dictionary) {
+    return 0;
+  }
+  iter->end = iter->cursor;
+  return (uint32_t)((uint8_t *)iter->cursor - (uint8_t *)iter->dictionary);
+}
+
+
+
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t *const buffer, const uint16_t size) {
+  if (!iter || !buffer || (size < sizeof(Dictionary))) {
+    return NULL;
+  }
+  iter->dictionary = (Dictionary *)buffer;
+  iter->end = buffer + size;
+  return dict_read_first(iter);
+}
+
+
+
+Tuple *dict_read_first(DictionaryIterator *iter) {
+  iter->cursor = dict_first(iter);
+  return dict_checked(iter, iter->cursor);
+}
+
+
+
+Tuple *dict_read_next(DictionaryIterator *iter) {
+  if (!dict_checked(iter, iter->cursor)) {
+    return NULL;
+  }
+  iter->cursor = dict_after(iter->cursor);
+  return dict_checked(iter, iter->cursor);
+}
+
+
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+  for (Tuple *tuple = dict_checked(iter, dict_first(iter)); tuple; tuple = dict_checked(iter, dict_after(tuple))) {
+    if (tuple->key == key) {
+      return tuple;
+    }
+  }
+  return NULL;
+}
+
+
+
+/*
+	Buffers come out of the app heap on the watch,
+	so they are counted there. Opening again is an
+	error, like on the watch.
+*/
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+  if (s_app_message_open) {
+    return APP_MSG_INVALID_ARGS;
+  }
+  if ((size_inbound > SHIM_MESSAGE_BYTES) || (size_outbound > SHIM_MESSAGE_BYTES)) {
+    return APP_MSG_OUT_OF_MEMORY;
+  }
+  s_app_message_open = true;
+  s_inbox_size = size_inbound;
+  s_outbox_size = size_outbound;
+  heap_add((int64_t)size_inbound + size_outbound);
+  return APP_MSG_OK;
+}
+
+
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+  AppMessageInboxReceived previous = s_inbox_received;
+  s_inbox_received = received_callback;
+  return previous;
+}
+
+
+
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback) {
+  AppMessageInboxDropped previous = s_inbox_dropped;
+  s_inbox_dropped = dropped_callback;
+  return previous;
+}
+
+
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+  if (!iterator || !s_app_message_open) {
+    s_stats.messages_failed++;
+    return iterator ? APP_MSG_CLOSED : APP_MSG_INVALID_ARGS;
+  }
+  if (s_outbox_pending) {
+    s_stats.messages_failed++;
+    return APP_MSG_BUSY;
+  }
+  dict_write_begin(&s_outbox_iter, s_outbox, s_outbox_size);
+  s_outbox_pending = true;
+  *iterator = &s_outbox_iter;
+  return APP_MSG_OK;
+}
+
+
+
+/*
+	The phone gets it right away (the outbox handler,
+	if any): a send never stays in flight.
+*/
+AppMessageResult app_message_outbox_send(void) {
+  if (!s_outbox_pending) {
+    s_stats.messages_failed++;
+    return APP_MSG_INVALID_ARGS;
+  }
+  s_outbox_pending = false;
+  if (!s_bluetooth_connected) {
+    s_stats.messages_failed++;
+    return APP_MSG_NOT_CONNECTED;
+  }
+  uint32_t size = dict_write_end(&s_outbox_iter);
+  s_stats.messages_sent++;
+  s_stats.message_bytes_sent += size;
+  if (s_outbox_handler) {
+    DictionaryIterator iter;
+    dict_read_begin_from_buffer(&iter, s_outbox, size);
+    s_outbox_handler(&iter);
+  }
+  return APP_MSG_OK;
+}
+
+
+/////////////////////////////////////////// Math /////////////////////////////////////////////
+
+int32_t sin_lookup(int32_t angle) {
+  return (int32_t)lround(sin((2.0 * M_PI * angle) / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+
+
+int32_t cos_lookup(int32_t angle) {
+  return (int32_t)lround(cos((2.0 * M_PI * angle) / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+
+/////////////////////////////////////////// Battery / Bluetooth / Vibes /////////////////////////////////////////////
+
+BatteryChargeState battery_state_service_peek(void) {
+  return s_battery;
+}
+
+
+
+void battery_state_service_subscribe(BatteryStateHandler handler) {
+  s_battery_handler = handler;
+}
+
+
+
+void battery_state_service_unsubscribe(void) {
+  s_battery_handler = NULL;
+}
+
+
+
+bool bluetooth_connection_service_peek(void) {
+  return s_bluetooth_connected;
+}
+
+
+
+void bluetooth_connection_service_subscribe(BluetoothConnectionHandler handler) {
+  s_bluetooth_handler = handler;
+}
+
+
+
+void bluetooth_connection_service_unsubscribe(void) {
+  s_bluetooth_handler = NULL;
+}
+
+
+
+void vibes_short_pulse(void) {
+}
+
+
+
+void vibes_long_pulse(void) {
+}
+
+
+
+void vibes_double_pulse(void) {
+}
+
+
+/////////////////////////////////////////// Graphics /////////////////////////////////////////////
+
+ResHandle resource_get_handle(uint32_t resource_id) {
+  return (ResHandle)(uintptr_t)resource_id;
+}
+
+
+
+GFont fonts_get_system_font(const char *font_key) {
+  static struct GFont system_fonts[16];
+  for (int i = 0; i < 16; i++) {
+    if (system_fonts[i].key == NULL) {
+      system_fonts[i].key = font_key;
+    }
+    if (strcmp(system_fonts[i].key, font_key) == 0) {
+      return &system_fonts[i];
+    }
+  }
+  return &system_fonts[0];
+}
+
+
+
+GFont fonts_load_custom_font(ResHandle handle) {
+  GFont font = shim_alloc(sizeof(struct GFont));
+  heap_add(SHIM_FONT_BYTES);
+  font->resource_id = (uint32_t)(uintptr_t)handle;
+  font->custom = true;
+  s_stats.fonts_loaded++;
+  return font;
+}
+
+
+
+void fonts_unload_custom_font(GFont font) {
+  if (font && font->custom) {
+    heap_add(-SHIM_FONT_BYTES);
+    shim_free(font, sizeof(struct GFont));
+    s_stats.fonts_unloaded++;
+  }
+}
+
+
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id) {
+  GBitmap *bitmap = shim_alloc(sizeof(GBitmap));
+  heap_add(SHIM_BITMAP_BYTES);
+  bitmap->resource_id = resource_id;
+  return bitmap;
+}
+
+
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  if (bitmap) {
+    heap_add(-SHIM_BITMAP_BYTES);
+    shim_free(bitmap, sizeof(GBitmap));
+  }
+}
+
+
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) {
+  ctx->stroke_color = color;
+}
+
+
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+  ctx->fill_color = color;
+}
+
+
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode) {
+  ctx->compositing_mode = mode;
+}
+
+
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask) {
+}
+
+
+
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect) {
+}
+
+
+/////////////////////////////////////////// Layers / Windows /////////////////////////////////////////////
+
+static void layer_init(Layer *layer, GRect frame) {
+  layer->frame = frame;
+  layer->dirty = true;
+  layer->next = s_layers;
+  s_layers = layer;
+}
+
+
+
+static void layer_deinit(Layer *layer) {
+  for (Layer **link = &s_layers; *link; link = &(*link)->next) {
+    if (*link == layer) {
+      *link = layer->next;
+      break;
+    }
+  }
+  for (Layer *other = s_layers; other; other = other->next) {
+    if (other->parent == layer) {
+      other->parent = NULL;
+    }
+  }
+}
+
+
+
+Layer *layer_create(GRect frame) {
+  Layer *layer = shim_alloc(sizeof(Layer));
+  layer_init(layer, frame);
+  return layer;
+}
+
+
+
+void layer_destroy(Layer *layer) {
+  if (layer) {
+    layer_deinit(layer);
+    shim_free(layer, sizeof(Layer));
+  }
+}
+
+
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+  layer->update_proc = update_proc;
+}
+
+
+
+void layer_add_child(Layer *parent, Layer *child) {
+  child->parent = parent;
+  layer_mark_dirty(child);
+}
+
+
+
+void layer_mark_dirty(Layer *layer) {
+  layer->dirty = true;
+  s_stats.layers_marked_dirty++;
+}
+
+
+
+GRect layer_get_bounds(const Layer *layer) {
+  return GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
+}
+
+
+
+void layer_set_hidden(Layer *layer, bool hidden) {
+  if (layer->hidden != hidden) {
+    layer->hidden = hidden;
+    layer_mark_dirty(layer);
+  }
+}
+
+
+
+TextLayer *text_layer_create(GRect frame) {
+  TextLayer *text_layer = shim_alloc(sizeof(TextLayer));
+  layer_init(&text_layer->layer, frame);
+  text_layer->text_color = GColorBlack;
+  text_layer->background_color = GColorWhite;
+  return text_layer;
+}
+
+
+
+void text_layer_destroy(TextLayer *text_layer) {
+  if (text_layer) {
+    layer_deinit(&text_layer->layer);
+    shim_free(text_layer, sizeof(TextLayer));
+  }
+}
+
+
+
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+  return &text_layer->layer;
+}
+
+
+
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+  text_layer->text = text;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+
+
+void text_layer_set_font(TextLayer *text_layer, GFont font) {
+  text_layer->font = font;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+
+
+void text_layer_set_text_color(TextLayer *text_layer, GColor color) {
+  text_layer->text_color = color;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+
+
+void text_layer_set_background_color(TextLayer *text_layer, GColor color) {
+  text_layer->background_color = color;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+
+
+void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode line_mode) {
+  text_layer->overflow_mode = line_mode;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+
+
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment) {
+  text_layer->alignment = text_alignment;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+
+
+BitmapLayer *bitmap_layer_create(GRect frame) {
+  BitmapLayer *bitmap_layer = shim_alloc(sizeof(BitmapLayer));
+  layer_init(&bitmap_layer->layer, frame);
+  return bitmap_layer;
+}
+
+
+
+void bitmap_layer_destroy(BitmapLayer *bitmap_layer) {
+  if (bitmap_layer) {
+    layer_deinit(&bitmap_layer->layer);
+    shim_free(bitmap_layer, sizeof(BitmapLayer));
+  }
+}
+
+
+
+Layer *bitmap_layer_get_layer(const BitmapLayer *bitmap_layer) {
+  return (Layer *)&bitmap_layer->layer;
+}
+
+
+
+void bitmap_layer_set_bitmap(BitmapLayer *bitmap_layer, const GBitmap *bitmap) {
+  bitmap_layer->bitmap = bitmap;
+  layer_mark_dirty(&bitmap_layer->layer);
+}
+
+
+
+Window *window_create(void) {
+  Window *window = shim_alloc(sizeof(Window));
+  layer_init(&window->root, GRect(0, 0, 144, 168));
+  window->background_color = GColorWhite;
+  return window;
+}
+
+
+
+void window_destroy(Window *window) {
+  if (!window) {
+    return;
+  }
+  if (window->loaded && window->handlers.unload) {
+    window->handlers.unload(window);
+  }
+  if (s_top_window == window) {
+    s_top_window = NULL;
+  }
+  layer_deinit(&window->root);
+  shim_free(window, sizeof(Window));
+}
+
+
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+  window->handlers = handlers;
+}
+
+
+
+void window_set_click_config_provider(Window *window, ClickConfigProvider click_config_provider) {
+  window->click_config_provider = click_config_provider;
+}
+
+
+
+void window_set_background_color(Window *window, GColor background_color) {
+  window->background_color = background_color;
+  layer_mark_dirty(&window->root);
+}
+
+
+
+Layer *window_get_root_layer(const Window *window) {
+  return (Layer *)&window->root;
+}
+
+
+
+void window_stack_push(Window *window, bool animated) {
+  s_top_window = window;
+  memset(s_click_handlers, 0, sizeof(s_click_handlers));
+  if (window->click_config_provider) {
+    window->click_config_provider(NULL);
+  }
+  if (!window->loaded) {
+    window->loaded = true;
+    if (window->handlers.load) {
+      window->handlers.load(window);
+    }
+  }
+  if (window->handlers.appear) {
+    window->handlers.appear(window);
+  }
+}
+
+
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler) {
+  if (button_id < NUM_BUTTONS) {
+    s_click_handlers[button_id] = handler;
+  }
+}
+
+
+
+static bool layer_is_visible(const Layer *layer) {
+  for (; layer; layer = layer->parent) {
+    if (layer->hidden) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+
+/*
+	Like the firmware, any dirty layer redraws the whole
+	window: every visible update proc runs once per frame.
+*/
+static void render(void) {
+  bool dirty = false;
+  for (Layer *layer = s_layers; layer; layer = layer->next) {
+    dirty |= layer->dirty;
+    layer->dirty = false;
+  }
+  if (!dirty || !s_top_window) {
+    return;
+  }
+
+  s_stats.frames_rendered++;
+  uint64_t start_ns = shim_clock_ns();
+  for (Layer *layer = s_layers; layer; layer = layer->next) {
+    if (layer->update_proc && layer_is_visible(layer)) {
+      layer->update_proc(layer, &s_gcontext);
+      s_stats.layer_updates++;
+    }
+  }
+  s_stats.callbacks[SHIM_CB_RENDER].ns += shim_clock_ns() - start_ns;
+  s_stats.callbacks[SHIM_CB_RENDER].calls++;
+}
+
+
+/////////////////////////////////////////// Event loop /////////////////////////////////////////////
+
+static uint64_t next_state_event_ms(void) {
+  return (s_next_state_event < s_num_state_events) ? s_state_events[s_next_state_event].at_ms : SHIM_NEVER;
+}
+
+
+
+static void fire_state_event(void) {
+  const ShimStateEvent *event = &s_state_events[s_next_state_event++];
+  if (event->bluetooth) {
+    s_bluetooth_connected = event->connected;
+    if (s_bluetooth_handler) {
+      SHIM_DISPATCH(SHIM_CB_BLUETOOTH, s_bluetooth_handler(event->connected));
+    }
+  } else {
+    s_battery = event->charge;
+    if (s_battery_handler) {
+      SHIM_DISPATCH(SHIM_CB_BATTERY, s_battery_handler(event->charge));
+    }
+  }
+}
+
+
+
+
+static uint64_t next_message_ms(void) {
+  return (s_next_message < s_num_messages) ? s_messages[s_next_message].at_ms : SHIM_NEVER;
+}
+
+
+
+/*
+	Copies the message into the inbox the app opened
+	and hands it over. Dropped, like the phone would
+	see it fail, when the app has no inbox or the
+	message does not fit in it.
+*/
+static void fire_message(void) {
+  const ShimMessage *message = &s_messages[s_next_message++];
+  if (!s_app_message_open || !s_inbox_received) {
+    s_stats.messages_dropped++;
+    return;
+  }
+  if (message->size > s_inbox_size) {
+    s_stats.messages_dropped++;
+    if (s_inbox_dropped) {
+      SHIM_DISPATCH(SHIM_CB_MESSAGE, s_inbox_dropped(APP_MSG_BUFFER_OVERFLOW, NULL));
+    }
+    return;
+  }
+  memcpy(s_inbox, message->data, message->size);
+  DictionaryIterator iter;
+  dict_read_begin_from_buffer(&iter, s_inbox, message->size);
+  s_stats.messages_received++;
+  s_stats.message_bytes_received += message->size;
+  SHIM_DISPATCH(SHIM_CB_MESSAGE, s_inbox_received(&iter, NULL));
+}
+
+
+
+static ShimClick *next_click(void) {
+  ShimClick *next = NULL;
+  for (uint32_t i = 0; i < s_num_clicks; i++) {
+    if ((s_clicks[i].at_ms >= s_now_ms) && (!next || (s_clicks[i].at_ms < next->at_ms))) {
+      next = &s_clicks[i];
+    }
+  }
+  return next;
+}
+
+
+
+void app_event_loop(void) {
+  uint64_t end_ms = s_trace ? trace_duration_ms(s_trace) : 0;
+
+  render();
+  for (;;) {
+    ShimTimer *timer = next_timer();
+    ShimClick *click = next_click();
+    uint64_t timer_ms = timer ? timer->deadline_ms : SHIM_NEVER;
+    uint64_t click_ms = click ? click->at_ms : SHIM_NEVER;
+    uint64_t batch_ms = next_batch_ms();
+    uint64_t tick_ms = next_tick_ms();
+    uint64_t state_ms = next_state_event_ms();
+    uint64_t tap_ms = next_tap_ms();
+    uint64_t message_ms = next_message_ms();
+
+    uint64_t next_ms = timer_ms;
+    if (batch_ms < next_ms) next_ms = batch_ms;
+    if (tap_ms < next_ms) next_ms = tap_ms;
+    if (tick_ms < next_ms) next_ms = tick_ms;
+    if (state_ms < next_ms) next_ms = state_ms;
+    if (message_ms < next_ms) next_ms = message_ms;
+    if (click_ms < next_ms) next_ms = click_ms;
+    if ((next_ms == SHIM_NEVER) || (next_ms >= end_ms)) {
+      break;
+    }
+    s_now_ms = next_ms;
+
+    // Same ordering as the firmware queue: sensor data first, then timers
+    if (batch_ms == next_ms) {
+      fire_batch();
+    } else if (tap_ms == next_ms) {
+      fire_tap();
+    } else if (timer_ms == next_ms) {
+      fire_timer(timer);
+    } else if (tick_ms == next_ms) {
+      fire_tick();
+    } else if (state_ms == next_ms) {
+      fire_state_event();
+    } else if (message_ms == next_ms) {
+      fire_message();
+    } else {
+      click->at_ms = SHIM_NEVER;
+      if (s_click_handlers[click->button_id]) {
+        uint64_t click_ns = s_stats.callbacks[SHIM_CB_CLICK].ns;
+        SHIM_DISPATCH(SHIM_CB_CLICK, s_click_handlers[click->button_id](NULL, NULL));
+        s_stats.clicks[click->button_id].ns += s_stats.callbacks[SHIM_CB_CLICK].ns - click_ns;
+        s_stats.clicks[click->button_id].calls++;
+      }
+    }
+    render();
+  }
+  s_now_ms = end_ms;
+  s_stats.simulated_ms = end_ms;
+}
+
+
+/////////////////////////////////////////// Report /////////////////////////////////////////////
+
+void shim_report(FILE *out) {
+  static const char *names[SHIM_CB_COUNT] = {
+    "timer", "accel", "tap", "tick", "battery", "bluetooth", "click", "message", "render",
+  };
+  const ShimStats *stats = &s_stats;
+  double seconds = stats->simulated_ms / 1000.0;
+
+  fprintf(out, "simulated:        %.1f s\n", seconds);
+  fprintf(out, "samples:          %llu delivered (%llu peeks)\n",
+          (unsigned long long)stats->samples_delivered, (unsigned long long)stats->peeks);
+  for (int i = 0; i < SHIM_CB_COUNT; i++) {
+    const ShimCallbackStats *cb = &stats->callbacks[i];
+    if (cb->calls) {
+      fprintf(out, "  %-10s %10llu calls %8.2f /s %10.1f ns/call\n", names[i],
+              (unsigned long long)cb->calls, seconds > 0 ? cb->calls / seconds : 0.0,
+              (double)cb->ns / cb->calls);
+    }
+  }
+  if (s_jitter.timer_ms || s_jitter.sample_ms) {
+    uint64_t timers = stats->callbacks[SHIM_CB_TIMER].calls;
+    fprintf(out, "jitter:           timers %.1f ms late on average (%u max, %u mean asked), samples within %u ms\n",
+            timers ? (double)stats->timer_delay_ms / timers : 0.0, (unsigned)stats->max_timer_delay_ms,
+            (unsigned)s_jitter.timer_ms, (unsigned)s_jitter.sample_ms);
+  }
+  fprintf(out, "datalogging:      %llu sessions created, %llu finished, %llu calls, %llu items, %llu bytes, %llu errors, %llu busy\n",
+          (unsigned long long)stats->log_sessions_created, (unsigned long long)stats->log_sessions_finished,
+          (unsigned long long)stats->log_calls, (unsigned long long)stats->log_items,
+          (unsigned long long)stats->log_bytes, (unsigned long long)stats->log_errors,
+          (unsigned long long)stats->log_busy);
+  for (uint32_t i = 0; i < stats->num_log_tags; i++) {
+    const ShimLogTagStats *tag = &stats->log_tags[i];
+    fprintf(out, "  tag 0x%-6x %10llu flushes %8llu items %8llu bytes %6.1f items/flush %8.3f bytes/s\n",
+            (unsigned)tag->tag, (unsigned long long)tag->calls, (unsigned long long)tag->items,
+            (unsigned long long)tag->bytes, tag->calls ? (double)tag->items / tag->calls : 0.0,
+            seconds > 0 ? tag->bytes / seconds : 0.0);
+  }
+  if (stats->persist_reads || stats->persist_writes || stats->persist_deletes) {
+    fprintf(out, "persist:          %llu reads (%llu bytes), %llu writes (%llu bytes), %llu deletes, %u keys, %u of %d bytes used\n",
+            (unsigned long long)stats->persist_reads, (unsigned long long)stats->persist_read_bytes,
+            (unsigned long long)stats->persist_writes, (unsigned long long)stats->persist_write_bytes,
+            (unsigned long long)stats->persist_deletes, stats->persist_keys, stats->persist_bytes,
+            SHIM_PERSIST_BYTES);
+  }
+  if (stats->messages_received || stats->messages_dropped || stats->messages_sent || stats->messages_failed) {
+    fprintf(out, "appmessage:       %llu received (%llu bytes), %llu dropped, %llu sent (%llu bytes), %llu failed\n",
+            (unsigned long long)stats->messages_received, (unsigned long long)stats->message_bytes_received,
+            (unsigned long long)stats->messages_dropped, (unsigned long long)stats->messages_sent,
+            (unsigned long long)stats->message_bytes_sent, (unsigned long long)stats->messages_failed);
+  }
+  if (stats->console_lines) {
+    fprintf(out, "console:          %llu APP_LOG lines, %llu bytes\n",
+            (unsigned long long)stats->console_lines, (unsigned long long)stats->console_bytes);
+  }
+  fprintf(out, "rendering:        %llu frames, %llu layer updates, %llu marks\n",
+          (unsigned long long)stats->frames_rendered, (unsigned long long)stats->layer_updates,
+          (unsigned long long)stats->layers_marked_dirty);
+  fprintf(out, "heap:             %lld bytes live, %lld peak, %llu fonts loaded, %llu unloaded\n",
+          (long long)stats->heap_bytes, (long long)stats->heap_peak,
+          (unsigned long long)stats->fonts_loaded, (unsigned long long)stats->fonts_unloaded);
+}
@@ -0,0 +1,150 @@
+/*
+* Host shim control surface.
+*
+* Harnesses load a trace, hand it to the shim, call the app's renamed
+* main() (the host build compiles app sources with -Dmain=pebble_app_main)
+* and read the counters below once app_event_loop() has replayed the
+* whole trace.
+*/
+
+#pragma once
+
+#include <pebble.h>
+#include <stdio.h>
+
+#include "trace.h"
+
+int pebble_app_main(void);
+
+#define SHIM_START_TIME 1401609600	// Wall clock at simulated time 0: 2014-06-01 08:00:00 UTC
+
+typedef enum {
+  SHIM_CB_TIMER = 0,
+  SHIM_CB_ACCEL,
+  SHIM_CB_TAP,
+  SHIM_CB_TICK,
+  SHIM_CB_BATTERY,
+  SHIM_CB_BLUETOOTH,
+  SHIM_CB_CLICK,
+  SHIM_CB_MESSAGE,
+  SHIM_CB_RENDER,
+  SHIM_CB_COUNT,
+} ShimCallback;
+
+typedef struct {
+  uint64_t calls;
+  uint64_t ns;
+} ShimCallbackStats;
+
+/*
+	Timing error the shim can inject (shim_set_jitter()), as the
+	watch has it: app timers fire late by a random delay, mean
+	timer_ms (exponential, capped at SHIM_JITTER_CAP times the
+	mean), which re-registered timers accumulate as drift; and
+	batched samples are taken up to sample_ms early or late,
+	their timestamps and values both. Zero is none.
+*/
+typedef struct {
+  uint32_t timer_ms;
+  uint32_t sample_ms;
+  uint32_t seed;
+} ShimJitter;
+
+#define SHIM_JITTER_CAP 8
+
+#define SHIM_MAX_LOG_TAGS 8
+
+typedef struct {
+  uint32_t tag;
+  uint64_t calls;		// data_logging_log() calls: one per flush for batched loggers
+  uint64_t items;
+  uint64_t bytes;
+} ShimLogTagStats;
+
+/*
+	Data logging spool: what a phone would receive, one record per
+	successful data_logging_log() call:
+
+	  uint32_t tag, uint16_t item_length, uint32_t num_items (little
+	  endian), then num_items * item_length bytes of items
+*/
+#define SHIM_SPOOL_HEADER_BYTES 10
+
+// Largest AppMessage the shim carries either way; app_message_open()
+// refuses bigger buffers with APP_MSG_OUT_OF_MEMORY
+#define SHIM_MESSAGE_BYTES 1024
+
+// Called with every dictionary the app sends, as the phone would get it
+typedef void (*ShimOutboxHandler)(DictionaryIterator *iterator);
+
+// Persistent storage an app gets on the watch. It lives as long as the
+// process, until shim_persist_clear().
+#define SHIM_PERSIST_BYTES 4096
+#define SHIM_PERSIST_MAX_KEYS 256
+
+typedef struct {
+  ShimCallbackStats callbacks[SHIM_CB_COUNT];
+  ShimCallbackStats clicks[NUM_BUTTONS];	// SHIM_CB_CLICK split by button
+  uint64_t samples_delivered;	// Samples handed to the app (peeks + batches)
+  uint64_t peeks;
+  uint64_t simulated_ms;
+  uint64_t timer_delay_ms;	// Injected delay, summed over the timers that fired
+  uint32_t max_timer_delay_ms;
+
+  uint64_t log_sessions_created;
+  uint64_t log_sessions_finished;
+  uint64_t log_calls;
+  uint64_t log_items;
+  uint64_t log_bytes;
+  uint64_t log_errors;
+  uint64_t log_busy;		// Calls refused by shim_set_log_busy()
+  ShimLogTagStats log_tags[SHIM_MAX_LOG_TAGS];	// First SHIM_MAX_LOG_TAGS tags seen
+  uint32_t num_log_tags;
+
+  uint64_t persist_reads;	// persist_read_*() calls that found their key
+  uint64_t persist_read_bytes;
+  uint64_t persist_writes;
+  uint64_t persist_write_bytes;
+  uint64_t persist_deletes;
+  uint32_t persist_keys;		// Keys stored now
+  uint32_t persist_bytes;		// Bytes stored now, of SHIM_PERSIST_BYTES
+
+  uint64_t messages_received;	// AppMessages handed to the inbox handler
+  uint64_t message_bytes_received;
+  uint64_t messages_dropped;	// Not open, no handler or too big for the inbox
+  uint64_t messages_sent;
+  uint64_t message_bytes_sent;
+  uint64_t messages_failed;	// Sends refused: busy, closed or not connected
+
+  uint64_t console_lines;	// APP_LOG calls, formatted even when not verbose
+  uint64_t console_bytes;
+
+  uint64_t frames_rendered;	// Window redraws triggered by dirty layers
+  uint64_t layer_updates;		// Layer update procs run during those redraws
+  uint64_t layers_marked_dirty;
+
+  uint64_t fonts_loaded;
+  uint64_t fonts_unloaded;
+  int64_t heap_bytes;		// Live bytes held by SDK objects
+  int64_t heap_peak;
+} ShimStats;
+
+void shim_set_trace(const Trace *trace);
+void shim_set_verbose(bool verbose);
+void shim_set_jitter(ShimJitter jitter);
+void shim_schedule_click(uint64_t at_ms, ButtonId button_id);
+void shim_schedule_battery(uint64_t at_ms, BatteryChargeState charge);	// Also what the peek returns from then on
+void shim_schedule_bluetooth(uint64_t at_ms, bool connected);
+void shim_schedule_message(uint64_t at_ms, const uint8_t *dictionary, uint16_t size);	// From dict_write_end()
+void shim_schedule_clock_step(uint64_t at_ms, int64_t step_ms);	// Sets time() and time_ms(), not timers
+void shim_set_outbox_handler(ShimOutboxHandler handler);
+void shim_set_log_busy(uint32_t every);
+void shim_set_log_spool(FILE *spool);		// Append every logged item, see below		// Every Nth data_logging_log() is DATA_LOGGING_BUSY, 0 = never
+
+void shim_persist_clear(void);
+
+const ShimStats *shim_stats(void);
+uint64_t shim_now_ms(void);
+uint64_t shim_clock_ns(void);
+
+void shim_report(FILE *out);
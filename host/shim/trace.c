@@ -0,0 +1,404 @@
+/*
+* Accelerometer trace loading and synthesis for the host shim.
+*/
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCENARIO_PERIOD_S 60	// One scripted event per minute of synthetic trace
+#define SCENARIO_OFFSET_S 20
+
+static const char *const LABEL_NAMES[TRACE_LABEL_KINDS] = { "fall", "seizure" };
+static const char *const EVENT_NAMES[TRACE_EVENTS] = { "fall", "seizure", "walk", "shake", "flop", "setdown", "rest" };
+
+
+static bool trace_append(Trace *trace, uint32_t *capacity, int x, int y, int z) {
+  if (trace->num_samples == *capacity) {
+    uint32_t new_capacity = *capacity ? (*capacity * 2) : 4096;
+    TraceSample *samples = realloc(trace->samples, new_capacity * sizeof(TraceSample));
+    if (!samples) {
+      return false;
+    }
+    trace->samples = samples;
+    *capacity = new_capacity;
+  }
+  trace->samples[trace->num_samples++] = (TraceSample) { .x = x, .y = y, .z = z };
+  return true;
+}
+
+
+
+/*
+	Reads a "# kind onset_ms" comment into the
+	labels. Other comments are ignored.
+*/
+static void trace_parse_label(Trace *trace, const char *line) {
+  char kind[16];
+  unsigned int onset_ms;
+  if ((trace->num_labels == TRACE_MAX_LABELS) || (sscanf(line, "# %15s %u", kind, &onset_ms) != 2)) {
+    return;
+  }
+  for (int i = 0; i < TRACE_LABEL_KINDS; i++) {
+    if (strcmp(kind, LABEL_NAMES[i]) == 0) {
+      trace->labels[trace->num_labels++] = (TraceLabel) { .kind = i, .onset_ms = onset_ms };
+    }
+  }
+}
+
+
+
+bool trace_load(Trace *trace, const char *path, uint32_t rate_hz) {
+  memset(trace, 0, sizeof(*trace));
+  trace->rate_hz = rate_hz;
+
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    return false;
+  }
+
+  uint32_t capacity = 0;
+  char line[256];
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), file)) {
+    int x, y, z;
+    const char *values = strstr(line, "X=");
+    if (line[0] == '#') {
+      trace_parse_label(trace, line);
+      continue;
+    }
+    if (values && (sscanf(values, "X=%d, Y=%d, Z=%d", &x, &y, &z) == 3)) {
+      ok = trace_append(trace, &capacity, x, y, z);
+    } else if (sscanf(line, "%d , %d , %d", &x, &y, &z) == 3) {
+      ok = trace_append(trace, &capacity, x, y, z);
+    }
+  }
+  fclose(file);
+
+  if (!ok || (trace->num_samples == 0)) {
+    trace_free(trace);
+    return false;
+  }
+  return true;
+}
+
+
+
+/*
+	Labels first, then one "x,y,z" line per sample,
+	as trace_load() reads it back.
+*/
+bool trace_save(const Trace *trace, const char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    return false;
+  }
+  for (uint32_t i = 0; i < trace->num_labels; i++) {
+    fprintf(file, "# %s %u\n", LABEL_NAMES[trace->labels[i].kind], trace->labels[i].onset_ms);
+  }
+  for (uint32_t i = 0; i < trace->num_samples; i++) {
+    const TraceSample *sample = &trace->samples[i];
+    fprintf(file, "%d,%d,%d\n", sample->x, sample->y, sample->z);
+  }
+  return (fclose(file) == 0);
+}
+
+
+
+/*
+	Deterministic xorshift noise, so synthetic traces
+	are identical from run to run.
+*/
+static int noise(uint32_t *state, int amplitude) {
+  uint32_t v = *state;
+  v ^= v << 13;
+  v ^= v >> 17;
+  v ^= v << 5;
+  *state = v;
+  return (int)(v % (uint32_t)(2 * amplitude + 1)) - amplitude;
+}
+
+
+
+/*
+	Triangle wave in [-amplitude, amplitude], period
+	given in samples. Good enough for rhythmic motion
+	and keeps the generator free of libm.
+*/
+static int triangle(uint32_t i, uint32_t period, int amplitude) {
+  uint32_t phase = i % period;
+  int half = (int)period / 2;
+  int ramp = (phase < (uint32_t)half) ? (int)phase : ((int)period - (int)phase);
+  return ((4 * amplitude * ramp) / (int)period) - amplitude;
+}
+
+
+
+// Uniform in [low, high]
+static uint32_t uniform(uint32_t *state, uint32_t low, uint32_t high) {
+  uint32_t half = (high - low) / 2;
+  return low + half + noise(state, (int)half);
+}
+
+
+
+/*
+	Builds a trace of a resting wrist with one scripted
+	event per minute, cycling through a fall (free fall,
+	impact, lying still), 10 s of walking and shaking.
+	Shaking alternates between 10 s at 5 Hz (brushing
+	teeth) and 40 s of ~4 Hz seizure-like jerking.
+*/
+void trace_synthesize(Trace *trace, uint32_t seconds, uint32_t rate_hz, uint32_t seed) {
+  memset(trace, 0, sizeof(*trace));
+  trace->rate_hz = rate_hz;
+  trace->num_samples = seconds * rate_hz;
+  trace->samples = calloc(trace->num_samples ? trace->num_samples : 1, sizeof(TraceSample));
+  if (!trace->samples) {
+    trace->num_samples = 0;
+    return;
+  }
+
+  uint32_t state = seed ? seed : 0x5eed;
+  bool lying = false;		// Gravity stays on x after a fall until the next event
+
+  for (uint32_t i = 0; i < trace->num_samples; i++) {
+    uint32_t t_ms = (uint32_t)(((uint64_t)i * 1000) / rate_hz);
+    int x = 0, y = 0, z = -1000;
+    int jitter = 15;
+
+    if (lying) {
+      x = 1000;
+      z = 0;
+    }
+
+    if (t_ms >= SCENARIO_OFFSET_S * 1000) {
+      uint32_t since = t_ms - SCENARIO_OFFSET_S * 1000;
+      uint32_t period_index = since / (SCENARIO_PERIOD_S * 1000);
+      uint32_t scenario = period_index % 3;
+      bool convulsing = (period_index / 3) % 2;	// Every other shake is a seizure
+      uint32_t at = since % (SCENARIO_PERIOD_S * 1000);
+      uint32_t n = (uint32_t)(((uint64_t)at * rate_hz) / 1000);
+
+      if (at == 0) {
+        lying = false;
+        x = 0;
+        z = -1000;
+        if (scenario == 0) {
+          trace->num_falls++;
+        } else if ((scenario == 2) && convulsing) {
+          trace->num_seizures++;
+        }
+      }
+
+      if (scenario == 0) {
+        if (at < 240) {			// Free fall: |a| ~ 100 mg
+          x = 20;
+          y = 30;
+          z = -90;
+          jitter = 8;
+        } else if (at < 440) {		// Impact: |a| ~ 2.6 g
+          x = 1500;
+          y = -900;
+          z = 1900;
+          jitter = 100;
+        } else {			// Lying still on the side
+          lying = true;
+          x = 1000;
+          z = 0;
+        }
+      } else if ((scenario == 1) && (at < 10000)) {	// Walking, ~1.8 Hz
+        uint32_t period = (rate_hz * 10) / 18;
+        z += triangle(n, period ? period : 1, 300);
+        x += triangle(n + period / 4, period ? period : 1, 200);
+        jitter = 40;
+      } else if ((scenario == 2) && convulsing && (at < 40000)) {	// Clonic jerking, ~4 Hz
+        uint32_t period = rate_hz / 4;
+        x += triangle(n, period ? period : 1, 700);
+        z += triangle(n + period / 3, period ? period : 1, 400);
+        jitter = 80;
+      } else if ((scenario == 2) && (at < 10000)) {	// Rhythmic shaking, 5 Hz
+        uint32_t period = rate_hz / 5;
+        x += triangle(n, period ? period : 1, 800);
+        y += triangle(n + period / 4, period ? period : 1, 300);
+        jitter = 60;
+      }
+    }
+
+    trace->samples[i] = (TraceSample) {
+      .x = x + noise(&state, jitter),
+      .y = y + noise(&state, jitter),
+      .z = z + noise(&state, jitter),
+    };
+  }
+}
+
+
+
+/*
+	Builds a trace of a resting wrist with a single
+	event, 10 to 30 s in, whose parameters are drawn
+	from seed, so a set of traces covers the easy and
+	the borderline cases:
+
+	  - fall: 120 to 400 ms of free fall, a 1.6 to 3.2 g
+	    impact, lying on one side, one time in five
+	    stirring 2 s after the impact
+	  - seizure: 20 to 60 s of 3 to 5 Hz jerking
+	  - walk: 20 to 40 s at 1.5 to 2.2 Hz
+	  - shake: 6 to 14 s at 5 to 7 Hz
+	  - flop: a 60 to 240 ms drop to 150 to 400 mg and a
+	    1.2 to 2 g landing on a sofa, then lying there
+	  - set down: the watch off the wrist, a 160 to 300 ms
+	    drop and a 1.6 to 2.8 g landing on a table, then
+	    lying face up as it was worn, up to 15 degrees off
+
+	Falls and seizures are labeled at their onset.
+*/
+void trace_synthesize_event(Trace *trace, TraceEvent event, uint32_t seconds, uint32_t rate_hz, uint32_t seed) {
+  memset(trace, 0, sizeof(*trace));
+  trace->rate_hz = rate_hz;
+  trace->num_samples = seconds * rate_hz;
+  trace->samples = calloc(trace->num_samples ? trace->num_samples : 1, sizeof(TraceSample));
+  if (!trace->samples) {
+    trace->num_samples = 0;
+    return;
+  }
+
+  uint32_t state = seed ? seed : 0x5eed;
+  uint32_t onset_ms = uniform(&state, 10000, 30000);
+  uint32_t drop_ms = 0, drop_mg = 0, impact_ms = 0, impact_mg = 0;
+  uint32_t period_ms = 1000, length_ms = 0;
+  int amplitude = 0;
+  bool on_y = uniform(&state, 0, 1);		// Side lain on after a fall or flop
+  bool stir = false;
+  int tilt_mg = -1;				// Set down: x of the resting face up posture
+
+  switch (event) {
+    case TRACE_EVENT_FALL:
+      drop_ms = uniform(&state, 120, 400);
+      drop_mg = uniform(&state, 20, 150);
+      impact_ms = uniform(&state, 120, 300);
+      impact_mg = uniform(&state, 1600, 3200);
+      stir = (uniform(&state, 0, 4) == 0);
+      trace->labels[trace->num_labels++] = (TraceLabel) { .kind = TRACE_LABEL_FALL, .onset_ms = onset_ms };
+      trace->num_falls = 1;
+      break;
+    case TRACE_EVENT_FLOP:
+      drop_ms = uniform(&state, 60, 240);
+      drop_mg = uniform(&state, 150, 400);
+      impact_ms = uniform(&state, 80, 200);
+      impact_mg = uniform(&state, 1200, 2000);
+      break;
+    case TRACE_EVENT_SET_DOWN:
+      drop_ms = uniform(&state, 160, 300);
+      drop_mg = uniform(&state, 20, 150);
+      impact_ms = uniform(&state, 80, 200);
+      impact_mg = uniform(&state, 1600, 2800);
+      tilt_mg = uniform(&state, 0, 260);		// sin(15 degrees) g
+      break;
+    case TRACE_EVENT_SEIZURE:
+      period_ms = 1000000 / uniform(&state, 3000, 5000);
+      amplitude = uniform(&state, 400, 900);
+      length_ms = uniform(&state, 20000, 60000);
+      trace->labels[trace->num_labels++] = (TraceLabel) { .kind = TRACE_LABEL_SEIZURE, .onset_ms = onset_ms };
+      trace->num_seizures = 1;
+      break;
+    case TRACE_EVENT_WALK:
+      period_ms = 1000000 / uniform(&state, 1500, 2200);
+      amplitude = uniform(&state, 200, 400);
+      length_ms = uniform(&state, 20000, 40000);
+      break;
+    case TRACE_EVENT_SHAKE:
+      period_ms = 1000000 / uniform(&state, 5000, 7000);
+      amplitude = uniform(&state, 500, 900);
+      length_ms = uniform(&state, 6000, 14000);
+      break;
+    default:
+      break;
+  }
+
+  for (uint32_t i = 0; i < trace->num_samples; i++) {
+    uint32_t t_ms = (uint32_t)(((uint64_t)i * 1000) / rate_hz);
+    uint32_t at = t_ms - onset_ms;
+    int x = 0, y = 0, z = -1000;
+    int jitter = 15;
+
+    if (t_ms < onset_ms) {
+      // Resting before the event
+    } else if (drop_ms > 0) {		// Fall or flop
+      uint32_t landed = drop_ms + impact_ms;
+      if (at < drop_ms) {
+        x = (int)drop_mg / 5;
+        y = (int)drop_mg / 4;
+        z = -(int)drop_mg;
+        jitter = 8;
+      } else if (at < landed) {
+        x = ((int)impact_mg * 55) / 100;
+        y = -((int)impact_mg * 33) / 100;
+        z = ((int)impact_mg * 73) / 100;
+        jitter = 100;
+      } else if (tilt_mg >= 0) {
+        x = tilt_mg;
+      } else {
+        x = on_y ? 0 : 1000;
+        y = on_y ? 1000 : 0;
+        z = 0;
+        if (stir && (at >= landed + 2000) && (at < landed + 3000)) {
+          jitter = 200;
+        }
+      }
+    } else if (at < length_ms) {	// Rhythmic motion
+      x += triangle(at, period_ms, amplitude);
+      z += triangle(at + period_ms / 3, period_ms, (amplitude * 2) / 3);
+      jitter = (event == TRACE_EVENT_WALK) ? 40 : 80;
+    }
+
+    trace->samples[i] = (TraceSample) {
+      .x = x + noise(&state, jitter),
+      .y = y + noise(&state, jitter),
+      .z = z + noise(&state, jitter),
+    };
+  }
+}
+
+
+
+void trace_free(Trace *trace) {
+  free(trace->samples);
+  trace->samples = NULL;
+  trace->num_samples = 0;
+}
+
+
+
+/*
+	Falls are every third scripted event, the first
+	one SCENARIO_OFFSET_S into the trace.
+*/
+uint64_t trace_synthetic_fall_ms(uint32_t fall) {
+  return (SCENARIO_OFFSET_S + (uint64_t)fall * 3 * SCENARIO_PERIOD_S) * 1000;
+}
+
+
+
+const char *trace_label_name(TraceLabelKind kind) {
+  return LABEL_NAMES[kind];
+}
+
+
+
+const char *trace_event_name(TraceEvent event) {
+  return EVENT_NAMES[event];
+}
+
+
+
+uint64_t trace_duration_ms(const Trace *trace) {
+  if (trace->rate_hz == 0) {
+    return 0;
+  }
+  return ((uint64_t)trace->num_samples * 1000) / trace->rate_hz;
+}
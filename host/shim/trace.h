@@ -0,0 +1,67 @@
+/*
+* Accelerometer traces replayed by the host shim.
+*
+* A trace is a plain list of x/y/z samples (in milli-g, like AccelData)
+* recorded at a fixed rate. Files are read one sample per line, either
+* as "x,y,z" or as the "Value: i, X=x, Y=y, Z=z" lines GestureRecording
+* dumps to the console. Lines starting with '#' are ignored, except
+* labels: "# fall MS" and "# seizure MS" give the onset of an event, in
+* milliseconds from the first sample.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+  int16_t x;
+  int16_t y;
+  int16_t z;
+} TraceSample;
+
+typedef enum {
+  TRACE_LABEL_FALL = 0,
+  TRACE_LABEL_SEIZURE,
+  TRACE_LABEL_KINDS,
+} TraceLabelKind;
+
+typedef struct {
+  TraceLabelKind kind;
+  uint32_t onset_ms;
+} TraceLabel;
+
+#define TRACE_MAX_LABELS 8
+
+// Scripted events of trace_synthesize_event()
+typedef enum {
+  TRACE_EVENT_FALL = 0,		// Free fall, impact, lying still (labeled)
+  TRACE_EVENT_SEIZURE,		// Clonic jerking (labeled)
+  TRACE_EVENT_WALK,
+  TRACE_EVENT_SHAKE,		// Brushing teeth
+  TRACE_EVENT_FLOP,		// Dropping onto a sofa and lying there
+  TRACE_EVENT_SET_DOWN,		// Taken off and dropped on a table, face up
+  TRACE_EVENT_REST,
+  TRACE_EVENTS,
+} TraceEvent;
+
+typedef struct {
+  TraceSample *samples;
+  uint32_t num_samples;
+  uint32_t rate_hz;
+  uint32_t num_falls;		// Falls injected by trace_synthesize(), 0 for files
+  uint32_t num_seizures;	// Seizure-like shaking injected by trace_synthesize()
+  TraceLabel labels[TRACE_MAX_LABELS];
+  uint32_t num_labels;
+} Trace;
+
+bool trace_load(Trace *trace, const char *path, uint32_t rate_hz);
+bool trace_save(const Trace *trace, const char *path);
+void trace_synthesize(Trace *trace, uint32_t seconds, uint32_t rate_hz, uint32_t seed);
+void trace_synthesize_event(Trace *trace, TraceEvent event, uint32_t seconds, uint32_t rate_hz, uint32_t seed);
+void trace_free(Trace *trace);
+
+uint64_t trace_duration_ms(const Trace *trace);
+uint64_t trace_synthetic_fall_ms(uint32_t fall);	// Onset of trace_synthesize()'s nth fall
+const char *trace_label_name(TraceLabelKind kind);
+const char *trace_event_name(TraceEvent event);
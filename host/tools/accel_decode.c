@@ -0,0 +1,92 @@
+/*
+* Decoder for store-batch's compressed capture stream.
+*
+* Reads the bytes logged under CAPTURE_CODEC_TAG (accel_codec blocks back
+* to back) and writes one "x,y,z" line per sample, the trace format the
+* benchmarks replay with --trace.
+*
+*   accel_decode [IN [OUT]]        defaults to stdin / stdout
+*
+* A block that does not decode or fails its checksum is reported on
+* stderr and skipped up to the next magic byte. Decoding resumes there
+* only once a whole block passes its checksum, so a magic value inside a
+* block's varints cannot resync the stream into garbage samples.
+*/
+
+#include <pebble.h>
+#include <stdio.h>
+
+#include "accel_codec.h"
+
+
+static uint8_t *read_all(FILE *in, size_t *size) {
+  size_t capacity = 1 << 16;
+  uint8_t *data = malloc(capacity);
+  *size = 0;
+  while (data) {
+    size_t got = fread(data + *size, 1, capacity - *size, in);
+    *size += got;
+    if (got == 0) {
+      break;
+    }
+    if (*size == capacity) {
+      capacity *= 2;
+      uint8_t *grown = realloc(data, capacity);
+      if (!grown) {
+        free(data);
+        return NULL;
+      }
+      data = grown;
+    }
+  }
+  return data;
+}
+
+
+
+int main(int argc, char **argv) {
+  FILE *in = (argc > 1) ? fopen(argv[1], "rb") : stdin;
+  FILE *out = (argc > 2) ? fopen(argv[2], "w") : stdout;
+  if (!in || !out) {
+    fprintf(stderr, "usage: %s [IN [OUT]]\n", argv[0]);
+    return 2;
+  }
+
+  size_t size;
+  uint8_t *data = read_all(in, &size);
+  if (!data) {
+    fprintf(stderr, "%s: out of memory\n", argv[0]);
+    return 1;
+  }
+
+  static int16_t samples[ACCEL_CODEC_MAX_SAMPLES * 3];
+  uint64_t num_blocks = 0, total_samples = 0, bad_blocks = 0;
+  size_t pos = 0;
+
+  while (pos < size) {
+    uint32_t count;
+    uint32_t used = accel_codec_decode(data + pos, size - pos, samples, ACCEL_CODEC_MAX_SAMPLES, &count);
+    if (used == 0) {
+      bad_blocks++;
+      fprintf(stderr, "bad block at byte %zu, resyncing\n", pos);
+      do {
+        pos++;
+      } while ((pos < size) && (data[pos] != ACCEL_CODEC_MAGIC));
+      continue;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+      fprintf(out, "%d,%d,%d\n", samples[i * 3], samples[i * 3 + 1], samples[i * 3 + 2]);
+    }
+    num_blocks++;
+    total_samples += count;
+    pos += used;
+  }
+
+  fprintf(stderr, "%llu blocks, %llu samples, %zu bytes (%.2f bytes/sample), %llu bad blocks\n",
+          (unsigned long long)num_blocks, (unsigned long long)total_samples, size,
+          total_samples ? (double)size / total_samples : 0.0, (unsigned long long)bad_blocks);
+
+  free(data);
+  return bad_blocks ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+/*
+* Receiver stand-in for GestureRecording's binary export.
+*
+* Reads a data logging spool (see shim/shim.h; the shim writes one with
+* shim_set_log_spool()), keeps the GESTURE_EXPORT_TAG items, checks each
+* chunk's checksum and sequence number and writes every complete recording
+* as a trace file, one "x,y,z" line per sample.
+*
+*   gesture_receive SPOOL [PREFIX]     writes PREFIX<recording>.csv (default "gesture-")
+*
+* Recordings with missing or corrupt chunks are reported and not written.
+*/
+
+#include <pebble.h>
+#include <stdio.h>
+
+#include "shim.h"
+#include "gesture_export.h"
+
+#define MAX_RECORDINGS 64
+#define MAX_CHUNKS ((GESTURE_BUFFER_SAMPLES + GESTURE_CHUNK_SAMPLES - 1) / GESTURE_CHUNK_SAMPLES)
+
+typedef struct {
+  uint16_t id;
+  uint16_t num_chunks;
+  uint16_t total_samples;
+  uint16_t received;
+  bool have[MAX_CHUNKS];
+  GestureChunk chunks[MAX_CHUNKS];
+} Recording;
+
+static Recording s_recordings[MAX_RECORDINGS];
+static uint32_t s_num_recordings;
+
+
+static uint32_t get_le(const uint8_t *in, int bytes) {
+  uint32_t value = 0;
+  for (int i = 0; i < bytes; i++) {
+    value |= (uint32_t)in[i] << (8 * i);
+  }
+  return value;
+}
+
+
+
+static Recording *find_recording(const GestureChunk *chunk) {
+  for (uint32_t i = 0; i < s_num_recordings; i++) {
+    if (s_recordings[i].id == chunk->recording) {
+      return &s_recordings[i];
+    }
+  }
+  if (s_num_recordings == MAX_RECORDINGS) {
+    return NULL;
+  }
+  Recording *recording = &s_recordings[s_num_recordings++];
+  recording->id = chunk->recording;
+  recording->num_chunks = chunk->num_chunks;
+  recording->total_samples = chunk->total_samples;
+  return recording;
+}
+
+
+
+/*
+	Files a chunk under its recording. Returns
+	false if it is corrupt or inconsistent.
+*/
+static bool receive_chunk(const GestureChunk *chunk) {
+  if ((chunk->magic != GESTURE_CHUNK_MAGIC) || (chunk->version != GESTURE_CHUNK_VERSION) ||
+      (chunk->checksum != gesture_chunk_checksum(chunk))) {
+    return false;
+  }
+  Recording *recording = find_recording(chunk);
+  if (!recording || (chunk->num_chunks != recording->num_chunks) || (chunk->num_chunks > MAX_CHUNKS) ||
+      (chunk->seq >= chunk->num_chunks) || (chunk->count > GESTURE_CHUNK_SAMPLES)) {
+    return false;
+  }
+  if (!recording->have[chunk->seq]) {
+    recording->have[chunk->seq] = true;
+    recording->chunks[chunk->seq] = *chunk;
+    recording->received++;
+  }
+  return true;
+}
+
+
+
+static bool write_recording(const Recording *recording, const char *prefix) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s%u.csv", prefix, recording->id);
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    return false;
+  }
+
+  fprintf(out, "# GestureRecording export %u, %u samples @ %u Hz\n",
+          recording->id, recording->total_samples, recording->chunks[0].rate_hz);
+  for (uint16_t seq = 0; seq < recording->num_chunks; seq++) {
+    const GestureChunk *chunk = &recording->chunks[seq];
+    for (uint8_t i = 0; i < chunk->count; i++) {
+      fprintf(out, "%d,%d,%d\n", chunk->axes[GESTURE_AXIS_X][i], chunk->axes[GESTURE_AXIS_Y][i],
+              chunk->axes[GESTURE_AXIS_Z][i]);
+    }
+  }
+  fclose(out);
+  printf("%s: %u samples in %u chunks\n", path, recording->total_samples, recording->num_chunks);
+  return true;
+}
+
+
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s SPOOL [PREFIX]\n", argv[0]);
+    return 2;
+  }
+  const char *prefix = (argc > 2) ? argv[2] : "gesture-";
+  FILE *in = fopen(argv[1], "rb");
+  if (!in) {
+    fprintf(stderr, "%s: cannot read %s\n", argv[0], argv[1]);
+    return 1;
+  }
+
+  uint8_t header[SHIM_SPOOL_HEADER_BYTES];
+  uint32_t bad_chunks = 0;
+  while (fread(header, 1, sizeof(header), in) == sizeof(header)) {
+    uint32_t tag = get_le(&header[0], 4);
+    uint32_t item_length = get_le(&header[4], 2);
+    uint32_t num_items = get_le(&header[6], 4);
+
+    if ((tag != GESTURE_EXPORT_TAG) || (item_length != sizeof(GestureChunk))) {
+      fseek(in, (long)item_length * num_items, SEEK_CUR);
+      continue;
+    }
+    for (uint32_t i = 0; i < num_items; i++) {
+      GestureChunk chunk;
+      if (fread(&chunk, sizeof(chunk), 1, in) != 1) {
+        break;
+      }
+      if (!receive_chunk(&chunk)) {
+        bad_chunks++;
+      }
+    }
+  }
+  fclose(in);
+
+  uint32_t incomplete = 0;
+  for (uint32_t i = 0; i < s_num_recordings; i++) {
+    const Recording *recording = &s_recordings[i];
+    if (recording->received != recording->num_chunks) {
+      fprintf(stderr, "recording %u: %u of %u chunks, not written\n",
+              recording->id, recording->received, recording->num_chunks);
+      incomplete++;
+    } else if (!write_recording(recording, prefix)) {
+      fprintf(stderr, "%s: cannot write recording %u\n", argv[0], recording->id);
+      incomplete++;
+    }
+  }
+  if (bad_chunks) {
+    fprintf(stderr, "%u corrupt chunks dropped\n", bad_chunks);
+  }
+  return (incomplete || bad_chunks) ? 1 : 0;
+}
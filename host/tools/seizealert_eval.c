@@ -0,0 +1,201 @@
+/*
+* Offline accuracy and latency of SeizeAlert's detectors.
+*
+* Replays a directory of labeled traces (see shim/trace.h: "# fall MS"
+* and "# seizure MS" lines; traces without labels are daily activities)
+* through the app's fall and seizure detectors on every core, and
+* reports precision, recall, false alarms per day and time to detection.
+*
+*   seizealert_eval DIR [--workers N] [--rate HZ] [--set FIELD=VALUE]... [--verbose]
+*   seizealert_eval --generate DIR [--traces N] [--seed N]
+*
+* --set changes a DetectorConfig field (as named in detector.h) or
+* alert_window from the defaults, so a threshold change can be compared with
+* the defaults on the same traces. --verbose lists every missed label and
+* false alarm. --generate writes N (default 1000) synthetic 60 s traces
+* with one fall, seizure, walk, shake, sofa flop, watch set down on a
+* table or rest each.
+*/
+
+#include <pebble.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "eval.h"
+
+#define GENERATE_SECONDS 60
+#define GENERATE_TRACES 1000
+#define GENERATE_RATE_HZ 25
+
+// Share of each event in generated sets, in twentieths
+static const TraceEvent GENERATE_MIX[20] = {
+  TRACE_EVENT_FALL, TRACE_EVENT_FALL, TRACE_EVENT_FALL, TRACE_EVENT_FALL, TRACE_EVENT_FALL, TRACE_EVENT_FALL,
+  TRACE_EVENT_SEIZURE, TRACE_EVENT_SEIZURE, TRACE_EVENT_SEIZURE,
+  TRACE_EVENT_WALK, TRACE_EVENT_WALK, TRACE_EVENT_WALK,
+  TRACE_EVENT_SHAKE, TRACE_EVENT_SHAKE, TRACE_EVENT_SHAKE,
+  TRACE_EVENT_FLOP, TRACE_EVENT_FLOP, TRACE_EVENT_FLOP,
+  TRACE_EVENT_SET_DOWN, TRACE_EVENT_REST,
+};
+
+typedef struct {
+  const char *dir;
+  uint32_t seed;
+  uint32_t failed;
+} GenerateJob;
+
+
+static uint64_t clock_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+
+
+static void generate_task(uint32_t index, void *context) {
+  GenerateJob *job = context;
+  uint32_t seed = (job->seed + index) * 2654435761u;	// Spread neighbouring indices apart
+  TraceEvent event = GENERATE_MIX[(seed >> 16) % ARRAY_LENGTH(GENERATE_MIX)];
+
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/%05u-%s.csv", job->dir, index, trace_event_name(event));
+  Trace trace;
+  trace_synthesize_event(&trace, event, GENERATE_SECONDS, GENERATE_RATE_HZ, seed | 1);
+  if (!trace_save(&trace, path)) {
+    __sync_fetch_and_add(&job->failed, 1);
+  }
+  trace_free(&trace);
+}
+
+
+
+static int generate(const char *dir, uint32_t num_traces, uint32_t seed) {
+  mkdir(dir, 0777);
+  GenerateJob job = { .dir = dir, .seed = seed };
+  pool_run(num_traces, pool_default_workers(), generate_task, &job);
+  if (job.failed) {
+    fprintf(stderr, "cannot write %u traces to %s\n", job.failed, dir);
+    return 1;
+  }
+  printf("generated:  %u traces of %u s in %s\n", num_traces, GENERATE_SECONDS, dir);
+  return 0;
+}
+
+
+
+/*
+	Missed labels and false alarms of one
+	trace, with its path.
+*/
+static void print_misses(const TraceSet *set, uint32_t index, const EvalResult *result) {
+  for (int kind = 0; kind < TRACE_LABEL_KINDS; kind++) {
+    const EvalScore *score = &result->scores[kind];
+    if (score->detected < score->labels) {
+      printf("  missed %u %s: %s\n", score->labels - score->detected, trace_label_name(kind), set->paths[index]);
+    }
+    if (score->false_alarms) {
+      printf("  %u false %s alarm%s: %s\n", score->false_alarms, trace_label_name(kind),
+             (score->false_alarms > 1) ? "s" : "", set->paths[index]);
+    }
+  }
+}
+
+
+
+static void print_score(const char *name, const EvalScore *score, uint64_t duration_ms) {
+  printf("%-11s %u labeled, %u detected, %u false alarms: precision %.3f, recall %.3f, "
+         "%.2f false alarms/day, detection %.2f s avg / %.2f s max\n",
+         name, score->labels, score->detected, score->false_alarms, eval_precision(score), eval_recall(score),
+         eval_false_alarms_per_day(score, duration_ms), eval_mean_delay_s(score), score->max_delay_ms / 1000.0);
+}
+
+
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s DIR [--workers N] [--rate HZ] [--set FIELD=VALUE]... [--verbose]\n"
+                  "       %s --generate DIR [--traces N] [--seed N]\n", argv0, argv0);
+}
+
+
+
+int main(int argc, char **argv) {
+  const char *dir = NULL;
+  const char *generate_dir = NULL;
+  uint32_t num_traces = GENERATE_TRACES;
+  uint32_t seed = 1;
+  uint32_t workers = pool_default_workers();
+  uint32_t rate_hz = GENERATE_RATE_HZ;
+  bool verbose = false;
+  EvalConfig config = EVAL_DEFAULT_CONFIG;
+  SeizureConfig seizure_config = SEIZURE_DEFAULT_CONFIG;
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "--generate") == 0) && (i + 1 < argc)) {
+      generate_dir = argv[++i];
+    } else if ((strcmp(argv[i], "--traces") == 0) && (i + 1 < argc)) {
+      num_traces = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--seed") == 0) && (i + 1 < argc)) {
+      seed = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--workers") == 0) && (i + 1 < argc)) {
+      workers = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--rate") == 0) && (i + 1 < argc)) {
+      rate_hz = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--set") == 0) && (i + 1 < argc)) {
+      if (!eval_config_set(&config, argv[++i])) {
+        fprintf(stderr, "%s: no detector setting %s\n", argv[0], argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--verbose") == 0) {
+      verbose = true;
+    } else if ((argv[i][0] != '-') && !dir) {
+      dir = argv[i];
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (generate_dir) {
+    return generate(generate_dir, num_traces, seed);
+  }
+  if (!dir) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  uint64_t start_ns = clock_ns();
+  TraceSet set;
+  if (!trace_set_load(&set, dir, rate_hz, workers)) {
+    fprintf(stderr, "%s: cannot read %s\n", argv[0], dir);
+    return 1;
+  }
+  uint64_t load_ns = clock_ns() - start_ns;
+
+  EvalResult *results = calloc(set.num_traces ? set.num_traces : 1, sizeof(EvalResult));
+  EvalResult total;
+  start_ns = clock_ns();
+  PoolStats stats = eval_set(&set, &config, &seizure_config, workers, results, &total);
+  uint64_t eval_ns = clock_ns() - start_ns;
+
+  printf("config:     ");
+  eval_config_print(stdout, &config);
+  printf("traces:     %u (%u unreadable), %.1f h, %llu samples, loaded in %.2f s\n",
+         set.num_traces - set.failed, set.failed, total.duration_ms / 3600000.0,
+         (unsigned long long)total.samples, load_ns / 1e9);
+  print_score("falls:", &total.scores[TRACE_LABEL_FALL], total.duration_ms);
+  print_score("seizures:", &total.scores[TRACE_LABEL_SEIZURE], total.duration_ms);
+  printf("replay:     %.3f s on %u workers (%u to %u traces each, %u steals), %.1fM samples/s\n",
+         eval_ns / 1e9, stats.workers, stats.min_tasks, stats.max_tasks, stats.steals,
+         eval_ns ? (total.samples * 1e3) / eval_ns : 0.0);
+  if (verbose) {
+    for (uint32_t i = 0; i < set.num_traces; i++) {
+      print_misses(&set, i, &results[i]);
+    }
+  }
+
+  free(results);
+  trace_set_free(&set);
+  return 0;
+}
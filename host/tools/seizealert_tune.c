@@ -0,0 +1,387 @@
+/*
+* Threshold search for SeizeAlert's fall detector.
+*
+* Evaluates many EvalConfigs (the detector's step thresholds and sample
+* counts, and ALERT_WINDOW) over a labeled trace corpus and prints the
+* Pareto front of recall against false alarms per day. Each worker
+* evaluates whole configs over the corpus, which is packed into one file
+* and memory-mapped read-only (eval/corpus.h), so all workers share one
+* copy of the samples.
+*
+*   seizealert_tune --corpus FILE [DIR] [--random N | --grid] [--seed N]
+*                   [--range FIELD=LOW:HIGH:STEP]... [--workers N]
+*                   [--max-false-alarms PER_DAY] [--header FILE]
+*
+* With DIR, the labeled traces in DIR (see seizealert_eval) are packed
+* into FILE first; without it, FILE is mapped as it is. The search space
+* is every FIELD between LOW and HIGH in STEPs (defaults in s_ranges).
+* --grid tries all of it; --random N (the default, N = 200) tries N
+* points of it. The defaults are always evaluated too.
+*
+* --header writes the front point with the best recall at no more false
+* alarms per day than --max-false-alarms (by default, as many as the
+* defaults raise) as a header of constants. Copied over
+* Picasso/SeizeAlert/src/detector_tuned.h, it replaces the defaults in
+* the watch build.
+*/
+
+#include <pebble.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "eval.h"
+#include "corpus.h"
+
+#define DEFAULT_RANDOM 200
+#define MAX_GRID 100000
+#define MAX_STEP_SAMPLES ((MAGNITUDE_WINDOW_SIZE * DETECTOR_RATE_HZ) / DETECTOR_MAX_RATE_HZ)
+
+typedef struct {
+  uint16_t low;
+  uint16_t high;
+  uint16_t step;
+} TuneRange;
+
+// Search space, in EVAL_FIELD_TABLE order
+static TuneRange s_ranges[EVAL_FIELDS] = {
+  { 700, 900, 50 },		// step_one_lower_bound
+  { 950, 1000, 50 },		// step_one_higher_bound
+  { 2, 6, 1 },			// step_one_samples
+  { 300, 900, 100 },		// step_two_lower_bound
+  { 15, 35, 5 },		// step_two_samples
+  { 50, 250, 50 },		// step_three_higher_bound
+  { 30, 60, 15 },		// step_three_samples
+  { 10, 20, 5 },		// alert_window
+};
+
+typedef struct {
+  EvalConfig config;
+  EvalScore falls;
+  bool front;
+} Candidate;
+
+typedef struct {
+  const TraceSet *set;
+  Candidate *candidates;
+} TuneJob;
+
+
+static uint64_t clock_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+
+
+static uint32_t range_values(const TuneRange *range) {
+  return ((range->high - range->low) / range->step) + 1;
+}
+
+
+
+static uint64_t space_size(void) {
+  uint64_t size = 1;
+  for (int i = 0; i < EVAL_FIELDS; i++) {
+    size *= range_values(&s_ranges[i]);
+  }
+  return size;
+}
+
+
+
+// The index-th point of the space, first field varying slowest
+static EvalConfig config_at(uint64_t index) {
+  EvalConfig config = EVAL_DEFAULT_CONFIG;
+  for (int i = EVAL_FIELDS - 1; i >= 0; i--) {
+    const TuneRange *range = &s_ranges[i];
+    uint32_t values = range_values(range);
+    eval_config_put(&config, &EVAL_FIELD_TABLE[i], range->low + (uint16_t)(index % values) * range->step);
+    index /= values;
+  }
+  return config;
+}
+
+
+
+/*
+	Parses "field=low:high:step" into s_ranges.
+	Step sample counts must fit the detector's
+	window at DETECTOR_MAX_RATE_HZ.
+*/
+static bool parse_range(const char *text) {
+  const char *equals = strchr(text, '=');
+  unsigned int low, high, step;
+  if (!equals || (sscanf(equals + 1, "%u:%u:%u", &low, &high, &step) != 3) ||
+      (step == 0) || (low > high) || (high > UINT16_MAX)) {
+    return false;
+  }
+  const EvalField *field = eval_field(text, equals - text);
+  if (!field) {
+    return false;
+  }
+  if (strstr(field->name, "_samples") && (high > MAX_STEP_SAMPLES)) {
+    return false;
+  }
+  s_ranges[field - EVAL_FIELD_TABLE] = (TuneRange) { .low = low, .high = high, .step = step };
+  return true;
+}
+
+
+
+static uint64_t xorshift64(uint64_t *state) {
+  uint64_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *state = x;
+  return x;
+}
+
+
+
+/*
+	One config over the whole corpus, fall
+	detector only.
+*/
+static void tune_task(uint32_t index, void *context) {
+  TuneJob *job = context;
+  Candidate *candidate = &job->candidates[index];
+  EvalResult total = { .scores = { { 0 } }, .duration_ms = 0, .samples = 0 };
+  for (uint32_t i = 0; i < job->set->num_traces; i++) {
+    EvalResult result;
+    eval_trace(&job->set->traces[i], &candidate->config, NULL, &result);
+    eval_add(&total, &result);
+  }
+  candidate->falls = total.scores[TRACE_LABEL_FALL];
+}
+
+
+
+static int compare_false_alarms(const void *a, const void *b) {
+  const Candidate *x = *(const Candidate *const *)a;
+  const Candidate *y = *(const Candidate *const *)b;
+  if (x->falls.false_alarms != y->falls.false_alarms) {
+    return (x->falls.false_alarms < y->falls.false_alarms) ? -1 : 1;
+  }
+  if (x->falls.detected != y->falls.detected) {
+    return (x->falls.detected > y->falls.detected) ? -1 : 1;
+  }
+  return (x->falls.total_delay_ms < y->falls.total_delay_ms) ? -1 : (x->falls.total_delay_ms > y->falls.total_delay_ms);
+}
+
+
+
+/*
+	Marks the candidates no other one beats on both
+	recall and false alarms. Returns them sorted by
+	false alarms, fewest first.
+*/
+static uint32_t pareto_front(Candidate *candidates, uint32_t num_candidates, Candidate **front) {
+  Candidate **sorted = malloc(num_candidates * sizeof(Candidate *));
+  for (uint32_t i = 0; i < num_candidates; i++) {
+    sorted[i] = &candidates[i];
+  }
+  qsort(sorted, num_candidates, sizeof(Candidate *), compare_false_alarms);
+
+  uint32_t num_front = 0;
+  int64_t best_detected = -1;
+  for (uint32_t i = 0; i < num_candidates; i++) {
+    if ((int64_t)sorted[i]->falls.detected > best_detected) {
+      best_detected = sorted[i]->falls.detected;
+      sorted[i]->front = true;
+      front[num_front++] = sorted[i];
+    }
+  }
+  free(sorted);
+  return num_front;
+}
+
+
+
+static void print_changes(FILE *out, const EvalConfig *config) {
+  EvalConfig defaults = EVAL_DEFAULT_CONFIG;
+  bool any = false;
+  for (int i = 0; i < EVAL_FIELDS; i++) {
+    const EvalField *field = &EVAL_FIELD_TABLE[i];
+    uint16_t value = eval_config_get(config, field);
+    if (value != eval_config_get(&defaults, field)) {
+      fprintf(out, "%s%s=%u", any ? " " : "", field->name, value);
+      any = true;
+    }
+  }
+  fprintf(out, "%s\n", any ? "" : "(defaults)");
+}
+
+
+
+static bool write_header(const char *path, const Candidate *chosen, const TraceSet *set, uint64_t duration_ms) {
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    return false;
+  }
+  fprintf(file, "#pragma once\n\n"
+                "/*\n"
+                "\tFall detector constants chosen by host/tools/seizealert_tune\n"
+                "\tover %u traces (%.1f h): recall %.3f, %.2f false alarms\n"
+                "\ta day, detection %.2f s after the onset on average.\n"
+                "*/\n\n",
+          set->num_traces, duration_ms / 3600000.0, eval_recall(&chosen->falls),
+          eval_false_alarms_per_day(&chosen->falls, duration_ms), eval_mean_delay_s(&chosen->falls));
+  for (int i = 0; i < EVAL_FIELDS; i++) {
+    const EvalField *field = &EVAL_FIELD_TABLE[i];
+    fprintf(file, "#define %s %u\n", field->macro, eval_config_get(&chosen->config, field));
+  }
+  return (fclose(file) == 0);
+}
+
+
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s --corpus FILE [DIR] [--random N | --grid] [--seed N]\n"
+                  "          [--range FIELD=LOW:HIGH:STEP]... [--workers N]\n"
+                  "          [--max-false-alarms PER_DAY] [--header FILE]\n", argv0);
+}
+
+
+
+int main(int argc, char **argv) {
+  const char *corpus_path = NULL;
+  const char *dir = NULL;
+  const char *header_path = NULL;
+  uint32_t random_configs = DEFAULT_RANDOM;
+  bool grid = false;
+  uint64_t seed = 1;
+  uint32_t workers = pool_default_workers();
+  double max_false_alarms = -1;
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "--corpus") == 0) && (i + 1 < argc)) {
+      corpus_path = argv[++i];
+    } else if ((strcmp(argv[i], "--random") == 0) && (i + 1 < argc)) {
+      random_configs = (uint32_t)atoi(argv[++i]);
+      grid = false;
+    } else if (strcmp(argv[i], "--grid") == 0) {
+      grid = true;
+    } else if ((strcmp(argv[i], "--seed") == 0) && (i + 1 < argc)) {
+      seed = (uint64_t)atoll(argv[++i]);
+    } else if ((strcmp(argv[i], "--range") == 0) && (i + 1 < argc)) {
+      if (!parse_range(argv[++i])) {
+        fprintf(stderr, "%s: bad range %s (step sample counts up to %u)\n", argv[0], argv[i], MAX_STEP_SAMPLES);
+        return 2;
+      }
+    } else if ((strcmp(argv[i], "--workers") == 0) && (i + 1 < argc)) {
+      workers = (uint32_t)atoi(argv[++i]);
+    } else if ((strcmp(argv[i], "--max-false-alarms") == 0) && (i + 1 < argc)) {
+      max_false_alarms = atof(argv[++i]);
+    } else if ((strcmp(argv[i], "--header") == 0) && (i + 1 < argc)) {
+      header_path = argv[++i];
+    } else if ((argv[i][0] != '-') && !dir) {
+      dir = argv[i];
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (!corpus_path) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  if (dir) {
+    TraceSet set;
+    if (!trace_set_load(&set, dir, 25, workers) || !corpus_write(&set, corpus_path)) {
+      fprintf(stderr, "%s: cannot pack %s into %s\n", argv[0], dir, corpus_path);
+      return 1;
+    }
+    trace_set_free(&set);
+  }
+  Corpus corpus;
+  if (!corpus_map(&corpus, corpus_path)) {
+    fprintf(stderr, "%s: cannot map corpus %s\n", argv[0], corpus_path);
+    return 1;
+  }
+  const TraceSet *set = &corpus.set;
+  uint64_t duration_ms = 0;
+  uint32_t falls = 0;
+  for (uint32_t i = 0; i < set->num_traces; i++) {
+    duration_ms += trace_duration_ms(&set->traces[i]);
+    for (uint32_t j = 0; j < set->traces[i].num_labels; j++) {
+      falls += (set->traces[i].labels[j].kind == TRACE_LABEL_FALL);
+    }
+  }
+  printf("corpus:     %s, %u traces, %.1f h, %u falls, %.1f MB mapped\n",
+         corpus_path, set->num_traces, duration_ms / 3600000.0, falls, corpus.map_size / 1e6);
+
+  // Candidate 0 is the defaults
+  uint64_t size = space_size();
+  if (grid && (size > MAX_GRID)) {
+    fprintf(stderr, "%s: the grid has %llu points, over %u: narrow it with --range or use --random\n",
+            argv[0], (unsigned long long)size, MAX_GRID);
+    return 2;
+  }
+  uint32_t num_candidates = 1 + (grid ? (uint32_t)size : random_configs);
+  Candidate *candidates = calloc(num_candidates, sizeof(Candidate));
+  candidates[0].config = EVAL_DEFAULT_CONFIG;
+  uint64_t state = seed ? seed : 0x5eed;
+  for (uint32_t i = 1; i < num_candidates; i++) {
+    candidates[i].config = config_at(grid ? (i - 1) : (xorshift64(&state) % size));
+  }
+  printf("search:     %s, %u of %llu configs and the defaults\n", grid ? "grid" : "random",
+         num_candidates - 1, (unsigned long long)size);
+
+  uint64_t start_ns = clock_ns();
+  TuneJob job = { .set = set, .candidates = candidates };
+  PoolStats stats = pool_run(num_candidates, workers, tune_task, &job);
+  uint64_t tune_ns = clock_ns() - start_ns;
+  uint64_t samples = 0;
+  for (uint32_t i = 0; i < set->num_traces; i++) {
+    samples += set->traces[i].num_samples;
+  }
+  printf("evaluated:  %u configs in %.2f s on %u workers (%u steals), %.1fM samples/s\n",
+         num_candidates, tune_ns / 1e9, stats.workers, stats.steals,
+         tune_ns ? (samples * num_candidates * 1e3) / tune_ns : 0.0);
+
+  const EvalScore *defaults = &candidates[0].falls;
+  double default_false_alarms = eval_false_alarms_per_day(defaults, duration_ms);
+  printf("defaults:   recall %.3f, %.2f false alarms/day, precision %.3f, detection %.2f s\n",
+         eval_recall(defaults), default_false_alarms, eval_precision(defaults), eval_mean_delay_s(defaults));
+
+  Candidate **front = malloc(num_candidates * sizeof(Candidate *));
+  uint32_t num_front = pareto_front(candidates, num_candidates, front);
+  if (max_false_alarms < 0) {
+    max_false_alarms = default_false_alarms;
+  }
+  const Candidate *chosen = NULL;
+  printf("pareto:     recall  false/day  precision  detection  changes\n");
+  for (uint32_t i = 0; i < num_front; i++) {
+    const EvalScore *score = &front[i]->falls;
+    double false_alarms = eval_false_alarms_per_day(score, duration_ms);
+    printf("            %.3f  %9.2f  %9.3f  %7.2f s  ", eval_recall(score), false_alarms,
+           eval_precision(score), eval_mean_delay_s(score));
+    print_changes(stdout, &front[i]->config);
+    if (false_alarms <= max_false_alarms + 1e-9) {
+      chosen = front[i];		// Recall only grows along the front
+    }
+  }
+
+  int status = 0;
+  if (header_path) {
+    if (!chosen) {
+      fprintf(stderr, "%s: no config raises %.2f false alarms/day or fewer\n", argv[0], max_false_alarms);
+      status = 1;
+    } else if (!write_header(header_path, chosen, set, duration_ms)) {
+      fprintf(stderr, "%s: cannot write %s\n", argv[0], header_path);
+      status = 1;
+    } else {
+      printf("header:     %s: recall %.3f at %.2f false alarms/day (at most %.2f)\n", header_path,
+             eval_recall(&chosen->falls), eval_false_alarms_per_day(&chosen->falls, duration_ms), max_false_alarms);
+    }
+  }
+
+  free(front);
+  free(candidates);
+  corpus_unmap(&corpus);
+  return status;
+}